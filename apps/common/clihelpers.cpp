@@ -0,0 +1,248 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "clihelpers.h"
+
+#include "ocvp/calibration.h"
+#include "ocvp/framepool.h"
+#include "ocvp/imagebatch.h"
+#include "ocvp/target.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace cli
+{
+
+/**
+ * @brief removes an option and its value from the command line
+ * @param argc  number of arguments, updated if the option is found
+ * @param argv  the arguments, updated if the option is found
+ * @param name  name of the option, e.g. "--camera-id"
+ * @return the value of the option, or an empty string if it is absent
+ *
+ * This lets an option be given anywhere, including between positional
+ * arguments.
+ * The program exits if the option is the last argument, i.e. has no value.
+ */
+std::string take_option(int& argc, char* argv[], const std::string& name)
+{
+    for (int i(1); i < argc; ++i)
+    {
+        if (argv[i] == name)
+        {
+            if (i + 1 == argc)
+            {
+                std::cerr << "Missing value for option " << name << std::endl;
+                std::exit(1);
+            }
+
+            std::string value = argv[i + 1];
+
+            for (int j(i); j + 2 < argc; ++j)
+            {
+                argv[j] = argv[j + 2];
+            }
+
+            argc -= 2;
+            return value;
+        }
+    }
+
+    return std::string();
+}
+
+/**
+ * @brief parses the value of an option that is a count, e.g. a number of threads
+ * @param name   name of the option, e.g. "--jobs"
+ * @param value  value of the option
+ *
+ * The program prints the usage of the option and exits if the value is not
+ * a non-negative integer.
+ */
+size_t parse_count(const std::string& name, const std::string& value)
+{
+    size_t end = 0;
+    unsigned long result = 0;
+
+    try
+    {
+        result = std::stoul(value, &end);
+    }
+    catch (const std::exception&)
+    {
+        end = 0;
+    }
+
+    if (end == 0 || end != value.size() || value[0] == '-')
+    {
+        std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+        std::cerr << "usage: " << name << " <n>, n being a non-negative integer" << std::endl;
+        std::exit(1);
+    }
+
+    return result;
+}
+
+/**
+ * @brief parses the value of an option that is a JPEG quality
+ * @param name   name of the option, e.g. "--jpeg-quality"
+ * @param value  value of the option
+ *
+ * The program prints the usage of the option and exits if the value is not
+ * an integer between 0 and 100.
+ */
+int parse_jpeg_quality(const std::string& name, const std::string& value)
+{
+    size_t quality = parse_count(name, value);
+
+    if (quality > 100)
+    {
+        std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+        std::cerr << "usage: " << name << " <q>, q being between 0 and 100" << std::endl;
+        std::exit(1);
+    }
+
+    return static_cast<int>(quality);
+}
+
+/**
+ * @brief removes the --registry and --camera-id options from the command line
+ * @param registry_path  receives the value of --registry
+ * @param camera_id      receives the value of --camera-id
+ *
+ * The program exits if --camera-id is given without --registry.
+ */
+void take_camera_id_options(int& argc,
+                            char* argv[],
+                            std::string& registry_path,
+                            std::string& camera_id)
+{
+    registry_path = take_option(argc, argv, "--registry");
+    camera_id = take_option(argc, argv, "--camera-id");
+
+    if (!camera_id.empty() && registry_path.empty())
+    {
+        std::cerr << "--camera-id requires --registry" << std::endl;
+        std::exit(1);
+    }
+}
+
+/**
+ * @brief loads the calibration passed to a program
+ * @param registry_path         the registry file, must be empty if @a camera_id is
+ * @param camera_id             id of the camera in the registry, may be empty
+ * @param camera_json_path      used if @a camera_id is empty
+ * @param distortion_json_path  used if @a camera_id is empty
+ * @throw std::runtime_error if the files cannot be read, the camera is unknown,
+ * or a registry is given without a camera id
+ */
+CameraCalibration load_calibration(const std::string& registry_path,
+                                   const std::string& camera_id,
+                                   const std::string& camera_json_path,
+                                   const std::string& distortion_json_path)
+{
+    if (!camera_id.empty())
+    {
+        return load_camera_registry(registry_path).at(camera_id);
+    }
+
+    if (!registry_path.empty())
+    {
+        throw std::runtime_error("--registry requires --camera-id");
+    }
+
+    CalibrationCache& cache = CalibrationCache::global();
+    CameraCalibration calibration;
+    calibration.intrinsics = cache.camera_intrinsics(camera_json_path);
+    calibration.distortion = cache.distortion_coeffs(distortion_json_path);
+    return calibration;
+}
+
+/**
+ * @brief returns the target passed to a program
+ * @param name_or_path  "a4", "a3", "letter", or a json file (see load_planar_target())
+ * @throw std::runtime_error if the file cannot be read
+ */
+PlanarTarget load_target(const std::string& name_or_path)
+{
+    PlanarTarget target;
+
+    if (!find_standard_target(name_or_path, target))
+    {
+        target = load_planar_target(name_or_path);
+    }
+
+    return target;
+}
+
+/**
+ * @brief prints the errors and the statistics of a batch of images on stderr
+ */
+void print_batch_statistics(const ImageBatchStatistics& stats)
+{
+    for (const std::string& error : stats.errors)
+    {
+        std::cerr << "Error: " << error << std::endl;
+    }
+
+    const double elapsed = stats.elapsed_ms / 1000;
+    const double rate = elapsed > 0 ? stats.nb_written / elapsed : 0;
+    const size_t n = std::max<size_t>(1, stats.nb_written + stats.nb_failed);
+
+    std::cerr << stats.nb_written << " images (" << stats.nb_failed << " failed) in " << elapsed
+              << "s: " << rate << " images/s" << std::endl;
+    std::cerr << "per image: read " << stats.read_ms / n << "ms, decode " << stats.decode_ms / n
+              << "ms, draw " << stats.draw_ms / n << "ms, write latency "
+              << stats.write_latency_ms / n << "ms" << std::endl;
+    std::cerr << "reader blocked " << stats.blocked_ms << "ms, peak decoded memory "
+              << stats.peak_decoded_bytes / (1024 * 1024) << " MiB" << std::endl;
+}
+
+/**
+ * @brief installs the frame pool as the default allocator of OpenCV
+ * @param mode  "on", "huge" (with huge pages) or "off"
+ * @return the pool, or nullptr if @a mode is "off"
+ *
+ * The program exits if the mode is invalid.
+ */
+FramePool* install_frame_pool(const std::string& mode)
+{
+    if (mode == "off")
+    {
+        return nullptr;
+    }
+
+    if (mode != "on" && mode != "huge")
+    {
+        std::cerr << "Invalid frame pool mode: " << mode << std::endl;
+        std::exit(1);
+    }
+
+    FramePoolOptions options;
+    options.huge_pages = mode == "huge";
+    return &FramePool::install(options);
+}
+
+void print_frame_pool_statistics(const FramePool* pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    FramePoolStatistics stats = pool->statistics();
+
+    std::cerr << "frame pool: " << stats.nb_hits << " hits, " << stats.nb_misses
+              << " misses, peak " << stats.peak_bytes / (1024 * 1024) << " MiB" << std::endl;
+}
+
+} // namespace cli
+
+} // namespace ocvp
@@ -0,0 +1,50 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CLIHELPERS_H
+#define CLIHELPERS_H
+
+#include "ocvp/cli.h"
+
+#include <cstddef>
+#include <string>
+
+namespace ocvp
+{
+
+struct CameraCalibration;
+class FramePool;
+struct ImageBatchStatistics;
+struct PlanarTarget;
+
+namespace cli
+{
+
+// Helpers shared by the command-line tools; errors in the command line are
+// reported on stderr and end the program.
+
+std::string take_option(int& argc, char* argv[], const std::string& name);
+size_t parse_count(const std::string& name, const std::string& value);
+int parse_jpeg_quality(const std::string& name, const std::string& value);
+void take_camera_id_options(int& argc,
+                            char* argv[],
+                            std::string& registry_path,
+                            std::string& camera_id);
+
+CameraCalibration load_calibration(const std::string& registry_path,
+                                   const std::string& camera_id,
+                                   const std::string& camera_json_path,
+                                   const std::string& distortion_json_path);
+PlanarTarget load_target(const std::string& name_or_path);
+
+void print_batch_statistics(const ImageBatchStatistics& stats);
+
+FramePool* install_frame_pool(const std::string& mode);
+void print_frame_pool_statistics(const FramePool* pool);
+
+} // namespace cli
+
+} // namespace ocvp
+
+#endif // CLIHELPERS_H
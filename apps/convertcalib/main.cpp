@@ -0,0 +1,124 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "ocvp/calibration.h"
+#include "ocvp/cli.h"
+
+#include <cstdio>
+#include <iostream>
+
+struct Params
+{
+    bool to_json = false;
+    std::string binary_path;
+    std::string camera_json_path;
+    std::string distortion_json_path;
+    cv::Size image_size;
+};
+
+void print_help()
+{
+    std::cout << "convertcalib: converts calibrations between JSON and binary files" << std::endl;
+    std::cout << "usage: convertcalib <camera.json> <distortion.json> <output.ocvpcal> [options]"
+              << std::endl;
+    std::cout << "   or: convertcalib --to-json <input.ocvpcal> <camera.json> <distortion.json>"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --size <w>x<h>    size of the calibrated images, if not in camera.json"
+              << std::endl;
+
+    std::exit(0);
+}
+
+Params parse_cli(int argc, char* argv[])
+{
+    Params params;
+
+    if (std::string(argv[1]) == "--to-json")
+    {
+        if (argc != 5)
+        {
+            std::cerr << "Invalid arguments" << std::endl;
+            std::exit(1);
+        }
+
+        params.to_json = true;
+        params.binary_path = argv[2];
+        params.camera_json_path = argv[3];
+        params.distortion_json_path = argv[4];
+        return params;
+    }
+
+    if (argc < 4)
+    {
+        std::cerr << "Invalid arguments" << std::endl;
+        std::exit(1);
+    }
+
+    params.camera_json_path = argv[1];
+    params.distortion_json_path = argv[2];
+    params.binary_path = argv[3];
+
+    for (int i(4); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--size" && i + 1 < argc)
+        {
+            int w = 0, h = 0;
+
+            if (std::sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+            {
+                std::cerr << "Invalid image size: " << argv[i] << std::endl;
+                std::exit(1);
+            }
+
+            params.image_size = cv::Size(w, h);
+        }
+        else
+        {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+
+    return params;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1 || ocvp::cli::is_help(argv[1]))
+        print_help();
+
+    Params params = parse_cli(argc, argv);
+
+    try
+    {
+        if (params.to_json)
+        {
+            ocvp::CameraCalibration calibration = ocvp::load_calibration(params.binary_path);
+            ocvp::export_calibration_json(
+              calibration, params.camera_json_path, params.distortion_json_path);
+        }
+        else
+        {
+            ocvp::CameraCalibration calibration = ocvp::import_calibration_json(
+              params.camera_json_path, params.distortion_json_path);
+
+            if (!params.image_size.empty())
+            {
+                calibration.image_size = params.image_size;
+            }
+
+            ocvp::save_calibration(params.binary_path, calibration);
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
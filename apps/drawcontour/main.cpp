@@ -2,10 +2,13 @@
 // This file is part of the 'ocv-playground' project
 // For conditions of distribution and use, see copyright notice in LICENSE
 
-#include "ocvp/cli.h"
+#include "clihelpers.h"
+
 #include "ocvp/contour.h"
 #include "ocvp/image.h"
+#include "ocvp/imagebatch.h"
 
+#include <algorithm>
 #include <iostream>
 
 struct Params
@@ -13,48 +16,241 @@ struct Params
     std::string input_image_path;
     std::vector<cv::Point> points;
     std::string output_image_path;
+    int reduction = 1;
+    ocvp::EncodeOptions encode_options;
+};
+
+struct BatchParams
+{
+    std::string input_path;
+    std::string output_dir;
+    std::vector<cv::Point> points;
+    ocvp::ImageBatchOptions options;
+    std::string frame_pool = "on";
 };
 
 void print_help()
 {
     std::cout << "drawcontour: draws the outline of a polygon on an image" << std::endl;
-    std::cout << "usage: drawcontour <input_image> [x1:y1 x2:y2 x3:y3 ...] <output_image>"
+    std::cout << "usage: drawcontour <input_image> [x1:y1 x2:y2 x3:y3 ...] <output_image> "
+                 "[options]"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --reduce <n>        draws on a preview of the image, decoded at 1/n scale"
+              << std::endl;
+    std::cout << "                      (n = 2, 4 or 8); points are given at full resolution"
+              << std::endl;
+    std::cout << "  --jpeg-quality <q>  quality of the output image if it is a JPEG (0-100)"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "usage: drawcontour --batch <input_dir|manifest> <output_dir> [x1:y1 x2:y2 ...] "
+                 "[options]"
+              << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  draws the contour on every image of <input_dir>, or listed in <manifest>"
+              << std::endl;
+    std::cout << "  a line of the manifest is: <input_image> [x1:y1 x2:y2 ...]" << std::endl;
+    std::cout << "  the points of the command line are used for lines without points" << std::endl;
+    std::cout << "  output images are written in <output_dir>, with the name of the input"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --reduce <n>, --jpeg-quality <q> as above" << std::endl;
+    std::cout << "  --jobs <n>          number of decoding and drawing threads (defaults to one"
+              << std::endl;
+    std::cout << "                      per core)" << std::endl;
+    std::cout << "  --encode-jobs <n>   number of encoding threads (defaults to one per core)"
               << std::endl;
+    std::cout << "  --max-memory <MiB>  bound of the decoded images in memory (defaults to 1024)"
+              << std::endl;
+    std::cout << "  --frame-pool <mode> recycling of the image buffers: on (default), huge"
+              << std::endl;
+    std::cout << "                      (on, with huge pages) or off" << std::endl;
 
     std::exit(0);
 }
 
+bool parse_point(const std::string& arg, cv::Point& p)
+{
+    size_t separator_index = arg.find(':');
+
+    if (separator_index == std::string::npos)
+    {
+        return false;
+    }
+
+    p.x = std::stoi(arg.substr(0, separator_index));
+    p.y = std::stoi(arg.substr(separator_index + 1));
+    return true;
+}
+
+// Parses the points given at argv[begin] to argv[end - 1]
+std::vector<cv::Point> parse_points(char* argv[], int begin, int end)
+{
+    std::vector<cv::Point> points;
+
+    for (int i(begin); i < end; ++i)
+    {
+        cv::Point p;
+
+        if (!parse_point(argv[i], p))
+        {
+            std::cerr << "Malformed 2D point: " << argv[i] << std::endl;
+            std::exit(1);
+        }
+
+        points.push_back(p);
+    }
+
+    return points;
+}
+
+// Removes the options shared by both modes from the command line
+void take_image_options(int& argc,
+                        char* argv[],
+                        int& reduction,
+                        ocvp::EncodeOptions& encode_options)
+{
+    std::string value = ocvp::cli::take_option(argc, argv, "--reduce");
+
+    if (!value.empty())
+    {
+        reduction = static_cast<int>(ocvp::cli::parse_count("--reduce", value));
+
+        if (reduction != 1 && reduction != 2 && reduction != 4 && reduction != 8)
+        {
+            std::cerr << "Invalid value for --reduce: " << value << std::endl;
+            std::cerr << "usage: --reduce <n>, n being 1, 2, 4 or 8" << std::endl;
+            std::exit(1);
+        }
+    }
+
+    value = ocvp::cli::take_option(argc, argv, "--jpeg-quality");
+
+    if (!value.empty())
+    {
+        encode_options.jpeg_quality = ocvp::cli::parse_jpeg_quality("--jpeg-quality", value);
+    }
+}
+
 Params parse_cli(int argc, char* argv[])
 {
+    Params params;
+    take_image_options(argc, argv, params.reduction, params.encode_options);
+
     if (argc < 3)
     {
         std::cerr << "Not enough arguments" << std::endl;
         std::exit(1);
     }
 
-    Params params;
-
     params.input_image_path = argv[1];
     params.output_image_path = argv[argc - 1];
+    params.points = parse_points(argv, 2, argc - 1);
 
-    for (int i(2); i < argc - 1; ++i)
+    return params;
+}
+
+BatchParams parse_batch_cli(int argc, char* argv[])
+{
+    BatchParams params;
+    take_image_options(
+      argc, argv, params.options.load_options.reduction, params.options.encode_options);
+
+    std::string value = ocvp::cli::take_option(argc, argv, "--jobs");
+    params.options.nb_threads = value.empty() ? 0 : ocvp::cli::parse_count("--jobs", value);
+    value = ocvp::cli::take_option(argc, argv, "--encode-jobs");
+    params.options.nb_encode_threads =
+      value.empty() ? 0 : ocvp::cli::parse_count("--encode-jobs", value);
+    value = ocvp::cli::take_option(argc, argv, "--frame-pool");
+    params.frame_pool = value.empty() ? params.frame_pool : value;
+    value = ocvp::cli::take_option(argc, argv, "--max-memory");
+
+    if (!value.empty())
     {
-        std::string arg = argv[i];
-        size_t separator_index = arg.find(':');
+        params.options.max_decoded_bytes =
+          ocvp::cli::parse_count("--max-memory", value) * 1024 * 1024;
+    }
 
-        if (separator_index == std::string::npos)
+    if (argc < 4)
+    {
+        std::cerr << "Not enough arguments" << std::endl;
+        std::exit(1);
+    }
+
+    params.input_path = argv[2];
+    params.output_dir = argv[3];
+    params.points = parse_points(argv, 4, argc);
+
+    return params;
+}
+
+void draw(cv::Mat& image, const std::vector<cv::Point>& points, double scale)
+{
+    std::vector<cv::Point> scaled;
+    scaled.reserve(points.size());
+
+    for (const cv::Point& p : points)
+    {
+        scaled.emplace_back(cvRound(p.x * scale), cvRound(p.y * scale));
+    }
+
+    ocvp::draw_contour(image, scaled, cv::Scalar(0, 0, 255), std::max(1, cvRound(8 * scale)));
+}
+
+/**
+ * @brief draws a contour on every image of a directory or of a manifest
+ *
+ * Reading, decoding, drawing and encoding overlap (see process_image_batch()).
+ */
+int run_batch(const BatchParams& params)
+{
+    const ocvp::FramePool* frame_pool = ocvp::cli::install_frame_pool(params.frame_pool);
+    std::vector<ocvp::ImageBatchItem> items;
+    std::vector<std::vector<cv::Point>> contours;
+
+    try
+    {
+        std::vector<ocvp::ImageBatchInput> inputs =
+          ocvp::read_image_batch_inputs(params.input_path);
+
+        for (const ocvp::ImageBatchInput& input : inputs)
         {
-            std::cerr << "Malformed 2D point: " << arg << std::endl;
-            std::exit(1);
+            std::vector<cv::Point> points;
+
+            for (const std::string& arg : input.arguments)
+            {
+                cv::Point p;
+
+                if (!parse_point(arg, p))
+                {
+                    throw std::runtime_error("line " + std::to_string(input.line_number)
+                                             + ": malformed 2D point " + arg);
+                }
+
+                points.push_back(p);
+            }
+
+            contours.push_back(points.empty() ? params.points : points);
         }
 
-        cv::Point p;
-        p.x = std::stoi(arg.substr(0, separator_index));
-        p.y = std::stoi(arg.substr(separator_index + 1));
-        params.points.push_back(p);
+        items = ocvp::make_image_batch(inputs, params.output_dir);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
     }
 
-    return params;
+    ocvp::ImageBatchStatistics stats = ocvp::process_image_batch(
+      items,
+      [&contours](size_t index, cv::Mat& image, double scale)
+      { draw(image, contours[index], scale); },
+      params.options);
+
+    ocvp::cli::print_batch_statistics(stats);
+    ocvp::cli::print_frame_pool_statistics(frame_pool);
+
+    return stats.nb_failed == 0 ? 0 : 1;
 }
 
 int main(int argc, char* argv[])
@@ -62,13 +258,21 @@ int main(int argc, char* argv[])
     if (argc <= 1 || ocvp::cli::is_help(argv[1]))
         print_help();
 
+    if (std::string(argv[1]) == "--batch")
+    {
+        return run_batch(parse_batch_cli(argc, argv));
+    }
+
     Params params = parse_cli(argc, argv);
 
     cv::Mat image;
+    double scale = 1;
 
     try
     {
-        image = ocvp::load_image(params.input_image_path);
+        ocvp::LoadOptions options;
+        options.reduction = params.reduction;
+        image = ocvp::load_image(params.input_image_path, options, &scale);
     }
     catch (const std::runtime_error& ex)
     {
@@ -76,9 +280,9 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    ocvp::draw_contour(image, params.points, cv::Scalar(0, 0, 255), 8);
+    draw(image, params.points, scale);
 
-    bool ok = ocvp::save_image(image, params.output_image_path);
+    bool ok = ocvp::save_image(image, params.output_image_path, params.encode_options);
 
     if (!ok)
     {
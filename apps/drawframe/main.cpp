@@ -2,83 +2,401 @@
 // This file is part of the 'ocv-playground' project
 // For conditions of distribution and use, see copyright notice in LICENSE
 
-#include "ocvp/cli.h"
+#include "clihelpers.h"
+
+#include "ocvp/calibration.h"
 #include "ocvp/contour.h"
 #include "ocvp/drawframe.h"
 #include "ocvp/image.h"
+#include "ocvp/imagebatch.h"
 #include "ocvp/pnp.h"
+#include "ocvp/undistort.h"
 
 #include <iostream>
+#include <map>
 
 struct Params
 {
     std::string input_image_path;
     std::string camera_json_path;
     std::string distortion_json_path;
+    std::string registry_path;
+    std::string camera_id;
     std::string pnpresult_json_path;
     std::string output_image_path;
+    bool undistort = false;
+    std::string map_cache_dir;
+    std::string target;
+    ocvp::EncodeOptions encode_options;
+};
+
+struct BatchParams
+{
+    std::string input_path;
+    std::string output_dir;
+    std::string camera_json_path;
+    std::string distortion_json_path;
+    std::string registry_path;
+    std::string camera_id;
+    std::string pnpresult_json_path;
+    bool undistort = false;
+    std::string map_cache_dir;
+    std::string target;
+    ocvp::ImageBatchOptions options;
+    std::string frame_pool = "on";
 };
 
 void print_help()
 {
     std::cout << "drawframe: draws the world frame axes onto an image" << std::endl;
     std::cout << "usage: drawframe <input_image> <camera.json> <distortion.json> <pnpresult.json> "
-                 "<output_image>"
+                 "<output_image> [options]"
+              << std::endl;
+    std::cout << "   or: drawframe <input_image> <pnpresult.json> <output_image> --registry <file> "
+                 "--camera-id <id> [options]"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --registry <file>    camera registry in which --camera-id is looked up"
+              << std::endl;
+    std::cout << "  --camera-id <id>     uses the calibration of a camera of the registry instead"
+              << std::endl;
+    std::cout << "                       of <camera.json> and <distortion.json>" << std::endl;
+    std::cout << "  --undistort          undistorts the image before drawing the axes" << std::endl;
+    std::cout << "  --map-cache <dir>    directory in which the undistortion maps are cached"
+              << std::endl;
+    std::cout << "  --jpeg-quality <q>   quality of the output image if it is a JPEG (0-100)"
+              << std::endl;
+    std::cout << "  --target <target>    also draws the outline of the target: a4, a3, letter"
               << std::endl;
+    std::cout << "                       or a json file with its width and height (in meters)"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "usage: drawframe --batch <input_dir|manifest> <output_dir> <camera.json> "
+                 "<distortion.json> [options]"
+              << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  draws the axes on every image of <input_dir>, or listed in <manifest>"
+              << std::endl;
+    std::cout << "  a line of the manifest is: <input_image> [pnpresult.json]" << std::endl;
+    std::cout << "  output images are written in <output_dir>, with the name of the input"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --registry, --camera-id, --undistort, --map-cache, --jpeg-quality, --target"
+              << std::endl;
+    std::cout << "                       as above" << std::endl;
+    std::cout << "  --pose <file>        pose used for the images without a pnpresult.json"
+              << std::endl;
+    std::cout << "  --jobs <n>           number of decoding and drawing threads (defaults to one"
+              << std::endl;
+    std::cout << "                       per core)" << std::endl;
+    std::cout << "  --encode-jobs <n>    number of encoding threads (defaults to one per core)"
+              << std::endl;
+    std::cout << "  --max-memory <MiB>   bound of the decoded images in memory (defaults to 1024)"
+              << std::endl;
+    std::cout << "  --frame-pool <mode>  recycling of the image buffers: on (default), huge"
+              << std::endl;
+    std::cout << "                       (on, with huge pages) or off" << std::endl;
 
     std::exit(0);
 }
 
 Params parse_cli(int argc, char* argv[])
 {
-    if (argc != 6)
+    Params params;
+    ocvp::cli::take_camera_id_options(argc, argv, params.registry_path, params.camera_id);
+
+    const int nb_positional = params.camera_id.empty() ? 5 : 3;
+
+    if (argc < nb_positional + 1)
     {
         std::cerr << "Invalid arguments" << std::endl;
         std::exit(1);
     }
 
-    Params params;
+    int n = 1;
+    params.input_image_path = argv[n++];
+
+    if (params.camera_id.empty())
+    {
+        params.camera_json_path = argv[n++];
+        params.distortion_json_path = argv[n++];
+    }
+
+    params.pnpresult_json_path = argv[n++];
+    params.output_image_path = argv[n++];
+
+    for (int i(n); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--undistort")
+        {
+            params.undistort = true;
+        }
+        else if (arg == "--map-cache" && i + 1 < argc)
+        {
+            params.map_cache_dir = argv[++i];
+        }
+        else if (arg == "--jpeg-quality" && i + 1 < argc)
+        {
+            params.encode_options.jpeg_quality = ocvp::cli::parse_jpeg_quality(arg, argv[++i]);
+        }
+        else if (arg == "--target" && i + 1 < argc)
+        {
+            params.target = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+
+    return params;
+}
+
+BatchParams parse_batch_cli(int argc, char* argv[])
+{
+    BatchParams params;
+    ocvp::cli::take_camera_id_options(argc, argv, params.registry_path, params.camera_id);
+
+    params.pnpresult_json_path = ocvp::cli::take_option(argc, argv, "--pose");
+    params.map_cache_dir = ocvp::cli::take_option(argc, argv, "--map-cache");
+    params.target = ocvp::cli::take_option(argc, argv, "--target");
+
+    std::string value = ocvp::cli::take_option(argc, argv, "--jpeg-quality");
+
+    if (!value.empty())
+    {
+        params.options.encode_options.jpeg_quality =
+          ocvp::cli::parse_jpeg_quality("--jpeg-quality", value);
+    }
+
+    value = ocvp::cli::take_option(argc, argv, "--jobs");
+    params.options.nb_threads = value.empty() ? 0 : ocvp::cli::parse_count("--jobs", value);
+    value = ocvp::cli::take_option(argc, argv, "--encode-jobs");
+    params.options.nb_encode_threads =
+      value.empty() ? 0 : ocvp::cli::parse_count("--encode-jobs", value);
+    value = ocvp::cli::take_option(argc, argv, "--frame-pool");
+    params.frame_pool = value.empty() ? params.frame_pool : value;
+    value = ocvp::cli::take_option(argc, argv, "--max-memory");
+
+    if (!value.empty())
+    {
+        params.options.max_decoded_bytes =
+          ocvp::cli::parse_count("--max-memory", value) * 1024 * 1024;
+    }
+
+    const int nb_positional = params.camera_id.empty() ? 4 : 2;
+
+    if (argc < nb_positional + 2)
+    {
+        std::cerr << "Invalid arguments" << std::endl;
+        std::exit(1);
+    }
 
-    params.input_image_path = argv[1];
-    params.camera_json_path = argv[2];
-    params.distortion_json_path = argv[3];
-    params.pnpresult_json_path = argv[4];
-    params.output_image_path = argv[5];
+    int n = 2;
+    params.input_path = argv[n++];
+    params.output_dir = argv[n++];
+
+    if (params.camera_id.empty())
+    {
+        params.camera_json_path = argv[n++];
+        params.distortion_json_path = argv[n++];
+    }
+
+    for (int i(n); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--undistort")
+        {
+            params.undistort = true;
+        }
+        else
+        {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
 
     return params;
 }
 
+/**
+ * @brief draws the frame axes on every image of a directory or of a manifest
+ *
+ * The poses are loaded before the images are processed; reading, decoding,
+ * drawing and encoding then overlap (see process_image_batch()).
+ */
+int run_batch(const BatchParams& params)
+{
+    const ocvp::FramePool* frame_pool = ocvp::cli::install_frame_pool(params.frame_pool);
+    ocvp::CameraCalibration calibration;
+    std::vector<ocvp::ImageBatchItem> items;
+    std::vector<const ocvp::PnPResult*> poses;
+    std::map<std::string, ocvp::PnPResult> pose_files;
+    ocvp::PlanarTarget target;
+
+    try
+    {
+        if (!params.target.empty())
+        {
+            target = ocvp::cli::load_target(params.target);
+        }
+
+        calibration = ocvp::cli::load_calibration(params.registry_path,
+                                                  params.camera_id,
+                                                  params.camera_json_path,
+                                                  params.distortion_json_path);
+
+        std::vector<ocvp::ImageBatchInput> inputs =
+          ocvp::read_image_batch_inputs(params.input_path);
+
+        for (const ocvp::ImageBatchInput& input : inputs)
+        {
+            if (input.arguments.size() > 1)
+            {
+                throw std::runtime_error("line " + std::to_string(input.line_number)
+                                         + ": too many arguments");
+            }
+
+            const std::string& path =
+              input.arguments.empty() ? params.pnpresult_json_path : input.arguments.front();
+
+            if (path.empty())
+            {
+                throw std::runtime_error("no pose for " + input.path + ", use --pose");
+            }
+
+            auto it = pose_files.find(path);
+
+            if (it == pose_files.end())
+            {
+                it = pose_files.emplace(path, ocvp::load_pnp_result(path)).first;
+            }
+
+            poses.push_back(&it->second);
+        }
+
+        items = ocvp::make_image_batch(inputs, params.output_dir);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    ocvp::UndistortMapCache cache{ params.map_cache_dir };
+
+    auto draw = [&](size_t index, cv::Mat& image, double /* scale */)
+    {
+        ocvp::DistortionCoefficients distortion = calibration.distortion;
+
+        if (params.undistort)
+        {
+            cv::Mat undistorted;
+            cache.undistort(image, undistorted, calibration.intrinsics, distortion);
+            image = undistorted;
+            distortion = ocvp::DistortionCoefficients();
+        }
+
+        constexpr float length = 0.1;
+        constexpr int thickness = 6;
+
+        ocvp::draw_frame_axes(image,
+                              calibration.intrinsics,
+                              distortion,
+                              poses[index]->rvec,
+                              poses[index]->tvec,
+                              length,
+                              thickness);
+
+        if (!params.target.empty())
+        {
+            ocvp::draw_planar_target(image,
+                                     ocvp::make_camera_model(calibration.intrinsics, distortion),
+                                     target,
+                                     ocvp::to_pose(*poses[index]));
+        }
+    };
+
+    ocvp::ImageBatchStatistics stats = ocvp::process_image_batch(items, draw, params.options);
+    ocvp::cli::print_batch_statistics(stats);
+    ocvp::cli::print_frame_pool_statistics(frame_pool);
+
+    return stats.nb_failed == 0 ? 0 : 1;
+}
+
 int main(int argc, char* argv[])
 {
     if (argc <= 1 || ocvp::cli::is_help(argv[1]))
         print_help();
 
+    if (std::string(argv[1]) == "--batch")
+    {
+        return run_batch(parse_batch_cli(argc, argv));
+    }
+
     Params params = parse_cli(argc, argv);
 
-    ocvp::CameraIntrinsics intrinsics = ocvp::load_camera_intrinsics(params.camera_json_path);
-    ocvp::DistortionCoefficients distortion
-      = ocvp::load_distortion_coeffs(params.distortion_json_path);
-    ocvp::PnPResult result = ocvp::load_pnp_result(params.pnpresult_json_path);
+    ocvp::CameraIntrinsics intrinsics;
+    ocvp::DistortionCoefficients distortion;
+    ocvp::PnPResult result;
+    ocvp::PlanarTarget target;
 
     cv::Mat image;
 
     try
     {
+        ocvp::CameraCalibration calibration =
+          ocvp::cli::load_calibration(params.registry_path,
+                                      params.camera_id,
+                                      params.camera_json_path,
+                                      params.distortion_json_path);
+        intrinsics = calibration.intrinsics;
+        distortion = calibration.distortion;
+        result = ocvp::load_pnp_result(params.pnpresult_json_path);
+
+        if (!params.target.empty())
+        {
+            target = ocvp::cli::load_target(params.target);
+        }
+
         image = ocvp::load_image(params.input_image_path);
     }
-    catch (const std::runtime_error& ex)
+    catch (const std::exception& ex)
     {
         std::cerr << "Error: " << ex.what() << std::endl;
         return 1;
     }
 
+    if (params.undistort)
+    {
+        ocvp::UndistortMapCache cache{ params.map_cache_dir };
+        cv::Mat undistorted;
+        cache.undistort(image, undistorted, intrinsics, distortion);
+        image = undistorted;
+        distortion = ocvp::DistortionCoefficients(); // the new image has no distortion
+    }
+
     constexpr float length = 0.1;
     constexpr int thickness = 6;
 
     ocvp::draw_frame_axes(
       image, intrinsics, distortion, result.rvec, result.tvec, length, thickness);
 
-    bool ok = ocvp::save_image(image, params.output_image_path);
+    if (!params.target.empty())
+    {
+        ocvp::draw_planar_target(image,
+                                 ocvp::make_camera_model(intrinsics, distortion),
+                                 target,
+                                 ocvp::to_pose(result),
+                                 cv::Scalar(0, 255, 255),
+                                 thickness);
+    }
+
+    bool ok = ocvp::save_image(image, params.output_image_path, params.encode_options);
 
     if (!ok)
     {
@@ -0,0 +1,276 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "clihelpers.h"
+#include "socket.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <thread>
+
+struct Params
+{
+    std::string socket_path;
+    std::string camera_id;
+    ocvp::A4SheetOfPaper corners;
+    std::string image_path;
+    std::string output_path;
+    size_t repeat = 1;
+};
+
+void print_help()
+{
+    std::cout << "ocvpc: sends solve requests to ocvpd" << std::endl;
+    std::cout << "usage: ocvpc <socket> <camera_id> x1:y1 x2:y2 x3:y3 x4:y4 [options]"
+              << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  points must be specified counter-clockwise starting at the bottom left corner"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --image <file>     image on which the frame axes are drawn by the service"
+              << std::endl;
+    std::cout << "  --output <file>    where the annotated image is saved (its extension selects"
+              << std::endl;
+    std::cout << "                     the format)" << std::endl;
+    std::cout << "  --repeat <n>       sends the request n times without waiting for the"
+              << std::endl;
+    std::cout << "                     responses and prints latency statistics" << std::endl;
+    std::exit(0);
+}
+
+cv::Point parse_point(const std::string& arg)
+{
+    size_t separator_index = arg.find(':');
+
+    if (separator_index == std::string::npos)
+    {
+        std::cerr << "Malformed 2D point: " << arg << std::endl;
+        std::exit(1);
+    }
+
+    return cv::Point(std::stoi(arg.substr(0, separator_index)),
+                     std::stoi(arg.substr(separator_index + 1)));
+}
+
+Params parse_cli(int argc, char* argv[])
+{
+    if (argc < 7)
+    {
+        std::cerr << "Incorrect number of arguments" << std::endl;
+        std::exit(1);
+    }
+
+    Params params;
+    params.socket_path = argv[1];
+    params.camera_id = argv[2];
+    params.corners.bottom_left = parse_point(argv[3]);
+    params.corners.bottom_right = parse_point(argv[4]);
+    params.corners.top_right = parse_point(argv[5]);
+    params.corners.top_left = parse_point(argv[6]);
+
+    for (int i(7); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            std::exit(1);
+        }
+
+        if (arg == "--image")
+        {
+            params.image_path = argv[++i];
+        }
+        else if (arg == "--output")
+        {
+            params.output_path = argv[++i];
+        }
+        else if (arg == "--repeat")
+        {
+            params.repeat = std::max<size_t>(1, ocvp::cli::parse_count(arg, argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+
+    return params;
+}
+
+std::vector<uint8_t> read_file(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+std::string extension(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    return dot == std::string::npos ? std::string() : path.substr(dot);
+}
+
+void print_response(const ocvp::protocol::SolveResponse& response)
+{
+    if (!response.ok)
+    {
+        std::cout << "error: " << response.error << std::endl;
+        return;
+    }
+
+    std::cout << "rvec = [" << response.rvec[0] << ", " << response.rvec[1] << ", "
+              << response.rvec[2] << "]" << std::endl;
+    std::cout << "tvec = [" << response.tvec[0] << ", " << response.tvec[1] << ", "
+              << response.tvec[2] << "]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1 || ocvp::cli::is_help(argv[1]))
+        print_help();
+
+    Params params = parse_cli(argc, argv);
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    ocvp::protocol::SolveRequest request;
+    request.camera_id = params.camera_id;
+    request.corners = params.corners;
+    int fd = -1;
+
+    try
+    {
+        if (!params.image_path.empty())
+        {
+            request.image = read_file(params.image_path);
+            request.image_format = extension(
+              params.output_path.empty() ? params.image_path : params.output_path);
+        }
+
+        fd = ocvpd::connect_unix_socket(params.socket_path);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    using clock = std::chrono::steady_clock;
+
+    // written by the writing thread, read by this one when the response comes
+    std::vector<std::atomic<clock::rep>> sent(params.repeat);
+    std::vector<uint64_t> round_trips;
+    std::vector<uint64_t> service_latencies;
+    size_t nb_failures = 0;
+    ocvp::protocol::SolveResponse last_response;
+
+    const auto start = clock::now();
+
+    // requests are written by another thread so that they are pipelined
+    std::thread writer{ [&]()
+                        {
+                            try
+                            {
+                                for (size_t i(0); i < params.repeat; ++i)
+                                {
+                                    request.id = static_cast<uint32_t>(i);
+                                    sent[i].store(clock::now().time_since_epoch().count(),
+                                                  std::memory_order_release);
+                                    ocvpd::write_frame(fd, ocvp::protocol::encode(request));
+                                }
+                            }
+                            catch (const std::exception& ex)
+                            {
+                                std::cerr << "Error: " << ex.what() << std::endl;
+                            }
+
+                            ::shutdown(fd, SHUT_WR);
+                        } };
+
+    std::vector<uint8_t> payload;
+
+    try
+    {
+        while (round_trips.size() < params.repeat && ocvpd::read_frame(fd, payload))
+        {
+            const auto received = clock::now();
+            last_response = ocvp::protocol::decode_response(payload);
+
+            if (last_response.id >= params.repeat)
+            {
+                throw std::runtime_error("unexpected response id");
+            }
+
+            const clock::time_point sent_at{ clock::duration(
+              sent[last_response.id].load(std::memory_order_acquire)) };
+            round_trips.push_back(
+              std::chrono::duration_cast<std::chrono::microseconds>(received - sent_at).count());
+            service_latencies.push_back(last_response.latency_us);
+            nb_failures += last_response.ok ? 0 : 1;
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+    }
+
+    writer.join();
+    ::close(fd);
+
+    std::chrono::duration<double> elapsed = clock::now() - start;
+
+    if (round_trips.size() != params.repeat)
+    {
+        std::cerr << "Error: received " << round_trips.size() << " responses out of "
+                  << params.repeat << std::endl;
+        return 1;
+    }
+
+    print_response(last_response);
+
+    if (last_response.ok && !params.output_path.empty() && !last_response.image.empty())
+    {
+        std::ofstream output{ params.output_path, std::ios::binary };
+        output.write(reinterpret_cast<const char*>(last_response.image.data()),
+                     static_cast<std::streamsize>(last_response.image.size()));
+
+        if (!output)
+        {
+            std::cerr << "Failed to save output image..." << std::endl;
+            return 1;
+        }
+    }
+
+    std::sort(round_trips.begin(), round_trips.end());
+    std::sort(service_latencies.begin(), service_latencies.end());
+
+    auto percentile = [](const std::vector<uint64_t>& samples, double p)
+    { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+
+    std::cerr << params.repeat << " requests (" << nb_failures << " failed) in "
+              << elapsed.count() << "s: " << params.repeat / elapsed.count() << " requests/s"
+              << std::endl;
+    std::cerr << "round trip (us): p50 " << percentile(round_trips, 0.5) << ", p99 "
+              << percentile(round_trips, 0.99) << ", max " << round_trips.back() << std::endl;
+    std::cerr << "service (us): p50 " << percentile(service_latencies, 0.5) << ", p99 "
+              << percentile(service_latencies, 0.99) << ", max " << service_latencies.back()
+              << std::endl;
+
+    return nb_failures == 0 ? 0 : 1;
+}
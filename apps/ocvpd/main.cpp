@@ -0,0 +1,512 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "clihelpers.h"
+#include "socket.h"
+
+#include "ocvp/calibration.h"
+#include "ocvp/drawframe.h"
+#include "ocvp/workerpool.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <poll.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <unordered_map>
+
+struct Params
+{
+    std::string socket_path;
+    std::string registry_path;
+    size_t nb_jobs = 0;
+    bool verbose = false;
+};
+
+/**
+ * @brief a client connection
+ *
+ * Each connection has a reading thread and a writing thread; the workers of
+ * the pool only queue the responses, so that a client that is slow to read
+ * its responses never blocks a worker.
+ *
+ * The socket is closed when the last reference is released, i.e. once the
+ * reading thread has stopped and every pending request has been answered.
+ */
+struct Connection
+{
+    explicit Connection(int socket)
+        : fd(socket)
+    {
+    }
+
+    Connection(const Connection&) = delete;
+
+    ~Connection()
+    {
+        ::close(fd);
+    }
+
+    Connection& operator=(const Connection&) = delete;
+
+    int fd;
+    std::atomic<bool> finished{ false };
+
+    // requests submitted to the pool and not written yet
+    std::mutex pending_mutex;
+    std::condition_variable pending_condition;
+    size_t nb_pending = 0;
+
+    // encoded responses waiting for the writing thread
+    std::condition_variable response_condition;
+    std::deque<std::vector<uint8_t>> responses;
+    bool reading_done = false;
+};
+
+// Maximum number of pending requests per connection; beyond that, the
+// connection is not read until some requests are answered.
+constexpr size_t max_pending_requests = 64;
+
+// A client that does not read its responses for that long is disconnected.
+constexpr int send_timeout_s = 10;
+
+/**
+ * @brief latency of the requests served so far
+ */
+class LatencyStatistics
+{
+public:
+    void add(uint64_t latency_us, bool ok)
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_samples.push_back(latency_us);
+        m_nb_failures += ok ? 0 : 1;
+    }
+
+    void print(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        out << m_samples.size() << " requests (" << m_nb_failures << " failed)";
+
+        if (m_samples.empty())
+        {
+            out << std::endl;
+            return;
+        }
+
+        std::sort(m_samples.begin(), m_samples.end());
+
+        uint64_t sum = 0;
+
+        for (uint64_t s : m_samples)
+        {
+            sum += s;
+        }
+
+        auto percentile = [this](double p)
+        { return m_samples[static_cast<size_t>(p * (m_samples.size() - 1))]; };
+
+        out << ", latency (us): mean " << sum / m_samples.size() << ", p50 " << percentile(0.5)
+            << ", p99 " << percentile(0.99) << ", max " << m_samples.back() << std::endl;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<uint64_t> m_samples;
+    size_t m_nb_failures = 0;
+};
+
+std::atomic<bool> g_stop{ false };
+
+void on_signal(int)
+{
+    g_stop = true;
+}
+
+void print_help()
+{
+    std::cout << "ocvpd: serves PnP solve requests over a Unix domain socket" << std::endl;
+    std::cout << "usage: ocvpd <socket> --registry <file> [options]" << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  the calibrations of the cameras of the registry stay in memory;" << std::endl;
+    std::cout << "  requests name a camera by its id (see ocvpc, the bundled client)" << std::endl;
+    std::cout << "  the service stops on SIGINT or SIGTERM and prints latency statistics"
+              << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --registry <file>    camera registry (required)" << std::endl;
+    std::cout << "  --jobs <n>           number of worker threads (defaults to one per core)"
+              << std::endl;
+    std::cout << "  --verbose            prints the latency of every request" << std::endl;
+    std::exit(0);
+}
+
+Params parse_cli(int argc, char* argv[])
+{
+    Params params;
+    params.socket_path = argv[1];
+
+    for (int i(2); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--verbose")
+        {
+            params.verbose = true;
+            continue;
+        }
+
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            std::exit(1);
+        }
+
+        if (arg == "--registry")
+        {
+            params.registry_path = argv[++i];
+        }
+        else if (arg == "--jobs")
+        {
+            params.nb_jobs = ocvp::cli::parse_count(arg, argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+
+    if (params.registry_path.empty())
+    {
+        std::cerr << "Missing --registry" << std::endl;
+        std::exit(1);
+    }
+
+    return params;
+}
+
+/**
+ * @brief the camera models of the cameras of the registry, by id
+ *
+ * They are built once at startup, so that requests do not convert the
+ * calibrations again.
+ */
+using CameraModels = std::unordered_map<std::string, ocvp::CameraModel>;
+
+CameraModels make_camera_models(const ocvp::CameraRegistry& registry)
+{
+    CameraModels cameras;
+
+    for (const std::string& id : registry.ids())
+    {
+        const ocvp::CameraCalibration& calibration = registry.at(id);
+        cameras.emplace(id,
+                        ocvp::make_camera_model(calibration.intrinsics, calibration.distortion));
+    }
+
+    return cameras;
+}
+
+ocvp::protocol::SolveResponse solve(const CameraModels& cameras,
+                                    const ocvp::protocol::SolveRequest& request)
+{
+    ocvp::protocol::SolveResponse response;
+    response.id = request.id;
+
+    try
+    {
+        auto it = cameras.find(request.camera_id);
+
+        if (it == cameras.end())
+        {
+            throw std::runtime_error("unknown camera id '" + request.camera_id + "'");
+        }
+
+        const ocvp::CameraModel& camera = it->second;
+        ocvp::Pose pose;
+
+        if (!ocvp::solve_pnp(request.corners, camera, pose))
+        {
+            throw std::runtime_error("could not solve the PnP problem");
+        }
+
+        response.rvec = pose.rvec;
+        response.tvec = pose.tvec;
+
+        if (!request.image.empty())
+        {
+            cv::Mat image = cv::imdecode(request.image, cv::IMREAD_COLOR);
+
+            if (image.empty())
+            {
+                throw std::runtime_error("could not decode the image");
+            }
+
+            constexpr float length = 0.1f;
+            constexpr int thickness = 6;
+
+            const ocvp::PnPResult result = ocvp::to_pnp_result(pose);
+            ocvp::draw_frame_axes_batch(image, camera, &result, 1, length, thickness);
+
+            std::vector<uchar> encoded;
+            const std::string format =
+              request.image_format.empty() ? std::string(".jpg") : request.image_format;
+
+            if (!cv::imencode(format, image, encoded))
+            {
+                throw std::runtime_error("could not encode the image as " + format);
+            }
+
+            response.image.assign(encoded.begin(), encoded.end());
+        }
+
+        response.ok = true;
+    }
+    catch (const std::exception& ex)
+    {
+        response.ok = false;
+        response.error = ex.what();
+        response.image.clear();
+    }
+
+    return response;
+}
+
+/**
+ * @brief writes the responses of a connection as they are queued by the workers
+ *
+ * Returns once the reading thread has stopped and every pending request has
+ * been answered. If the client is gone, the remaining responses are dropped.
+ */
+void write_responses(Connection& connection)
+{
+    bool connected = true;
+
+    for (;;)
+    {
+        std::vector<uint8_t> bytes;
+
+        {
+            std::unique_lock<std::mutex> lock{ connection.pending_mutex };
+            connection.response_condition.wait(
+              lock,
+              [&]()
+              {
+                  return !connection.responses.empty()
+                         || (connection.reading_done && connection.nb_pending == 0);
+              });
+
+            if (connection.responses.empty())
+            {
+                return;
+            }
+
+            bytes = std::move(connection.responses.front());
+            connection.responses.pop_front();
+        }
+
+        if (connected)
+        {
+            try
+            {
+                ocvpd::write_frame(connection.fd, bytes);
+            }
+            catch (const std::exception&)
+            {
+                // the client is gone or does not read, also stops the reading thread
+                connected = false;
+                ::shutdown(connection.fd, SHUT_RDWR);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{ connection.pending_mutex };
+            --connection.nb_pending;
+        }
+
+        connection.pending_condition.notify_one();
+    }
+}
+
+/**
+ * @brief reads the requests of a connection and submits them to the pool
+ *
+ * Responses are queued by the workers as soon as they are ready and written
+ * by a thread dedicated to the connection, so they may come out of order;
+ * clients match them with the request id.
+ */
+void serve(std::shared_ptr<Connection> connection,
+           const CameraModels& cameras,
+           ocvp::WorkerPool& pool,
+           LatencyStatistics& statistics,
+           bool verbose)
+{
+    std::vector<uint8_t> payload;
+    std::thread writer{ write_responses, std::ref(*connection) };
+
+    try
+    {
+        while (ocvpd::read_frame(connection->fd, payload))
+        {
+            const auto received = std::chrono::steady_clock::now();
+            auto request = std::make_shared<ocvp::protocol::SolveRequest>(
+              ocvp::protocol::decode_request(payload));
+
+            {
+                std::unique_lock<std::mutex> lock{ connection->pending_mutex };
+                connection->pending_condition.wait(
+                  lock, [&]() { return connection->nb_pending < max_pending_requests; });
+                ++connection->nb_pending;
+            }
+
+            pool.submit(
+              [connection, request, received, &cameras, &statistics, verbose]()
+              {
+                  ocvp::protocol::SolveResponse response = solve(cameras, *request);
+                  response.latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - received)
+                                          .count();
+                  std::vector<uint8_t> bytes = ocvp::protocol::encode(response);
+
+                  {
+                      std::lock_guard<std::mutex> lock{ connection->pending_mutex };
+                      connection->responses.push_back(std::move(bytes));
+                  }
+
+                  connection->response_condition.notify_one();
+                  statistics.add(response.latency_us, response.ok);
+
+                  if (verbose)
+                  {
+                      std::ostringstream line;
+                      line << "request " << request->id << " (" << request->camera_id << "): "
+                           << (response.ok ? "ok" : response.error) << ", "
+                           << response.latency_us << " us\n";
+                      std::cerr << line.str();
+                  }
+              });
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        if (verbose)
+        {
+            std::cerr << "closing connection: " << ex.what() << std::endl;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ connection->pending_mutex };
+        connection->reading_done = true;
+    }
+
+    connection->response_condition.notify_one();
+    writer.join();
+
+    connection->finished = true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1 || ocvp::cli::is_help(argv[1]))
+        print_help();
+
+    Params params = parse_cli(argc, argv);
+
+    CameraModels cameras;
+    int listen_fd = -1;
+
+    try
+    {
+        cameras = make_camera_models(ocvp::load_camera_registry(params.registry_path));
+        listen_fd = ocvpd::listen_unix_socket(params.socket_path);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    LatencyStatistics statistics;
+    std::list<std::pair<std::thread, std::shared_ptr<Connection>>> connections;
+
+    {
+        ocvp::WorkerPool pool{ params.nb_jobs };
+
+        std::cerr << "ocvpd: listening on " << params.socket_path << " with " << cameras.size()
+                  << " cameras and " << pool.size() << " threads" << std::endl;
+
+        while (!g_stop)
+        {
+            pollfd fds{ listen_fd, POLLIN, 0 };
+
+            if (::poll(&fds, 1, 200) > 0 && (fds.revents & POLLIN))
+            {
+                int fd = ::accept(listen_fd, nullptr, nullptr);
+
+                if (fd != -1)
+                {
+                    timeval timeout{ send_timeout_s, 0 };
+                    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+                    auto connection = std::make_shared<Connection>(fd);
+                    std::thread thread{ serve,
+                                        connection,
+                                        std::cref(cameras),
+                                        std::ref(pool),
+                                        std::ref(statistics),
+                                        params.verbose };
+                    connections.emplace_back(std::move(thread), connection);
+                }
+            }
+
+            for (auto it = connections.begin(); it != connections.end();)
+            {
+                if (it->second->finished)
+                {
+                    it->first.join();
+                    it = connections.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        // unblocks the reading threads; pending requests are still answered
+        for (auto& c : connections)
+        {
+            ::shutdown(c.second->fd, SHUT_RD);
+        }
+
+        for (auto& c : connections)
+        {
+            c.first.join();
+        }
+
+        connections.clear();
+    }
+
+    ::close(listen_fd);
+    ::unlink(params.socket_path.c_str());
+
+    statistics.print(std::cerr);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef OCVPD_SOCKET_H
+#define OCVPD_SOCKET_H
+
+#include "ocvp/protocol.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ocvpd
+{
+
+inline sockaddr_un make_address(const std::string& path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw std::runtime_error("socket path is too long: " + path);
+    }
+
+    std::memcpy(address.sun_path, path.c_str(), path.size());
+    return address;
+}
+
+// Removes the socket file left at a path by an instance that is no longer
+// running. Throws if the path is not a socket, or if a server accepts
+// connections on it.
+inline void remove_stale_socket(const std::string& path, const sockaddr_un& address)
+{
+    struct stat info;
+
+    if (::lstat(path.c_str(), &info) != 0)
+    {
+        if (errno == ENOENT)
+        {
+            return;
+        }
+
+        throw std::runtime_error("could not stat " + path + ": " + std::strerror(errno));
+    }
+
+    if (!S_ISSOCK(info.st_mode))
+    {
+        throw std::runtime_error(path + " already exists and is not a socket");
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("socket(): ") + std::strerror(errno));
+    }
+
+    const int result =
+      ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    const int error = errno;
+    ::close(fd);
+
+    if (result == 0)
+    {
+        throw std::runtime_error("another server is listening on " + path);
+    }
+
+    if (error != ECONNREFUSED)
+    {
+        throw std::runtime_error("could not check " + path + ": " + std::strerror(error));
+    }
+
+    ::unlink(path.c_str());
+}
+
+/**
+ * @brief creates a socket listening at a given path
+ *
+ * A stale socket file left by a previous instance is removed first; any
+ * other file, or the socket of a running instance, is left untouched and
+ * reported as an error.
+ */
+inline int listen_unix_socket(const std::string& path)
+{
+    sockaddr_un address = make_address(path);
+    remove_stale_socket(path, address);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("socket(): ") + std::strerror(errno));
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(fd, SOMAXCONN) != 0)
+    {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("could not listen on " + path + ": " + error);
+    }
+
+    return fd;
+}
+
+inline int connect_unix_socket(const std::string& path)
+{
+    sockaddr_un address = make_address(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("socket(): ") + std::strerror(errno));
+    }
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("could not connect to " + path + ": " + error);
+    }
+
+    return fd;
+}
+
+// returns false if the end of the stream is reached before the first byte
+inline bool read_fully(int fd, void* data, size_t size)
+{
+    char* it = static_cast<char*>(data);
+    size_t remaining = size;
+
+    while (remaining > 0)
+    {
+        ssize_t n = ::read(fd, it, remaining);
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            if (n == 0 && remaining == size)
+            {
+                return false;
+            }
+
+            throw std::runtime_error("connection lost");
+        }
+
+        it += n;
+        remaining -= static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+inline void write_fully(int fd, const void* data, size_t size)
+{
+    const char* it = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, it, size);
+
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            throw std::runtime_error("connection lost");
+        }
+
+        it += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+/**
+ * @brief reads a frame of the protocol
+ * @return false if the peer closed the connection
+ */
+inline bool read_frame(int fd, std::vector<uint8_t>& payload)
+{
+    uint8_t header[4];
+
+    if (!read_fully(fd, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    // little-endian, like the rest of the protocol
+    const uint32_t size = header[0] | (header[1] << 8) | (header[2] << 16)
+                          | (static_cast<uint32_t>(header[3]) << 24);
+
+    if (size > ocvp::protocol::max_frame_size)
+    {
+        throw std::runtime_error("frame too large");
+    }
+
+    payload.resize(size);
+
+    if (size > 0 && !read_fully(fd, payload.data(), size))
+    {
+        throw std::runtime_error("connection lost");
+    }
+
+    return true;
+}
+
+inline void write_frame(int fd, const std::vector<uint8_t>& payload)
+{
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    const uint8_t header[4] = { static_cast<uint8_t>(size),
+                                static_cast<uint8_t>(size >> 8),
+                                static_cast<uint8_t>(size >> 16),
+                                static_cast<uint8_t>(size >> 24) };
+    write_fully(fd, header, sizeof(header));
+    write_fully(fd, payload.data(), payload.size());
+}
+
+} // namespace ocvpd
+
+#endif // OCVPD_SOCKET_H
@@ -4,12 +4,20 @@
 
 #include "mainwindow.h"
 
+#include "ocvp/framepool.h"
+
 #include <QApplication>
 
 int main(int argc, char* argv[])
 {
     QApplication app(argc, argv);
 
+    // matrices allocated by OpenCV, e.g. the levels of the ImagePyramid and
+    // the BGR copy of QImage::Format_RGB888 pictures made by to_opencv(),
+    // reuse the buffers of the previous ones; other formats are wrapped
+    // without any allocation
+    ocvp::FramePool::install();
+
     MainWindow w;
     w.show();
 
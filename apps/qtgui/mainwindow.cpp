@@ -11,6 +11,7 @@
 #include "widgets/drawingsurface.h"
 #include "widgets/pnpresultwidget.h"
 
+#include "ocvp/calibration.h"
 #include "ocvp/drawframe.h"
 #include "ocvp/image.h"
 #include "ocvp/pnp.h"
@@ -27,7 +28,6 @@
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QPushButton>
-#include <QScrollArea>
 
 MainWindow::MainWindow()
 {
@@ -58,16 +58,27 @@ void MainWindow::open()
         return;
     }
 
-    if (QFileInfo::exists(path + "/camera.json"))
+    ocvp::CalibrationCache& calibrations = ocvp::CalibrationCache::global();
+
+    if (QFileInfo::exists(path + "/calibration.ocvpcal"))
     {
-        auto values = ocvp::load_camera_intrinsics((path + "/camera.json").toStdString());
-        m_cameraintrinsics_groupbox->setCameraIntrinsics(values);
+        auto values = calibrations.get((path + "/calibration.ocvpcal").toStdString());
+        m_cameraintrinsics_groupbox->setCameraIntrinsics(values->intrinsics);
+        m_distortioncoeffs_groupbox->setDistortionCoefficients(values->distortion);
     }
-
-    if (QFileInfo::exists(path + "/distortion.json"))
+    else
     {
-        auto values = ocvp::load_distortion_coeffs((path + "/distortion.json").toStdString());
-        m_distortioncoeffs_groupbox->setDistortionCoefficients(values);
+        if (QFileInfo::exists(path + "/camera.json"))
+        {
+            auto values = calibrations.camera_intrinsics((path + "/camera.json").toStdString());
+            m_cameraintrinsics_groupbox->setCameraIntrinsics(values);
+        }
+
+        if (QFileInfo::exists(path + "/distortion.json"))
+        {
+            auto values = calibrations.distortion_coeffs((path + "/distortion.json").toStdString());
+            m_distortioncoeffs_groupbox->setDistortionCoefficients(values);
+        }
     }
 
     if (QFileInfo::exists(path + "/calibration.jpg"))
@@ -93,7 +104,7 @@ void MainWindow::openImage()
 void MainWindow::openCameraJson()
 {
     auto directory = QString();
-    auto filters = QString("Camera intrinsics (camera.json)");
+    auto filters = QString("Camera intrinsics (camera.json *.ocvpcal)");
     QString path = QFileDialog::getOpenFileName(this, "Open camera.json", directory, filters);
 
     if (path.isEmpty())
@@ -101,14 +112,14 @@ void MainWindow::openCameraJson()
         return;
     }
 
-    auto values = ocvp::load_camera_intrinsics(path.toStdString());
+    auto values = ocvp::CalibrationCache::global().camera_intrinsics(path.toStdString());
     m_cameraintrinsics_groupbox->setCameraIntrinsics(values);
 }
 
 void MainWindow::openDistortionJson()
 {
     auto directory = QString();
-    auto filters = QString("Distortion coefficients (distortion.json)");
+    auto filters = QString("Distortion coefficients (distortion.json *.ocvpcal)");
     QString path = QFileDialog::getOpenFileName(this, "Open distortion.json", directory, filters);
 
     if (path.isEmpty())
@@ -116,7 +127,7 @@ void MainWindow::openDistortionJson()
         return;
     }
 
-    auto values = ocvp::load_distortion_coeffs(path.toStdString());
+    auto values = ocvp::CalibrationCache::global().distortion_coeffs(path.toStdString());
     m_distortioncoeffs_groupbox->setDistortionCoefficients(values);
 }
 
@@ -151,38 +162,84 @@ void MainWindow::updateUserInterface()
     m_exportcontour_action->setEnabled(m_drawingsurface
                                        && m_drawingsurface->controlPoints().size() > 2);
 
-    m_solvepnp_button->setEnabled(m_drawingsurface
-                                  && m_drawingsurface->controlPoints().size() == 4);
+    // 4 control points per sheet
+    m_solvepnp_button->setEnabled(m_drawingsurface && !m_drawingsurface->controlPoints().empty()
+                                  && m_drawingsurface->controlPoints().size() % 4 == 0);
 }
 
 void MainWindow::solvePnP()
 {
     std::vector<QPoint> points = m_drawingsurface->controlPoints();
+    std::vector<ocvp::A4SheetOfPaper> sheets;
 
-    ocvp::A4SheetOfPaper sheet;
-    sheet.bottom_left = to_opencv(points.at(0));
-    sheet.bottom_right = to_opencv(points.at(1));
-    sheet.top_right = to_opencv(points.at(2));
-    sheet.top_left = to_opencv(points.at(3));
+    for (size_t i(0); i + 3 < points.size(); i += 4)
+    {
+        ocvp::A4SheetOfPaper sheet;
+        sheet.bottom_left = to_opencv(points.at(i));
+        sheet.bottom_right = to_opencv(points.at(i + 1));
+        sheet.top_right = to_opencv(points.at(i + 2));
+        sheet.top_left = to_opencv(points.at(i + 3));
+        sheets.push_back(sheet);
+    }
 
     ocvp::CameraIntrinsics intrinsics = m_cameraintrinsics_groupbox->getCameraIntrinsics();
     ocvp::DistortionCoefficients distcoeffs
       = m_distortioncoeffs_groupbox->getDistortionCoefficients();
 
-    try
+    if (sheets.size() == 1)
+    {
+        try
+        {
+            ocvp::PnPResult result = ocvp::solve_pnp(sheets.front(), intrinsics, distcoeffs);
+            auto* widget = new PnPResultWidget(
+              m_drawingsurface->backgroundImage(), intrinsics, distcoeffs, result);
+            int tab_index = m_tab_widget->addTab(widget, "Result");
+            m_tab_widget->setCurrentIndex(tab_index);
+        }
+        catch (const std::exception& ex)
+        {
+            QMessageBox::warning(
+              this,
+              "Solve PnP failed",
+              QString("Solve PnP failed with the following error: \n%1").arg(ex.what()));
+        }
+
+        return;
+    }
+
+    std::vector<ocvp::PnPTargetResult> results
+      = ocvp::solve_pnp_many(sheets, intrinsics, distcoeffs);
+    std::vector<ocvp::PnPResult> solved;
+    std::vector<int> solved_sheets;
+    QStringList failures;
+
+    for (size_t i(0); i < results.size(); ++i)
+    {
+        if (results[i].status == ocvp::PnPStatus::Solved)
+        {
+            solved.push_back(ocvp::to_pnp_result(results[i].pose));
+            solved_sheets.push_back(static_cast<int>(i) + 1);
+        }
+        else
+        {
+            failures << QString("sheet %1: %2").arg(i + 1).arg(ocvp::to_string(results[i].status));
+        }
+    }
+
+    if (!solved.empty())
     {
-        ocvp::PnPResult result = ocvp::solve_pnp(sheet, intrinsics, distcoeffs);
         auto* widget = new PnPResultWidget(
-          m_drawingsurface->backgroundImage(), intrinsics, distcoeffs, result);
-        int tab_index = m_tab_widget->addTab(widget, "Result");
+          m_drawingsurface->backgroundImage(), intrinsics, distcoeffs, solved, solved_sheets);
+        int tab_index = m_tab_widget->addTab(widget, "Results");
         m_tab_widget->setCurrentIndex(tab_index);
     }
-    catch (const std::exception& ex)
+
+    if (!failures.isEmpty())
     {
         QMessageBox::warning(
           this,
           "Solve PnP failed",
-          QString("Solve PnP failed with the following error: \n%1").arg(ex.what()));
+          QString("Solve PnP failed for the following sheets: \n%1").arg(failures.join("\n")));
     }
 }
 
@@ -198,6 +255,15 @@ void MainWindow::fillMenuBar()
     m_exportcontour_action = file->addAction("Export contour", this, &MainWindow::exportContour);
     file->addSeparator();
     file->addAction("Exit", this, &MainWindow::exit, QKeySequence("Alt+F4"));
+
+    // the drawing surface is created after the menu bar
+    QMenu* view = menuBar()->addMenu("View");
+    view->addAction("Zoom in", [this]() { m_drawingsurface->zoomIn(); }, QKeySequence::ZoomIn);
+    view->addAction("Zoom out", [this]() { m_drawingsurface->zoomOut(); }, QKeySequence::ZoomOut);
+    view->addAction(
+      "Fit to window", [this]() { m_drawingsurface->zoomToFit(); }, QKeySequence("Ctrl+0"));
+    view->addAction(
+      "Actual size", [this]() { m_drawingsurface->zoomToActualSize(); }, QKeySequence("Ctrl+1"));
 }
 
 void MainWindow::createCentralWidget()
@@ -210,15 +276,10 @@ void MainWindow::createCentralWidget()
         auto* layout = new QHBoxLayout;
 
         {
-            auto* scrollarea = new QScrollArea();
-
-            {
-                m_drawingsurface = new DrawingSurface();
-                scrollarea->setWidget(m_drawingsurface);
-            }
+            m_drawingsurface = new DrawingSurface();
 
             constexpr int stretch = 1;
-            layout->addWidget(scrollarea, stretch);
+            layout->addWidget(m_drawingsurface, stretch);
         }
 
         {
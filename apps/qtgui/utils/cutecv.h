@@ -7,13 +7,29 @@
 /**
  * @file cutecv.h
  * @brief provides conversion functions between Qt and OpenCV
+ *
+ * Images are shared between the two libraries whenever their memory layouts
+ * are compatible; the pixels are then owned jointly by the QImage and the
+ * cv::Mat and freed when the last of them is destroyed.
+ * A (row-wise) copy is only made when a pixel format conversion is needed.
+ *
+ * Layout correspondence (little-endian):
+ * - QImage::Format_Grayscale8 <-> CV_8UC1
+ * - QImage::Format_BGR888 (Qt 5.14+) <-> CV_8UC3 (BGR)
+ * - QImage::Format_RGB32 / ARGB32 <-> CV_8UC4 (BGRA)
  */
 
+#include "ocvp/pixelformat.h"
+
 #include <QImage>
 #include <QPoint>
+#include <QtGlobal>
 
 #include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
 
+#include <climits>
+#include <cstdint>
 #include <vector>
 
 inline cv::Point to_opencv(const QPoint& pt)
@@ -21,34 +37,290 @@ inline cv::Point to_opencv(const QPoint& pt)
     return cv::Point(pt.x(), pt.y());
 }
 
-inline cv::Mat to_opencv(const QImage& image)
+namespace cutecv
+{
+
+/**
+ * @brief a cv::MatAllocator whose buffers are owned by a QImage
+ *
+ * The UMatData of a matrix created by wrap() holds a shallow copy of the
+ * QImage, which keeps the pixels alive as long as the matrix (or any of its
+ * copies) exists.
+ * Reallocations (e.g. cv::Mat::create() with another size) are forwarded to
+ * the standard allocator.
+ */
+class QImageMatAllocator : public cv::MatAllocator
 {
-    auto result = cv::Mat(image.height(), image.width(), CV_8UC3);
+public:
+    static QImageMatAllocator& instance()
+    {
+        static QImageMatAllocator allocator;
+        return allocator;
+    }
+
+    cv::Mat wrap(const QImage& image, uchar* data, int type) const
+    {
+        cv::Mat result{ image.height(), image.width(), type, data, size_t(image.bytesPerLine()) };
+
+        auto* u = new cv::UMatData(this);
+        u->data = u->origdata = data;
+        u->size = result.step[0] * result.rows;
+        u->userdata = new QImage(image);
+        u->refcount = 1;
 
-    for (int x(0); x < image.width(); ++x)
+        result.u = u;
+        result.allocator = const_cast<QImageMatAllocator*>(this);
+        return result;
+    }
+
+    cv::UMatData* allocate(int dims,
+                           const int* sizes,
+                           int type,
+                           void* data,
+                           size_t* step,
+                           cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override
+    {
+        return cv::Mat::getStdAllocator()->allocate(
+          dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data,
+                  cv::AccessFlag accessflags,
+                  cv::UMatUsageFlags usageFlags) const override
     {
-        for (int y(0); y < image.height(); ++y)
+        return cv::Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override
+    {
+        if (data)
         {
-            QColor color = image.pixelColor(x, y);
-            result.at<cv::Vec3b>(y, x) = cv::Vec3b(color.blue(), color.green(), color.red());
+            delete static_cast<QImage*>(data->userdata);
+            delete data;
         }
     }
+};
 
+/**
+ * @brief returns the OpenCV type sharing the memory layout of a QImage format
+ * @return -1 if there is no such type
+ */
+inline int opencv_type(QImage::Format format)
+{
+    switch (format)
+    {
+    case QImage::Format_Grayscale8:
+        return CV_8UC1;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    case QImage::Format_BGR888:
+        return CV_8UC3;
+#endif
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        return CV_8UC4;
+#endif
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief returns the QImage format sharing the memory layout of an OpenCV type
+ * @param type         the OpenCV type
+ * @param rgba_format  format of 4-channel matrices, QImage::Format_ARGB32 or
+ *                     QImage::Format_RGB32 if their alpha channel is known to
+ *                     be opaque (and can be ignored)
+ * @return QImage::Format_Invalid if there is no such format
+ */
+inline QImage::Format qimage_format(int type,
+                                    QImage::Format rgba_format = QImage::Format_ARGB32)
+{
+    switch (type)
+    {
+    case CV_8UC1:
+        return QImage::Format_Grayscale8;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    case CV_8UC3:
+        return QImage::Format_BGR888;
+#endif
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    case CV_8UC4:
+        return rgba_format == QImage::Format_RGB32 ? QImage::Format_RGB32
+                                                   : QImage::Format_ARGB32;
+#endif
+    default:
+        return QImage::Format_Invalid;
+    }
+}
+
+/**
+ * @brief returns whether a matrix can be used as the buffer of a QImage
+ *
+ * Besides a matching pixel format, this requires a 2D matrix whose stride
+ * fits in an int and, for 32-bit formats, 4-byte aligned rows.
+ */
+inline bool can_share_with_qimage(const cv::Mat& mat)
+{
+    if (mat.empty() || mat.dims != 2 || mat.step[0] > size_t(INT_MAX)
+        || qimage_format(mat.type()) == QImage::Format_Invalid)
+    {
+        return false;
+    }
+
+    if (mat.elemSize() == 4)
+    {
+        return reinterpret_cast<std::uintptr_t>(mat.data) % 4 == 0 && mat.step[0] % 4 == 0;
+    }
+
+    return true;
+}
+
+} // namespace cutecv
+
+/**
+ * @brief returns an OpenCV matrix with the content of a QImage
+ * @param image  the image
+ *
+ * If the layout of the image is compatible with OpenCV, the returned matrix
+ * shares the pixels of the image (no copy is made); otherwise the image is
+ * first converted (row by row) to a compatible format.
+ * QImage::Format_RGB888 images are converted to BGR by the SIMD kernels of
+ * ocvp::convert_pixels().
+ * The result has 1 (grayscale), 3 (BGR) or 4 (BGRA) channels.
+ *
+ * @warning the pixels may be shared with @a image and its copies, so the
+ * result must be treated as read-only; use to_opencv_writable() to draw on
+ * an image.
+ */
+inline cv::Mat to_opencv(const QImage& image)
+{
+    if (image.isNull())
+    {
+        return cv::Mat();
+    }
+
+    int type = cutecv::opencv_type(image.format());
+
+    if (type != -1)
+    {
+        return cutecv::QImageMatAllocator::instance().wrap(
+          image, const_cast<uchar*>(image.constBits()), type);
+    }
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    if (image.format() != QImage::Format_RGB888)
+    {
+        return to_opencv(image.convertToFormat(QImage::Format_RGB32));
+    }
+
+    const QImage& rgb = image;
+#else
+    QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+#endif
+
+    cv::Mat view{ rgb.height(),
+                  rgb.width(),
+                  CV_8UC3,
+                  const_cast<uchar*>(rgb.constBits()),
+                  size_t(rgb.bytesPerLine()) };
+    cv::Mat result;
+    ocvp::convert_pixels(view, result, ocvp::PixelConversion::RGB_TO_BGR);
     return result;
 }
 
-inline QImage to_qimage(const cv::Mat& img)
+/**
+ * @brief returns an OpenCV matrix through which a QImage can be modified
+ * @param image  the image, converted in place if its format isn't compatible
+ *
+ * The image is detached from its other copies (if any), so that writing
+ * into the returned matrix modifies @a image and only @a image.
+ */
+inline cv::Mat to_opencv_writable(QImage& image)
 {
-    QImage result{ img.cols, img.rows, QImage::Format_RGB32 };
+    if (image.isNull())
+    {
+        return cv::Mat();
+    }
 
-    for (int x(0); x < result.width(); ++x)
+    int type = cutecv::opencv_type(image.format());
+
+    if (type == -1)
     {
-        for (int y(0); y < result.height(); ++y)
+        image = image.convertToFormat(QImage::Format_RGB32);
+        type = cutecv::opencv_type(image.format());
+
+        if (type == -1)
         {
-            cv::Vec3b color = img.at<cv::Vec3b>(y, x);
-            result.setPixelColor(x, y, QColor(color[2], color[1], color[0]));
+            return cv::Mat(); // big-endian, no format compatible with OpenCV
         }
     }
 
+    uchar* data = image.bits();
+    return cutecv::QImageMatAllocator::instance().wrap(image, data, type);
+}
+
+/**
+ * @brief returns a QImage with the content of an OpenCV matrix
+ * @param img          the matrix (1, 3 or 4 channels, BGR channel order)
+ * @param rgba_format  format of the image if @a img has 4 channels, see
+ *                     cutecv::qimage_format()
+ *
+ * If the layout of the matrix is compatible with Qt, the returned image
+ * shares the pixels of the matrix (no copy is made) and keeps them alive.
+ * The image is read-only: modifying it detaches it from the matrix.
+ * Otherwise the matrix is converted row by row.
+ */
+inline QImage to_qimage(const cv::Mat& img, QImage::Format rgba_format = QImage::Format_ARGB32)
+{
+    if (cutecv::can_share_with_qimage(img))
+    {
+        auto* owner = new cv::Mat(img);
+
+        return QImage(
+          static_cast<const uchar*>(owner->data),
+          owner->cols,
+          owner->rows,
+          static_cast<int>(owner->step[0]),
+          cutecv::qimage_format(owner->type(), rgba_format),
+          [](void* info) { delete static_cast<cv::Mat*>(info); },
+          owner);
+    }
+
+    if (img.empty() || img.dims != 2)
+    {
+        return QImage();
+    }
+
+    if (img.depth() != CV_8U)
+    {
+        cv::Mat converted;
+        img.convertTo(converted, CV_8U);
+        return to_qimage(converted, rgba_format);
+    }
+
+    QImage result{ img.cols,
+                   img.rows,
+                   img.channels() == 4 && rgba_format != QImage::Format_RGB32
+                     ? QImage::Format_ARGB32
+                     : QImage::Format_RGB32 };
+    cv::Mat view = to_opencv_writable(result);
+
+    switch (img.channels())
+    {
+    case 1:
+        cv::cvtColor(img, view, cv::COLOR_GRAY2BGRA);
+        break;
+    case 3:
+        ocvp::convert_pixels(img, view, ocvp::PixelConversion::BGR_TO_RGB32);
+        break;
+    case 4:
+        img.copyTo(view);
+        break;
+    default:
+        return QImage();
+    }
+
     return result;
 }
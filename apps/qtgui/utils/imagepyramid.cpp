@@ -0,0 +1,224 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "imagepyramid.h"
+
+#include "cutecv.h"
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QPointer>
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+constexpr int ImagePyramid::tile_size;
+
+/**
+ * Levels shared with the worker thread.
+ */
+struct ImagePyramid::Levels
+{
+    std::mutex mutex;
+    std::vector<QImage> images; ///< levels built so far, starting at level 0
+    std::atomic<bool> cancelled{ false };
+    std::atomic<bool> complete{ false };
+    std::atomic<bool> finished{ false }; ///< whether the worker has returned
+};
+
+ImagePyramid::ImagePyramid(QObject* parent)
+  : QObject(parent)
+{
+}
+
+/**
+ * @brief stops the construction of the pyramid
+ *
+ * The destructor waits for the levels being built, if any, including those
+ * of the images set previously.
+ */
+ImagePyramid::~ImagePyramid()
+{
+    cancel();
+
+    for (auto& worker : m_cancelled_workers)
+    {
+        worker.first.join();
+    }
+}
+
+/**
+ * @brief returns the full-resolution image, i.e. level 0
+ */
+const QImage& ImagePyramid::image() const
+{
+    return m_image;
+}
+
+/**
+ * @brief sets the image and starts building its pyramid in the background
+ * @param image
+ *
+ * The construction of the pyramid of the previous image, if any, is
+ * cancelled without waiting for the level being built.
+ */
+void ImagePyramid::setImage(const QImage& image)
+{
+    cancel();
+
+    m_image = image;
+    m_levels = std::make_shared<Levels>();
+    m_levels->images.push_back(image);
+
+    if (image.isNull() || std::max(image.width(), image.height()) <= tile_size)
+    {
+        m_levels->complete = true;
+        return;
+    }
+
+    std::shared_ptr<Levels> levels = m_levels;
+    QPointer<ImagePyramid> pyramid{ this };
+
+    m_worker = std::thread(
+      [pyramid, levels, image]()
+      {
+          cv::Mat current = to_opencv(image);
+          // 4-channel levels are opaque unless the image has an alpha channel
+          const QImage::Format rgba_format =
+            image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+
+          for (int index(1); std::max(current.cols, current.rows) > tile_size; ++index)
+          {
+              cv::Mat next;
+              cv::resize(current,
+                         next,
+                         cv::Size((current.cols + 1) / 2, (current.rows + 1) / 2),
+                         0,
+                         0,
+                         cv::INTER_AREA);
+
+              if (levels->cancelled)
+              {
+                  break;
+              }
+
+              {
+                  std::lock_guard<std::mutex> lock{ levels->mutex };
+                  levels->images.push_back(to_qimage(next, rgba_format));
+              }
+
+              // set before the signal of the last level, so that the repaint it
+              // triggers sees the pyramid complete
+              if (std::max(next.cols, next.rows) <= tile_size)
+              {
+                  levels->complete = true;
+              }
+
+              // the signal is emitted by the GUI thread, and only if the pyramid
+              // still exists and still shows these levels
+              QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [pyramid, levels, index]()
+                {
+                    if (pyramid && !levels->cancelled)
+                    {
+                        Q_EMIT pyramid->levelReady(index);
+                    }
+                },
+                Qt::QueuedConnection);
+
+              current = next;
+          }
+
+          levels->finished = true;
+      });
+}
+
+/**
+ * @brief returns the number of levels built so far
+ */
+int ImagePyramid::nbLevels() const
+{
+    if (!m_levels)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock{ m_levels->mutex };
+    return static_cast<int>(m_levels->images.size());
+}
+
+/**
+ * @brief returns whether all the levels have been built
+ */
+bool ImagePyramid::isComplete() const
+{
+    return !m_levels || m_levels->complete;
+}
+
+/**
+ * @brief returns a level of the pyramid
+ * @param index  index of the level, less than nbLevels()
+ */
+QImage ImagePyramid::level(int index) const
+{
+    std::lock_guard<std::mutex> lock{ m_levels->mutex };
+    return m_levels->images.at(index);
+}
+
+/**
+ * @brief returns the coarsest level whose resolution is not below a given scale
+ * @param scale  size of a pixel of the image on the screen
+ *
+ * Levels that are not built yet are not considered.
+ */
+int ImagePyramid::levelForScale(double scale) const
+{
+    return std::max(0, std::min(idealLevel(scale), nbLevels() - 1));
+}
+
+/**
+ * @brief returns the coarsest level whose resolution is not below a given scale,
+ * ignoring the number of levels of the pyramid
+ */
+int ImagePyramid::idealLevel(double scale)
+{
+    return scale > 0 ? std::max(0, static_cast<int>(std::floor(std::log2(1 / scale)))) : 0;
+}
+
+/*
+ * Stops the worker after the level being built. So that the GUI thread does
+ * not wait for it, it is only joined once it has returned, here the next
+ * time a worker is cancelled, or in the destructor.
+ */
+void ImagePyramid::cancel()
+{
+    auto finished = std::partition(
+      m_cancelled_workers.begin(),
+      m_cancelled_workers.end(),
+      [](const std::pair<std::thread, std::shared_ptr<Levels>>& worker)
+      { return !worker.second->finished; });
+
+    for (auto it = finished; it != m_cancelled_workers.end(); ++it)
+    {
+        it->first.join();
+    }
+
+    m_cancelled_workers.erase(finished, m_cancelled_workers.end());
+
+    if (m_levels)
+    {
+        m_levels->cancelled = true;
+    }
+
+    if (m_worker.joinable())
+    {
+        m_cancelled_workers.emplace_back(std::move(m_worker), m_levels);
+    }
+}
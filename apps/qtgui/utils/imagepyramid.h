@@ -0,0 +1,61 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QObject>
+
+#include <QImage>
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief the successive half-resolution versions of an image
+ *
+ * Level 0 is the image itself; level i + 1 is level i downscaled by 2 (with
+ * an area filter), down to the first level that fits in a single tile.
+ * The levels beyond 0 are built by a background thread, in order, and
+ * levelReady() is emitted as each one becomes available.
+ */
+class ImagePyramid : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int tile_size = 256;
+
+    explicit ImagePyramid(QObject* parent = nullptr);
+    ~ImagePyramid();
+
+    const QImage& image() const;
+    void setImage(const QImage& image);
+
+    int nbLevels() const;
+    bool isComplete() const;
+    QImage level(int index) const;
+    int levelForScale(double scale) const;
+
+    static int idealLevel(double scale);
+
+Q_SIGNALS:
+    /**
+     * @brief this signal is emitted when a level has been built
+     */
+    void levelReady(int index);
+
+private:
+    void cancel();
+
+private:
+    struct Levels;
+    QImage m_image;
+    std::shared_ptr<Levels> m_levels;
+    std::thread m_worker;
+    std::vector<std::pair<std::thread, std::shared_ptr<Levels>>> m_cancelled_workers;
+};
+
+#endif // IMAGEPYRAMID_H
@@ -4,7 +4,12 @@
 
 #include "drawingsurface.h"
 
+#include <QGuiApplication>
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QScreen>
+#include <QWheelEvent>
 
 #include <QBrush>
 #include <QPainter>
@@ -13,13 +18,61 @@
 #include <QVector2D>
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 #include <utility>
 
+namespace
+{
+
+constexpr int contour_pen_width = 6;
+
+// Maximum distance (in screen pixels) the mouse may move between the press
+// and the release of the button for a click to create a control point;
+// beyond it, the picture is panned.
+constexpr int jitter_threshold = 6;
+
+constexpr double zoom_step = 1.25;
+constexpr double max_scale = 32;
+
+// Rectangle covered by a segment of the contour, antialiasing included
+QRect segmentRect(const QPointF& a, const QPointF& b)
+{
+    constexpr int margin = contour_pen_width / 2 + 2;
+    return QRectF(a, b).normalized().toAlignedRect().adjusted(-margin, -margin, margin, margin);
+}
+
+quint64 tileKey(int level, int row, int col)
+{
+    return (quint64(level) << 48) | (quint64(row) << 24) | quint64(col);
+}
+
+} // namespace
+
 DrawingSurface::DrawingSurface(QWidget* parent)
   : QWidget(parent)
 {
     setMouseTracking(true); // we want to receive mouse "hover" events
+
+    m_modified_timer.setSingleShot(true);
+    connect(&m_modified_timer,
+            &QTimer::timeout,
+            this,
+            &DrawingSurface::controlPointsModified);
+
+    // a level finer than needed may have been drawn while this one was built
+    connect(&m_pyramid,
+            &ImagePyramid::levelReady,
+            this,
+            [this](int index)
+            {
+                if (index <= ImagePyramid::idealLevel(m_scale))
+                {
+                    update();
+                }
+            });
+
+    updateTileCacheSize();
 }
 
 DrawingSurface::~DrawingSurface()
@@ -28,18 +81,14 @@ DrawingSurface::~DrawingSurface()
 
 const QImage& DrawingSurface::backgroundImage() const
 {
-    return m_background_image;
+    return m_pyramid.image();
 }
 
 void DrawingSurface::setBackgroungImage(const QImage& img)
 {
-    m_background_image = img;
-
-    if (!img.isNull())
-    {
-        setFixedSize(img.size());
-    }
-
+    m_tiles.clear();
+    m_pyramid.setImage(img);
+    zoomToFit();
     update();
 }
 
@@ -56,6 +105,7 @@ QPoint DrawingSurface::controlPointPosition(int index) const
 void DrawingSurface::setControlPointPosition(int index, const QPoint& pos)
 {
     dragControlPoint(m_controlpoints[index].get(), pos);
+    flushControlPointsModified();
 }
 
 std::vector<QPoint> DrawingSurface::controlPoints() const
@@ -79,24 +129,77 @@ QImage DrawingSurface::pictureWithContour() const
 
     {
         QPainter painter{ &img };
-        drawContour(painter);
+        drawContour(painter, QTransform());
     }
 
     return img;
 }
 
+/**
+ * @brief returns the size on the screen of a pixel of the picture
+ */
+double DrawingSurface::scale() const
+{
+    return m_scale;
+}
+
+/**
+ * @brief zooms the picture
+ * @param scale   the new scale, bounded by that of the whole picture and 32
+ * @param anchor  point of the widget that shows the same point of the picture after the zoom
+ */
+void DrawingSurface::setScale(double scale, const QPointF& anchor)
+{
+    const QPointF picture_point = anchor / m_scale + m_origin;
+    m_scale = std::max(std::min(fitScale(), 1.0), std::min(scale, max_scale));
+    setOrigin(picture_point - anchor / m_scale);
+}
+
+QSize DrawingSurface::sizeHint() const
+{
+    return QSize(800, 600);
+}
+
+void DrawingSurface::zoomIn()
+{
+    setScale(m_scale * zoom_step, QPointF(width(), height()) / 2);
+}
+
+void DrawingSurface::zoomOut()
+{
+    setScale(m_scale / zoom_step, QPointF(width(), height()) / 2);
+}
+
+void DrawingSurface::zoomToFit()
+{
+    setScale(fitScale(), QPointF(width(), height()) / 2);
+}
+
+void DrawingSurface::zoomToActualSize()
+{
+    setScale(1, QPointF(width(), height()) / 2);
+}
+
 void DrawingSurface::enterEvent(QEvent* ev)
 {
     QWidget::enterEvent(ev);
     m_under_mouse = true;
-    update();
+
+    for (auto& cp : m_controlpoints)
+    {
+        update(controlPointRect(*cp));
+    }
 }
 
 void DrawingSurface::leaveEvent(QEvent* ev)
 {
     QWidget::leaveEvent(ev);
     m_under_mouse = false;
-    update();
+
+    for (auto& cp : m_controlpoints)
+    {
+        update(controlPointRect(*cp));
+    }
 }
 
 void DrawingSurface::mousePressEvent(QMouseEvent* ev)
@@ -109,7 +212,7 @@ void DrawingSurface::mousePressEvent(QMouseEvent* ev)
                            m_controlpoints.end(),
                            [](const ControlPointPtr& cp) { return cp->under_mouse; });
 
-    if (it != m_controlpoints.end())
+    if (it != m_controlpoints.end() && ev->button() != Qt::MiddleButton)
     {
         // Start a "drag" operation
         ControlPointDragOperation op;
@@ -118,13 +221,13 @@ void DrawingSurface::mousePressEvent(QMouseEvent* ev)
     }
     else
     {
-        // Start a "create" operation
-        if (m_controlpoints.size() < 4)
-        {
-            ControlPointCreateOperation op;
-            op.press_pos = ev->pos();
-            m_create_operation = std::make_unique<ControlPointCreateOperation>(op);
-        }
+        // Start a "create" operation, that becomes a pan if the mouse moves;
+        // the middle button always pans
+        ControlPointCreateOperation op;
+        op.press_pos = ev->pos();
+        op.press_origin = m_origin;
+        op.panning = ev->button() == Qt::MiddleButton;
+        m_create_operation = std::make_unique<ControlPointCreateOperation>(op);
     }
 }
 
@@ -132,11 +235,21 @@ void DrawingSurface::mouseMoveEvent(QMouseEvent* ev)
 {
     if (m_create_operation)
     {
-        // no-op
+        const QPoint delta = ev->pos() - m_create_operation->press_pos;
+
+        if (delta.manhattanLength() > jitter_threshold)
+        {
+            m_create_operation->panning = true;
+        }
+
+        if (m_create_operation->panning)
+        {
+            setOrigin(m_create_operation->press_origin - QPointF(delta) / m_scale);
+        }
     }
     else if (m_drag_operation)
     {
-        dragControlPoint(m_drag_operation->controlpoint, ev->pos());
+        dragControlPoint(m_drag_operation->controlpoint, mapToImage(ev->pos()));
     }
     else
     {
@@ -151,82 +264,335 @@ void DrawingSurface::mouseReleaseEvent(QMouseEvent* ev)
 {
     if (m_create_operation)
     {
-        constexpr int jitter_threshold = 6;
+        const QPoint pos = mapToImage(ev->pos());
 
-        if ((ev->pos() - m_create_operation->press_pos).manhattanLength() <= jitter_threshold)
+        if (!m_create_operation->panning && backgroundImage().rect().contains(pos))
         {
             ControlPoint cp;
-            cp.pos = ev->pos();
+            cp.pos = pos;
 
+            // the new point replaces the closing segment of its contour
+            const size_t group = m_controlpoints.size() / 4 * 4;
+            update(contourRegion(group));
             m_controlpoints.push_back(std::make_unique<ControlPoint>(cp));
+            update(contourRegion(group));
 
+            m_modified_timer.stop();
             Q_EMIT controlPointCreated();
             Q_EMIT controlPointsModified();
-
-            update();
         }
 
         m_create_operation.reset();
     }
     else if (m_drag_operation)
     {
-        dragControlPoint(m_drag_operation->controlpoint, ev->pos());
+        dragControlPoint(m_drag_operation->controlpoint, mapToImage(ev->pos()));
         m_drag_operation.reset();
+        flushControlPointsModified();
     }
 }
 
-void DrawingSurface::paintEvent(QPaintEvent* /* ev */)
+void DrawingSurface::wheelEvent(QWheelEvent* ev)
+{
+    const double steps = ev->angleDelta().y() / 120.0;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const QPointF anchor = ev->position();
+#else
+    const QPointF anchor = ev->posF();
+#endif
+
+    setScale(m_scale * std::pow(zoom_step, steps), anchor);
+}
+
+void DrawingSurface::resizeEvent(QResizeEvent* ev)
+{
+    QWidget::resizeEvent(ev);
+    updateTileCacheSize();
+    setScale(m_scale, QPointF());
+}
+
+void DrawingSurface::paintEvent(QPaintEvent* ev)
 {
     QPainter painter{ this };
 
-    painter.drawImage(0, 0, backgroundImage());
+    for (const QRect& rect : ev->region())
+    {
+        drawBackground(painter, rect);
+    }
 
     if (!m_controlpoints.empty())
     {
-        drawContour(painter, m_under_mouse);
+        // control points are drawn at the center of their pixel
+        const QTransform transform = QTransform::fromTranslate(0.5, 0.5) * viewTransform();
+        drawContour(painter, transform, m_under_mouse, ev->rect());
     }
 }
 
+/**
+ * @brief returns the transform from the coordinates of the picture to those of the widget
+ *
+ * The pixel (i, j) of the picture covers the square [i, i+1] x [j, j+1].
+ */
+QTransform DrawingSurface::viewTransform() const
+{
+    return QTransform(m_scale, 0, 0, m_scale, -m_origin.x() * m_scale, -m_origin.y() * m_scale);
+}
+
+// Position in the widget of the center of a pixel of the picture
+QPointF DrawingSurface::mapToView(const QPoint& imagePos) const
+{
+    return viewTransform().map(QPointF(imagePos) + QPointF(0.5, 0.5));
+}
+
+// Pixel of the picture under a pixel of the widget
+QPoint DrawingSurface::mapToImage(const QPoint& widgetPos) const
+{
+    const QPointF p = (QPointF(widgetPos) + QPointF(0.5, 0.5)) / m_scale + m_origin;
+    return QPoint(static_cast<int>(std::floor(p.x())), static_cast<int>(std::floor(p.y())));
+}
+
+// Scale at which the whole picture fits in the widget
+double DrawingSurface::fitScale() const
+{
+    const QSize size = backgroundImage().size();
+
+    if (size.isEmpty() || width() <= 0 || height() <= 0)
+    {
+        return 1;
+    }
+
+    return std::min(double(width()) / size.width(), double(height()) / size.height());
+}
+
+// Sets the point of the picture at the top-left corner of the widget; a
+// picture smaller than the widget is centered, a larger one covers it.
+void DrawingSurface::setOrigin(const QPointF& origin)
+{
+    const QSize size = backgroundImage().size();
+
+    auto clamp = [](double value, double extent, double view_extent)
+    {
+        if (view_extent >= extent)
+        {
+            return (extent - view_extent) / 2;
+        }
+
+        return std::max(0.0, std::min(value, extent - view_extent));
+    };
+
+    m_origin = QPointF(clamp(origin.x(), size.width(), width() / m_scale),
+                       clamp(origin.y(), size.height(), height() / m_scale));
+    update();
+}
+
+// The tiles of the chosen level are displayed with a size between
+// tile_size / 2 and tile_size (or more, beyond 1:1): the cache holds the
+// visible tiles of two levels, so that zooming back and forth does not
+// rebuild them.
+void DrawingSurface::updateTileCacheSize()
+{
+    const int min_tile_size = ImagePyramid::tile_size / 2;
+    const int cols = width() / min_tile_size + 2;
+    const int rows = height() / min_tile_size + 2;
+    m_tiles.setMaxCost(std::max(1, 2 * cols * rows));
+}
+
+void DrawingSurface::drawBackground(QPainter& painter, const QRect& rect)
+{
+    painter.fillRect(rect, palette().color(QPalette::Dark));
+
+    if (backgroundImage().isNull())
+    {
+        return;
+    }
+
+    // while the pyramid is being built, the coarsest level built so far
+    // stands in for the one that matches the scale
+    const int ideal_level = ImagePyramid::idealLevel(m_scale);
+    const int level = m_pyramid.levelForScale(m_scale);
+    const bool partial = level < ideal_level && !m_pyramid.isComplete();
+    const QImage image = m_pyramid.level(level);
+    const double level_scale = m_scale * std::ldexp(1.0, level);
+
+    painter.save();
+    painter.setClipRect(rect);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, level_scale != 1 && !partial);
+    painter.setTransform(QTransform::fromScale(level_scale, level_scale)
+                         * QTransform::fromTranslate(-m_origin.x() * m_scale,
+                                                     -m_origin.y() * m_scale));
+
+    const QRect visible = painter.transform()
+                            .inverted()
+                            .mapRect(QRectF(rect))
+                            .toAlignedRect()
+                            .intersected(image.rect());
+
+    if (partial)
+    {
+        // the level is finer than needed: it is drawn without smoothing, to
+        // keep the cost of a repaint close to the number of pixels of the
+        // widget, and its tiles are not cached, so that the cache stays
+        // bounded until the right level is built
+        painter.drawImage(visible, image, visible);
+        painter.restore();
+        return;
+    }
+
+    constexpr int tile_size = ImagePyramid::tile_size;
+
+    for (int row(visible.top() / tile_size); row <= visible.bottom() / tile_size; ++row)
+    {
+        for (int col(visible.left() / tile_size); col <= visible.right() / tile_size; ++col)
+        {
+            const QRect tile_rect = QRect(col * tile_size, row * tile_size, tile_size, tile_size)
+                                      .intersected(image.rect());
+            const quint64 key = tileKey(level, row, col);
+            QPixmap* cached = m_tiles.object(key);
+            const QPixmap tile = cached ? *cached : QPixmap::fromImage(image.copy(tile_rect));
+
+            painter.drawPixmap(tile_rect.topLeft(), tile);
+
+            if (!cached)
+            {
+                m_tiles.insert(key, new QPixmap(tile));
+            }
+        }
+    }
+
+    painter.restore();
+}
+
 void DrawingSurface::updateControlPointsUnderMouseState(const QPoint& mousePos)
 {
     for (auto& cp : m_controlpoints)
     {
-        bool under_mouse = QVector2D(cp->pos - mousePos).length() <= cp->radius;
+        const QPointF offset = mapToView(cp->pos) - QPointF(mousePos);
+        bool under_mouse = QVector2D(offset).length() <= cp->radius;
 
         if (std::exchange(cp->under_mouse, under_mouse) != under_mouse)
         {
             // schedule a redraw if the state has changed
-            update();
+            update(controlPointRect(*cp));
         }
     }
 }
 
-void DrawingSurface::dragControlPoint(ControlPoint* cp, const QPoint& mousePos)
+void DrawingSurface::dragControlPoint(ControlPoint* cp, const QPoint& imagePos)
+{
+    if (cp->pos != imagePos)
+    {
+        using ControlPointPtr = std::unique_ptr<ControlPoint>;
+        auto it = std::find_if(m_controlpoints.begin(),
+                               m_controlpoints.end(),
+                               [cp](const ControlPointPtr& p) { return p.get() == cp; });
+        const size_t index = std::distance(m_controlpoints.begin(), it);
+
+        update(controlPointRegion(index));
+        cp->pos = imagePos;
+        update(controlPointRegion(index));
+
+        scheduleControlPointsModified();
+    }
+}
+
+// Emits controlPointsModified() at the next display frame, with the
+// modifications made in the meantime
+void DrawingSurface::scheduleControlPointsModified()
+{
+    if (m_modified_timer.isActive())
+    {
+        return;
+    }
+
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    const qreal refresh_rate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60;
+    m_modified_timer.start(std::max(1, qRound(1000 / refresh_rate)));
+}
+
+// Emits the pending controlPointsModified() signal, if any, now
+void DrawingSurface::flushControlPointsModified()
 {
-    if (cp->pos != mousePos)
+    if (m_modified_timer.isActive())
     {
-        cp->pos = mousePos;
+        m_modified_timer.stop();
         Q_EMIT controlPointsModified();
-        update();
     }
 }
 
-void DrawingSurface::drawContour(QPainter& painter, bool drawControlPoints) const
+QRect DrawingSurface::controlPointRect(const ControlPoint& cp) const
+{
+    const double margin = cp.radius + 2;
+    const QPointF center = mapToView(cp.pos);
+    return QRectF(center - QPointF(margin, margin), center + QPointF(margin, margin))
+      .toAlignedRect();
+}
+
+// Part of the widget covered by a control point and the segments ending at it
+QRegion DrawingSurface::controlPointRegion(size_t index) const
+{
+    const size_t group = index / 4 * 4;
+    const size_t n = std::min<size_t>(4, m_controlpoints.size() - group);
+    const size_t i = index - group;
+    const QPointF pos = mapToView(m_controlpoints.at(index)->pos);
+
+    QRegion region{ controlPointRect(*m_controlpoints.at(index)) };
+    region += segmentRect(mapToView(m_controlpoints.at(group + (i + n - 1) % n)->pos), pos);
+    region += segmentRect(pos, mapToView(m_controlpoints.at(group + (i + 1) % n)->pos));
+    return region;
+}
+
+// Part of the widget covered by the contour starting at control point group
+QRegion DrawingSurface::contourRegion(size_t group) const
+{
+    QRegion region;
+
+    for (size_t i(group); i < std::min(group + 4, m_controlpoints.size()); ++i)
+    {
+        region += controlPointRegion(i);
+    }
+
+    return region;
+}
+
+/**
+ * @brief draws the contours and, optionally, the control points
+ * @param painter
+ * @param transform  maps the positions of the control points to the coordinates of the painter
+ * @param drawControlPoints
+ * @param clip  if valid, the parts that do not intersect this rectangle are skipped
+ *
+ * Lines and control points have the same size whatever the transform.
+ */
+void DrawingSurface::drawContour(QPainter& painter,
+                                 const QTransform& transform,
+                                 bool drawControlPoints,
+                                 const QRect& clip) const
 {
     painter.save();
 
     painter.setRenderHint(QPainter::Antialiasing);
 
     QPen pen{ Qt::red };
-    pen.setWidth(6);
+    pen.setWidth(contour_pen_width);
     painter.setPen(pen);
 
-    for (size_t i(0); i < m_controlpoints.size(); ++i)
+    // each group of 4 points is the contour of a sheet
+    for (size_t group(0); group < m_controlpoints.size(); group += 4)
     {
-        const ControlPoint& first = *m_controlpoints.at(i);
-        const ControlPoint& second = *m_controlpoints.at((i + 1) % m_controlpoints.size());
+        const size_t n = std::min<size_t>(4, m_controlpoints.size() - group);
 
-        painter.drawLine(first.pos, second.pos);
+        for (size_t i(0); i < n; ++i)
+        {
+            const QPointF first = transform.map(QPointF(m_controlpoints.at(group + i)->pos));
+            const QPointF second =
+              transform.map(QPointF(m_controlpoints.at(group + (i + 1) % n)->pos));
+
+            if (!clip.isValid() || clip.intersects(segmentRect(first, second)))
+            {
+                painter.drawLine(first, second);
+            }
+        }
     }
 
     if (drawControlPoints)
@@ -235,8 +601,17 @@ void DrawingSurface::drawContour(QPainter& painter, bool drawControlPoints) cons
 
         for (auto& cp : m_controlpoints)
         {
+            const QPointF center = transform.map(QPointF(cp->pos));
+            const QPointF extent{ cp->radius + 2.0, cp->radius + 2.0 };
+
+            if (clip.isValid() && !clip.intersects(QRectF(center - extent, center + extent)
+                                                     .toAlignedRect()))
+            {
+                continue;
+            }
+
             painter.setBrush(QBrush(cp->under_mouse ? Qt::cyan : Qt::blue));
-            painter.drawEllipse(cp->pos, cp->radius, cp->radius);
+            painter.drawEllipse(center, cp->radius, cp->radius);
         }
     }
 
@@ -5,15 +5,35 @@
 #ifndef DRAWINGSURFACE_H
 #define DRAWINGSURFACE_H
 
+#include "../utils/imagepyramid.h"
+
 #include <QWidget>
 
+#include <QCache>
 #include <QImage>
+#include <QPixmap>
+#include <QRegion>
+#include <QTimer>
+#include <QTransform>
 
 #include <memory>
 #include <vector>
 
 /**
  * @brief a widget in which the user can draw the contour of an object
+ *
+ * Beyond 4 control points, each group of 4 points is drawn as a separate
+ * contour, i.e. a sheet of paper.
+ *
+ * The picture can be zoomed (with the mouse wheel) and panned (by dragging
+ * it). It is drawn from an ImagePyramid, tile by tile, at the level that
+ * matches the zoom; only the visible tiles are converted to pixmaps, so
+ * that the memory used by the view depends on the size of the widget, not
+ * on that of the picture. Control points are stored in pixels of the
+ * full-resolution picture.
+ *
+ * Only the parts of the widget covered by the edited segments and control
+ * points are repainted.
  */
 class DrawingSurface : public QWidget
 {
@@ -32,6 +52,17 @@ public:
 
     QImage pictureWithContour() const;
 
+    double scale() const;
+    void setScale(double scale, const QPointF& anchor);
+
+    QSize sizeHint() const override;
+
+public Q_SLOTS:
+    void zoomIn();
+    void zoomOut();
+    void zoomToFit();
+    void zoomToActualSize();
+
 Q_SIGNALS:
     /**
      * @brief this signal is emitted when a control point has been created
@@ -40,6 +71,9 @@ Q_SIGNALS:
 
     /**
      * @brief this signal is emitted when a control point has been created or edited
+     *
+     * While a control point is dragged, the modifications are coalesced so
+     * that this signal is emitted at most once per display frame.
      */
     void controlPointsModified();
 
@@ -50,7 +84,9 @@ protected:
     void mousePressEvent(QMouseEvent* ev) override;
     void mouseMoveEvent(QMouseEvent* ev) override;
     void mouseReleaseEvent(QMouseEvent* ev) override;
+    void wheelEvent(QWheelEvent* ev) override;
 
+    void resizeEvent(QResizeEvent* ev) override;
     void paintEvent(QPaintEvent* ev) override;
 
 private:
@@ -59,14 +95,16 @@ private:
      */
     struct ControlPoint
     {
-        QPoint pos; ///< 2D position of the point (in pixels)
-        int radius = 8; ///< radius of the circle used to visualize the point
+        QPoint pos; ///< 2D position of the point (in pixels of the full-resolution picture)
+        int radius = 8; ///< radius of the circle used to visualize the point (in screen pixels)
         bool under_mouse = false; ///< whether the circle is under the mouse
     };
 
     struct ControlPointCreateOperation
     {
         QPoint press_pos; ///< position of mouse cursor when left button was pressed
+        QPointF press_origin; ///< origin of the view when left button was pressed
+        bool panning = false; ///< whether the mouse moved enough for the press to be a pan
     };
 
     struct ControlPointDragOperation
@@ -75,12 +113,32 @@ private:
     };
 
 private:
+    QTransform viewTransform() const;
+    QPointF mapToView(const QPoint& imagePos) const;
+    QPoint mapToImage(const QPoint& widgetPos) const;
+    double fitScale() const;
+    void setOrigin(const QPointF& origin);
+    void updateTileCacheSize();
+    void drawBackground(QPainter& painter, const QRect& rect);
+
     void updateControlPointsUnderMouseState(const QPoint& mousePos);
-    void dragControlPoint(ControlPoint* cp, const QPoint& mousePos);
-    void drawContour(QPainter& painter, bool drawControlPoints = false) const;
+    void dragControlPoint(ControlPoint* cp, const QPoint& imagePos);
+    void scheduleControlPointsModified();
+    void flushControlPointsModified();
+    QRect controlPointRect(const ControlPoint& cp) const;
+    QRegion controlPointRegion(size_t index) const;
+    QRegion contourRegion(size_t group) const;
+    void drawContour(QPainter& painter,
+                     const QTransform& transform,
+                     bool drawControlPoints = false,
+                     const QRect& clip = QRect()) const;
 
 private:
-    QImage m_background_image;
+    ImagePyramid m_pyramid;
+    QCache<quint64, QPixmap> m_tiles; ///< tiles of the pyramid, by level and position
+    double m_scale = 1; ///< size on the screen of a pixel of the picture
+    QPointF m_origin; ///< point of the picture at the top-left corner of the widget
+    QTimer m_modified_timer; ///< emits controlPointsModified() at the next display frame
     bool m_under_mouse = false; ///< whether the mouse cursor is over the widget
     std::vector<std::unique_ptr<ControlPoint>> m_controlpoints;
 
@@ -23,13 +23,50 @@ PnPResultWidget::PnPResultWidget(QImage image,
                                  const ocvp::DistortionCoefficients& distcoeffs,
                                  const ocvp::PnPResult& result,
                                  QWidget* parent)
+  : PnPResultWidget(image,
+                    intrinsics,
+                    distcoeffs,
+                    std::vector<ocvp::PnPResult>{ result },
+                    std::vector<int>{ 1 },
+                    parent)
+{
+}
+
+/**
+ * @brief constructs the widget for several sheets
+ * @param results  the poses of the sheets that were solved
+ * @param sheets   1-based number of the sheet of each result
+ */
+PnPResultWidget::PnPResultWidget(QImage image,
+                                 const ocvp::CameraIntrinsics& intrinsics,
+                                 const ocvp::DistortionCoefficients& distcoeffs,
+                                 const std::vector<ocvp::PnPResult>& results,
+                                 const std::vector<int>& sheets,
+                                 QWidget* parent)
   : QWidget(parent)
 {
-    cv::Mat cvimage = to_opencv(image);
-    ocvp::draw_frame_axes(cvimage, intrinsics, distcoeffs, result.rvec, result.tvec, 0.1);
+    // the frame axes are drawn directly into the pixels of m_image, the only
+    // copy made is the one that detaches m_image from the calibration picture
+    m_image = image.format() == QImage::Format_Grayscale8
+                ? image.convertToFormat(QImage::Format_RGB32)
+                : image;
+
+    {
+        cv::Mat cvimage = to_opencv_writable(m_image);
+
+        if (results.size() == 1)
+        {
+            const ocvp::PnPResult& result = results.front();
+            ocvp::draw_frame_axes(cvimage, intrinsics, distcoeffs, result.rvec, result.tvec, 0.1);
+        }
+        else
+        {
+            ocvp::draw_frame_axes_batch(
+              cvimage, ocvp::make_camera_model(intrinsics, distcoeffs), results, 0.1f);
+        }
+    }
 
     QLabel* label = new QLabel;
-    m_image = to_qimage(cvimage);
     label->setPixmap(QPixmap::fromImage(m_image));
     QScrollArea* scrollarea = new QScrollArea;
     scrollarea->setWidget(label);
@@ -46,10 +83,19 @@ PnPResultWidget::PnPResultWidget(QImage image,
             connect(export_button, &QPushButton::clicked, this, &PnPResultWidget::exportImage);
 
             auto* sublayout = new QVBoxLayout(rightcolumn);
-            sublayout->addWidget(createPnPResultGroupBox(result));
-            sublayout->addWidget(createPnPRotationMatrixGroupBox(result));
-            sublayout->addWidget(createCameraPositionGroupBox(result));
-            sublayout->addStretch(1);
+
+            if (results.size() == 1)
+            {
+                sublayout->addWidget(createPnPResultGroupBox(results.front()));
+                sublayout->addWidget(createPnPRotationMatrixGroupBox(results.front()));
+                sublayout->addWidget(createCameraPositionGroupBox(results.front()));
+                sublayout->addStretch(1);
+            }
+            else
+            {
+                sublayout->addWidget(createSheetsGroupBox(results, sheets), 1);
+            }
+
             sublayout->addWidget(export_button);
         }
 
@@ -164,3 +210,48 @@ QGroupBox* PnPResultWidget::createCameraPositionGroupBox(const ocvp::PnPResult&
 
     return box;
 }
+
+QGroupBox* PnPResultWidget::createSheetsGroupBox(const std::vector<ocvp::PnPResult>& results,
+                                                const std::vector<int>& sheets)
+{
+    auto* box = new QGroupBox(QString("%1 sheets").arg(results.size()));
+
+    auto* table = new QTableWidget(static_cast<int>(results.size()), 8);
+    table->setHorizontalHeaderLabels(QStringList() << "sheet"
+                                                   << "rx"
+                                                   << "ry"
+                                                   << "rz"
+                                                   << "tx"
+                                                   << "ty"
+                                                   << "tz"
+                                                   << "distance");
+
+    {
+        // the row numbers would not match those of the sheets if some failed
+        auto* vh = new QHeaderView(Qt::Vertical);
+        vh->hide();
+        table->setVerticalHeader(vh);
+    }
+
+    for (int r(0); r < table->rowCount(); ++r)
+    {
+        const ocvp::PnPResult& pnp = results.at(r);
+
+        table->setItem(r, 0, new QTableWidgetItem(QString::number(sheets.at(r))));
+
+        for (int i(0); i < 3; ++i)
+        {
+            table->setItem(r, i + 1, new QTableWidgetItem(QString::number(pnp.rvec.at<double>(i))));
+            table->setItem(r, i + 4, new QTableWidgetItem(QString::number(pnp.tvec.at<double>(i))));
+        }
+
+        double dist = cv::norm(ocvp::compute_camera_position(pnp.rvec, pnp.tvec));
+        table->setItem(r, 7, new QTableWidgetItem(QString::number(dist)));
+    }
+
+    auto* layout = new QVBoxLayout();
+    layout->addWidget(table);
+    box->setLayout(layout);
+
+    return box;
+}
@@ -11,6 +11,8 @@
 
 #include <QImage>
 
+#include <vector>
+
 class QGroupBox;
 
 /**
@@ -21,6 +23,10 @@ class QGroupBox;
  * - the rvec and tvec (in a table)
  * - the rotation matrix (in a table) 
  * - the position of the camera wrt. the world frame (in a table)
+ *
+ * When several sheets were solved, the frames of all the sheets are drawn
+ * and the poses are listed in a single table, one sheet per row, along with
+ * the number of the sheet (sheets that could not be solved are skipped).
  */
 class PnPResultWidget : public QWidget
 {
@@ -31,6 +37,12 @@ public:
                     const ocvp::DistortionCoefficients& distcoeffs,
                     const ocvp::PnPResult& result,
                     QWidget* parent = nullptr);
+    PnPResultWidget(QImage image,
+                    const ocvp::CameraIntrinsics& intrinsics,
+                    const ocvp::DistortionCoefficients& distcoeffs,
+                    const std::vector<ocvp::PnPResult>& results,
+                    const std::vector<int>& sheets,
+                    QWidget* parent = nullptr);
     ~PnPResultWidget();
 
 protected Q_SLOTS:
@@ -40,6 +52,8 @@ private:
     QGroupBox* createPnPResultGroupBox(const ocvp::PnPResult& pnp);
     QGroupBox* createPnPRotationMatrixGroupBox(const ocvp::PnPResult& pnp);
     QGroupBox* createCameraPositionGroupBox(const ocvp::PnPResult& pnp);
+    QGroupBox* createSheetsGroupBox(const std::vector<ocvp::PnPResult>& results,
+                                    const std::vector<int>& sheets);
 
 private:
     QImage m_image;
@@ -2,23 +2,70 @@
 // This file is part of the 'ocv-playground' project
 // For conditions of distribution and use, see copyright notice in LICENSE
 
-#include "ocvp/cli.h"
+#include "clihelpers.h"
+
+#include "ocvp/calibration.h"
 #include "ocvp/contour.h"
+#include "ocvp/detection.h"
 #include "ocvp/image.h"
 #include "ocvp/pnp.h"
+#include "ocvp/workerpool.h"
 
 #include <opencv2/calib3d.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
 
 struct Params
 {
-    ocvp::A4SheetOfPaper corner_coordinates;
+    std::vector<ocvp::TargetCorners> sheets;
+    std::string detect_image_path;
     std::string camera_json_path;
     std::string distortion_json_path;
+    std::string registry_path;
+    std::string camera_id;
+    std::string target;
     std::string result_json_path;
 };
 
+struct BatchParams
+{
+    std::string manifest_path;
+    std::string camera_json_path;
+    std::string distortion_json_path;
+    std::string registry_path;
+    std::string camera_id;
+    std::string calibration_dir;
+    std::string target;
+    std::string output_path;
+    size_t nb_jobs = 0;
+};
+
+/**
+ * @brief a PnP problem read from a line of a batch manifest
+ */
+struct BatchProblem
+{
+    ocvp::TargetCorners corner_coordinates;
+    std::string calibration_id;
+};
+
+struct BatchResult
+{
+    size_t line_number = 0;
+    ocvp::PnPResult result;
+    std::string error;
+};
+
 void print_help()
 {
     std::cout << "solvepnp: solves a  Perspective-n-Point (PnP) pose computation problem using A4 "
@@ -30,9 +77,50 @@ void print_help()
     std::cout << "description: " << std::endl;
     std::cout << "  points must be specified counter-clockwise starting at the bottom left corner"
               << std::endl;
+    std::cout << "  several sheets can be given, 4 points per sheet, in which case they are"
+              << std::endl;
+    std::cout << "  solved in parallel and the result of the i-th sheet (starting at 0) is"
+              << std::endl;
+    std::cout << "  saved in result_i.json" << std::endl;
     std::cout << "  <camera.json> specifies the camera intrinsic parameters" << std::endl;
     std::cout << "  <distortion.json> specifies the distortion coefficients" << std::endl;
     std::cout << "  [result.json] optional output file in which results are saved" << std::endl;
+    std::cout << "  in all modes, <camera.json> <distortion.json> can be replaced by" << std::endl;
+    std::cout << "  --registry <file> --camera-id <id> to use a camera of a registry file"
+              << std::endl;
+    std::cout << "  in all modes, --target <target> replaces the A4 sheet by another target:"
+              << std::endl;
+    std::cout << "  a4, a3, letter or a json file with its width and height (in meters)"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "usage: solvepnp --detect <image> <camera.json> <distortion.json> [result.json]"
+              << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  the corners of the sheet are detected in <image>" << std::endl;
+    std::cout << std::endl;
+    std::cout << "usage: solvepnp --batch <manifest> [<camera.json> <distortion.json>] [options]"
+              << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  solves one problem per line of <manifest> (use - for stdin)" << std::endl;
+    std::cout << "  <camera.json> <distortion.json> is the default calibration; it can be"
+              << std::endl;
+    std::cout << "  omitted if every line has a calibration id" << std::endl;
+    std::cout << "  a line is either CSV: x1,y1,x2,y2,x3,y3,x4,y4[,calibration_id]" << std::endl;
+    std::cout << "  or JSON: {\"corners\": [[x1,y1],...,[x4,y4]], \"calibration\": \"id\"}"
+              << std::endl;
+    std::cout << "  empty lines and lines starting with # are ignored" << std::endl;
+    std::cout << "  results are written as JSON lines, in input order" << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --jobs <n>              number of worker threads (defaults to one per core)"
+              << std::endl;
+    std::cout << "  --registry <file>       camera registry in which calibration ids are looked up"
+              << std::endl;
+    std::cout << "  --calibration-dir <dir> directory in which calibration ids are looked up as"
+              << std::endl;
+    std::cout << "                          <dir>/<id>/camera.json and <dir>/<id>/distortion.json"
+              << std::endl;
+    std::cout << "  --output <file>         output file (defaults to the standard output)"
+              << std::endl;
     std::exit(0);
 }
 
@@ -53,49 +141,735 @@ cv::Point2d parse_point2d(const std::string& arg)
     return p;
 }
 
-Params parse_cli(int argc, char* argv[])
+// Whether an argument has the form x:y
+bool is_point2d(const std::string& arg)
 {
-    if (argc > 8 || argc < 7)
+    size_t separator_index = arg.find(':');
+
+    auto is_integer = [](const std::string& str)
+    {
+        size_t first = !str.empty() && str[0] == '-' ? 1 : 0;
+        return str.size() > first
+               && std::all_of(str.begin() + first,
+                              str.end(),
+                              [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+    };
+
+    return separator_index != std::string::npos && is_integer(arg.substr(0, separator_index))
+           && is_integer(arg.substr(separator_index + 1));
+}
+
+// Inserts _<index> before the extension of a path
+std::string indexed_path(const std::string& path, size_t index)
+{
+    size_t dot = path.find_last_of('.');
+    size_t separator = path.find_last_of("/\\");
+
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+    {
+        dot = path.size();
+    }
+
+    return path.substr(0, dot) + "_" + std::to_string(index) + path.substr(dot);
+}
+
+// Reads <camera.json> <distortion.json> at argv[n], unless a camera id was given
+int parse_calibration_files(char* argv[],
+                            int n,
+                            const std::string& camera_id,
+                            std::string& camera_json_path,
+                            std::string& distortion_json_path)
+{
+    if (!camera_id.empty())
+    {
+        return n;
+    }
+
+    camera_json_path = argv[n];
+    distortion_json_path = argv[n + 1];
+    return n + 2;
+}
+
+Params parse_detect_cli(int argc, char* argv[], Params params)
+{
+    const int nb_positional = params.camera_id.empty() ? 4 : 2;
+
+    if (argc > nb_positional + 2 || argc < nb_positional + 1)
     {
         std::cerr << "Incorrect number of arguments" << std::endl;
         std::exit(1);
     }
 
+    params.detect_image_path = argv[2];
+    int n = parse_calibration_files(
+      argv, 3, params.camera_id, params.camera_json_path, params.distortion_json_path);
+
+    if (argc == n + 1)
+    {
+        params.result_json_path = argv[n];
+    }
+
+    return params;
+}
+
+Params parse_cli(int argc, char* argv[])
+{
     Params params;
-    params.corner_coordinates.bottom_left = parse_point2d(argv[1]);
-    params.corner_coordinates.bottom_right = parse_point2d(argv[2]);
-    params.corner_coordinates.top_right = parse_point2d(argv[3]);
-    params.corner_coordinates.top_left = parse_point2d(argv[4]);
-    params.camera_json_path = argv[5];
-    params.distortion_json_path = argv[6];
+    ocvp::cli::take_camera_id_options(argc, argv, params.registry_path, params.camera_id);
+    params.target = ocvp::cli::take_option(argc, argv, "--target");
 
-    if (argc == 8)
+    if (argc > 1 && std::string(argv[1]) == "--detect")
     {
-        params.result_json_path = argv[7];
+        return parse_detect_cli(argc, argv, params);
+    }
+
+    int nb_points = 0;
+
+    while (nb_points + 1 < argc && is_point2d(argv[nb_points + 1]))
+    {
+        ++nb_points;
+    }
+
+    if (nb_points == 0 || nb_points % 4 != 0)
+    {
+        std::cerr << "Expected 4 points per sheet, got " << nb_points << " point(s)" << std::endl;
+        std::exit(1);
+    }
+
+    const int nb_positional = nb_points + (params.camera_id.empty() ? 2 : 0);
+
+    if (argc > nb_positional + 2 || argc < nb_positional + 1)
+    {
+        std::cerr << "Incorrect number of arguments" << std::endl;
+        std::exit(1);
+    }
+
+    for (int i(1); i <= nb_points; i += 4)
+    {
+        ocvp::TargetCorners sheet;
+        sheet.bottom_left = parse_point2d(argv[i]);
+        sheet.bottom_right = parse_point2d(argv[i + 1]);
+        sheet.top_right = parse_point2d(argv[i + 2]);
+        sheet.top_left = parse_point2d(argv[i + 3]);
+        params.sheets.push_back(sheet);
+    }
+
+    int n = parse_calibration_files(argv,
+                                    nb_points + 1,
+                                    params.camera_id,
+                                    params.camera_json_path,
+                                    params.distortion_json_path);
+
+    if (argc == n + 1)
+    {
+        params.result_json_path = argv[n];
+    }
+
+    return params;
+}
+
+BatchParams parse_batch_cli(int argc, char* argv[])
+{
+    BatchParams params;
+    ocvp::cli::take_camera_id_options(argc, argv, params.registry_path, params.camera_id);
+    params.target = ocvp::cli::take_option(argc, argv, "--target");
+
+    if (argc < 3)
+    {
+        std::cerr << "Incorrect number of arguments" << std::endl;
+        std::exit(1);
+    }
+
+    params.manifest_path = argv[2];
+
+    // <camera.json> <distortion.json> may be omitted when every line of the
+    // manifest names its calibration.
+    const bool has_calibration_files =
+      params.camera_id.empty() && argc > 3 && std::string(argv[3]).compare(0, 2, "--") != 0;
+    int n = 3;
+
+    if (has_calibration_files)
+    {
+        if (argc < 5)
+        {
+            std::cerr << "Incorrect number of arguments" << std::endl;
+            std::exit(1);
+        }
+
+        n = parse_calibration_files(
+          argv, 3, params.camera_id, params.camera_json_path, params.distortion_json_path);
+    }
+
+    for (int i(n); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            std::exit(1);
+        }
+
+        if (arg == "--jobs")
+        {
+            params.nb_jobs = ocvp::cli::parse_count(arg, argv[++i]);
+        }
+        else if (arg == "--calibration-dir")
+        {
+            params.calibration_dir = argv[++i];
+        }
+        else if (arg == "--output")
+        {
+            params.output_path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+
+    if (params.camera_id.empty() && params.camera_json_path.empty() &&
+        params.registry_path.empty() && params.calibration_dir.empty())
+    {
+        std::cerr << "Missing <camera.json> <distortion.json>" << std::endl;
+        std::exit(1);
     }
 
     return params;
 }
 
+// Parses a whole CSV field as a number, surrounding whitespace aside
+double parse_csv_number(const std::string& field)
+{
+    size_t end = 0;
+    double value = 0;
+
+    try
+    {
+        value = std::stod(field, &end);
+    }
+    catch (const std::exception&)
+    {
+        end = 0;
+    }
+
+    if (end == 0 || field.find_first_not_of(" \t\r", end) != std::string::npos)
+    {
+        throw std::runtime_error("invalid number '" + field + "'");
+    }
+
+    return value;
+}
+
+std::vector<double> parse_csv_numbers(const std::string& line, std::string& trailing_field)
+{
+    std::vector<double> numbers;
+    std::istringstream stream{ line };
+    std::string field;
+
+    while (std::getline(stream, field, ','))
+    {
+        if (numbers.size() == 8)
+        {
+            trailing_field = field;
+            break;
+        }
+
+        numbers.push_back(parse_csv_number(field));
+    }
+
+    return numbers;
+}
+
+std::vector<double> parse_json_corners(const std::string& line, std::string& calibration_id)
+{
+    size_t pos = line.find("\"corners\"");
+
+    if (pos == std::string::npos)
+    {
+        throw std::runtime_error("missing \"corners\"");
+    }
+
+    pos = line.find('[', pos);
+
+    if (pos == std::string::npos)
+    {
+        throw std::runtime_error("malformed \"corners\"");
+    }
+
+    std::vector<double> numbers;
+    const char* it = line.c_str() + pos;
+
+    while (numbers.size() < 8 && *it != '\0')
+    {
+        if (*it == '[' || *it == ']' || *it == ',' || std::isspace(static_cast<unsigned char>(*it)))
+        {
+            ++it;
+            continue;
+        }
+
+        char* end = nullptr;
+        double value = std::strtod(it, &end);
+
+        if (end == it)
+        {
+            break;
+        }
+
+        numbers.push_back(value);
+        it = end;
+    }
+
+    pos = line.find("\"calibration\"");
+
+    if (pos != std::string::npos)
+    {
+        size_t begin = line.find('"', line.find(':', pos));
+        size_t end = line.find('"', begin + 1);
+
+        if (begin == std::string::npos || end == std::string::npos)
+        {
+            throw std::runtime_error("malformed \"calibration\"");
+        }
+
+        calibration_id = line.substr(begin + 1, end - begin - 1);
+    }
+
+    return numbers;
+}
+
+/**
+ * @brief parses a line of a batch manifest
+ * @param line     the line
+ * @param problem  receives the problem described by the line
+ * @return false if the line is empty or is a comment
+ * @throw std::exception if the line is malformed
+ */
+bool parse_manifest_line(const std::string& line, BatchProblem& problem)
+{
+    size_t first = line.find_first_not_of(" \t\r");
+
+    if (first == std::string::npos || line[first] == '#')
+    {
+        return false;
+    }
+
+    std::string calibration_id;
+    std::vector<double> numbers = line[first] == '{'
+                                    ? parse_json_corners(line, calibration_id)
+                                    : parse_csv_numbers(line, calibration_id);
+
+    if (numbers.size() != 8)
+    {
+        throw std::runtime_error("expected 4 corners");
+    }
+
+    auto point = [&numbers](size_t i)
+    { return cv::Point(cvRound(numbers[2 * i]), cvRound(numbers[2 * i + 1])); };
+
+    problem.corner_coordinates.bottom_left = point(0);
+    problem.corner_coordinates.bottom_right = point(1);
+    problem.corner_coordinates.top_right = point(2);
+    problem.corner_coordinates.top_left = point(3);
+
+    size_t id_begin = calibration_id.find_first_not_of(" \t\r");
+    size_t id_end = calibration_id.find_last_not_of(" \t\r");
+    problem.calibration_id = id_begin == std::string::npos
+                               ? std::string()
+                               : calibration_id.substr(id_begin, id_end - id_begin + 1);
+
+    return true;
+}
+
+void write_batch_result(std::ostream& out, const BatchResult& r)
+{
+    out << "{\"line\": " << r.line_number;
+
+    if (!r.error.empty())
+    {
+        out << ", \"error\": \"";
+
+        for (char c : r.error)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\';
+
+            out << (c == '\n' ? ' ' : c);
+        }
+
+        out << "\"}\n";
+        return;
+    }
+
+    auto write_vec = [&out](const char* name, const cv::Mat& vec)
+    {
+        out << ", \"" << name << "\": [" << vec.at<double>(0) << ", " << vec.at<double>(1) << ", "
+            << vec.at<double>(2) << "]";
+    };
+
+    write_vec("rvec", r.result.rvec);
+    write_vec("tvec", r.result.tvec);
+    out << "}\n";
+}
+
+/**
+ * @brief solves every problem of a manifest on a pool of worker threads
+ *
+ * Calibration ids are looked up in the registry (if any), which is loaded
+ * once; otherwise calibration files are loaded once, when first referenced.
+ * The number of problems in flight is bounded so that arbitrarily large
+ * manifests can be streamed; results are written in input order.
+ */
+int run_batch(const BatchParams& params)
+{
+    std::ifstream manifest_file;
+    std::istream* manifest = &std::cin;
+
+    if (params.manifest_path != "-")
+    {
+        manifest_file.open(params.manifest_path);
+
+        if (!manifest_file.is_open())
+        {
+            std::cerr << "Could not open " << params.manifest_path << std::endl;
+            return 1;
+        }
+
+        manifest = &manifest_file;
+    }
+
+    std::ofstream output_file;
+    std::ostream* output = &std::cout;
+
+    if (!params.output_path.empty())
+    {
+        output_file.open(params.output_path);
+
+        if (!output_file.is_open())
+        {
+            std::cerr << "Could not open " << params.output_path << std::endl;
+            return 1;
+        }
+
+        output = &output_file;
+    }
+
+    output->precision(std::numeric_limits<double>::max_digits10);
+
+    // std::map never invalidates pointers to its elements, so workers can
+    // use a calibration while the main thread inserts new ones.
+    std::map<std::string, ocvp::CameraCalibration> calibrations;
+    ocvp::CameraRegistry registry;
+    ocvp::CalibrationCache& cache = ocvp::CalibrationCache::global();
+    ocvp::PlanarTarget target = ocvp::A4Target();
+
+    try
+    {
+        if (!params.target.empty())
+        {
+            target = ocvp::cli::load_target(params.target);
+        }
+
+        if (!params.registry_path.empty())
+        {
+            registry = ocvp::load_camera_registry(params.registry_path);
+        }
+
+        if (!params.camera_id.empty())
+        {
+            calibrations[std::string()] = registry.at(params.camera_id);
+        }
+        else if (!params.camera_json_path.empty())
+        {
+            ocvp::CameraCalibration& c = calibrations[std::string()];
+            c.intrinsics = cache.camera_intrinsics(params.camera_json_path);
+            c.distortion = cache.distortion_coeffs(params.distortion_json_path);
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    // Calibration ids that could not be loaded, and why; so that each id is
+    // loaded at most once.
+    std::map<std::string, std::string> calibration_errors;
+
+    auto get_calibration = [&](const std::string& id) -> const ocvp::CameraCalibration&
+    {
+        if (!id.empty())
+        {
+            if (const ocvp::CameraCalibration* c = registry.find(id))
+            {
+                return *c;
+            }
+        }
+
+        auto it = calibrations.find(id);
+
+        if (it != calibrations.end())
+        {
+            return it->second;
+        }
+
+        if (id.empty())
+        {
+            throw std::runtime_error("no calibration id and no default calibration");
+        }
+
+        if (params.calibration_dir.empty())
+        {
+            throw std::runtime_error("unknown calibration id '" + id + "'");
+        }
+
+        auto error = calibration_errors.find(id);
+
+        if (error != calibration_errors.end())
+        {
+            throw std::runtime_error(error->second);
+        }
+
+        std::string dir = params.calibration_dir + "/" + id;
+        ocvp::CameraCalibration c;
+
+        try
+        {
+            c.intrinsics = cache.camera_intrinsics(dir + "/camera.json");
+            c.distortion = cache.distortion_coeffs(dir + "/distortion.json");
+        }
+        catch (const std::exception& ex)
+        {
+            calibration_errors[id] = ex.what();
+            throw;
+        }
+
+        return calibrations[id] = c;
+    };
+
+    ocvp::WorkerPool pool{ params.nb_jobs };
+    const size_t max_in_flight = 64 * pool.size();
+    std::deque<std::future<BatchResult>> in_flight;
+
+    size_t nb_problems = 0;
+    size_t nb_failures = 0;
+
+    auto write_front = [&]()
+    {
+        BatchResult r = in_flight.front().get();
+        in_flight.pop_front();
+        nb_failures += r.error.empty() ? 0 : 1;
+        write_batch_result(*output, r);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(*manifest, line))
+    {
+        ++line_number;
+
+        BatchProblem problem;
+        const ocvp::CameraCalibration* calibration = nullptr;
+        std::string error;
+
+        try
+        {
+            if (!parse_manifest_line(line, problem))
+            {
+                continue;
+            }
+
+            calibration = &get_calibration(problem.calibration_id);
+        }
+        catch (const std::exception& ex)
+        {
+            error = ex.what();
+        }
+
+        ++nb_problems;
+
+        in_flight.push_back(pool.submit(
+          [line_number, problem, calibration, target, error]()
+          {
+              BatchResult r;
+              r.line_number = line_number;
+              r.error = error;
+
+              if (!calibration)
+              {
+                  return r;
+              }
+
+              try
+              {
+                  r.result = ocvp::solve_pnp(problem.corner_coordinates,
+                                             target,
+                                             calibration->intrinsics,
+                                             calibration->distortion);
+              }
+              catch (const std::exception& ex)
+              {
+                  r.error = ex.what();
+              }
+
+              return r;
+          }));
+
+        if (in_flight.size() >= max_in_flight)
+        {
+            write_front();
+        }
+    }
+
+    while (!in_flight.empty())
+    {
+        write_front();
+    }
+
+    output->flush();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double rate = elapsed.count() > 0 ? nb_problems / elapsed.count() : 0;
+
+    std::cerr << nb_problems << " problems (" << nb_failures << " failed) in "
+              << elapsed.count() << "s using " << pool.size() << " threads: " << rate
+              << " problems/s" << std::endl;
+
+    return nb_failures == 0 ? 0 : 1;
+}
+
+/**
+ * @brief solves the problems of several sheets of the same picture
+ *
+ * Results are printed in order; a sheet that cannot be solved does not
+ * prevent the others from being solved, but makes the program fail.
+ */
+int solve_many(const Params& params,
+               const ocvp::PlanarTarget& target,
+               const ocvp::CameraCalibration& calibration)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(calibration.intrinsics, calibration.distortion);
+    std::vector<ocvp::PnPTargetResult> results =
+      ocvp::solve_pnp_many(params.sheets, target, camera);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    size_t nb_failures = 0;
+
+    for (size_t i(0); i < results.size(); ++i)
+    {
+        const ocvp::PnPTargetResult& r = results[i];
+        std::cout << "sheet " << i << ": " << ocvp::to_string(r.status) << std::endl;
+
+        if (r.status != ocvp::PnPStatus::Solved)
+        {
+            ++nb_failures;
+            continue;
+        }
+
+        std::cout << "  rvec = " << r.pose.rvec << std::endl;
+        std::cout << "  tvec = " << r.pose.tvec << std::endl;
+        std::cout << "  camera_position = " << ocvp::compute_camera_position(r.pose) << std::endl;
+        std::cout << "  reprojection_error = " << r.reprojection_error << std::endl;
+
+        if (!params.result_json_path.empty())
+        {
+            std::string path = indexed_path(params.result_json_path, i);
+            ocvp::save_pnp_result(path, ocvp::to_pnp_result(r.pose));
+            std::cout << "  saved into " << path << std::endl;
+        }
+    }
+
+    std::cerr << results.size() << " sheets (" << nb_failures << " failed) in "
+              << elapsed.count() * 1000 << "ms" << std::endl;
+
+    return nb_failures == 0 ? 0 : 1;
+}
+
 int main(int argc, char* argv[])
 {
     if (argc <= 1 || ocvp::cli::is_help(argv[1]))
         print_help();
 
+    if (std::string(argv[1]) == "--batch")
+    {
+        return run_batch(parse_batch_cli(argc, argv));
+    }
+
     Params params = parse_cli(argc, argv);
 
-    ocvp::A4SheetOfPaper a4sheet = params.corner_coordinates;
+    if (!params.detect_image_path.empty())
+    {
+        try
+        {
+            // the detection only uses the intensity
+            ocvp::LoadOptions options;
+            options.grayscale = true;
+            cv::Mat image = ocvp::load_image(params.detect_image_path, options);
+            params.sheets.push_back(ocvp::detect_a4_sheet(image));
+        }
+        catch (const std::exception& ex)
+        {
+            std::cerr << "Error: " << ex.what() << std::endl;
+            return 1;
+        }
+
+        std::cout << "corners =";
+
+        const ocvp::TargetCorners& sheet = params.sheets.front();
+
+        for (const cv::Point& p : { sheet.bottom_left,
+                                    sheet.bottom_right,
+                                    sheet.top_right,
+                                    sheet.top_left })
+        {
+            std::cout << " " << p.x << ":" << p.y;
+        }
+
+        std::cout << std::endl;
+    }
+
+    ocvp::CameraCalibration calibration;
+    ocvp::PlanarTarget target = ocvp::A4Target();
+
+    try
+    {
+        calibration = ocvp::cli::load_calibration(params.registry_path,
+                                                  params.camera_id,
+                                                  params.camera_json_path,
+                                                  params.distortion_json_path);
 
-    ocvp::CameraIntrinsics intrinsics = ocvp::load_camera_intrinsics(params.camera_json_path);
+        if (!params.target.empty())
+        {
+            target = ocvp::cli::load_target(params.target);
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    if (params.sheets.size() > 1)
+    {
+        return solve_many(params, target, calibration);
+    }
 
-    ocvp::DistortionCoefficients distortion
-      = ocvp::load_distortion_coeffs(params.distortion_json_path);
+    ocvp::TargetCorners corners = params.sheets.front();
+    ocvp::CameraIntrinsics intrinsics = calibration.intrinsics;
+    ocvp::DistortionCoefficients distortion = calibration.distortion;
 
     ocvp::PnPResult result;
 
     try
     {
-        result = ocvp::solve_pnp(a4sheet, intrinsics, distortion);
+        result = ocvp::solve_pnp(corners, target, intrinsics, distortion);
     }
     catch (const std::exception& ex)
     {
@@ -0,0 +1,520 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "clihelpers.h"
+
+#include "ocvp/calibration.h"
+#include "ocvp/drawframe.h"
+#include "ocvp/posetracker.h"
+#include "ocvp/spscqueue.h"
+
+#include <opencv2/videoio.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+struct Params
+{
+    std::string input_video_path;
+    std::string camera_json_path;
+    std::string distortion_json_path;
+    std::string registry_path;
+    std::string camera_id;
+    std::string corners_path;
+    std::string output_video_path;
+    std::string log_path;
+    std::string fourcc;
+    size_t nb_draw_threads = 0;
+    size_t queue_size = 4;
+    std::string frame_pool = "on";
+};
+
+/**
+ * @brief a frame flowing through the pipeline
+ *
+ * A frame with a negative index marks the end of the video.
+ */
+struct Frame
+{
+    int index = -1;
+    double timestamp_ms = 0;
+    cv::Mat image;
+    bool has_corners = false;
+    ocvp::A4SheetOfPaper corners;
+    bool has_pose = false;
+    ocvp::PnPResult pose;
+    double reprojection_error = 0;
+    bool warm_start = false;
+    std::string error;
+};
+
+using FrameQueue = ocvp::SpscQueue<Frame>;
+
+void print_help()
+{
+    std::cout << "trackvideo: estimates the pose of a A4 sheet of paper in every frame of a video"
+              << std::endl;
+    std::cout << "usage: trackvideo <input_video> <camera.json> <distortion.json> <corners.csv> "
+                 "<output_video> [options]"
+              << std::endl;
+    std::cout << "   or: trackvideo <input_video> <corners.csv> <output_video> --registry <file> "
+                 "--camera-id <id> [options]"
+              << std::endl;
+    std::cout << "description: " << std::endl;
+    std::cout << "  each line of <corners.csv> is: frame,x1,y1,x2,y2,x3,y3,x4,y4" << std::endl;
+    std::cout << "  (frame numbers start at 0, corners in the order expected by solvepnp);"
+              << std::endl;
+    std::cout << "  empty lines and lines starting with # are ignored" << std::endl;
+    std::cout << "  frames without corners are copied unchanged to <output_video>" << std::endl;
+    std::cout << "options: " << std::endl;
+    std::cout << "  --registry <file>     camera registry in which --camera-id is looked up"
+              << std::endl;
+    std::cout << "  --camera-id <id>      uses the calibration of a camera of the registry"
+              << std::endl;
+    std::cout << "  --log <file>          writes the pose of every frame as CSV" << std::endl;
+    std::cout << "  --fourcc <code>       codec of the output video (defaults to the input codec)"
+              << std::endl;
+    std::cout << "  --draw-threads <n>    number of drawing threads (defaults to the number of"
+              << std::endl;
+    std::cout << "                        cores minus the decoding, solving and encoding threads)"
+              << std::endl;
+    std::cout << "  --queue-size <n>      capacity (in frames) of the queues between stages"
+              << std::endl;
+    std::cout << "  --frame-pool <mode>   recycling of the frame buffers: on (default), huge (on,"
+              << std::endl;
+    std::cout << "                        with huge pages) or off" << std::endl;
+    std::exit(0);
+}
+
+Params parse_cli(int argc, char* argv[])
+{
+    Params params;
+    ocvp::cli::take_camera_id_options(argc, argv, params.registry_path, params.camera_id);
+
+    const int nb_positional = params.camera_id.empty() ? 5 : 3;
+
+    if (argc < nb_positional + 1)
+    {
+        std::cerr << "Incorrect number of arguments" << std::endl;
+        std::exit(1);
+    }
+
+    int n = 1;
+    params.input_video_path = argv[n++];
+
+    if (params.camera_id.empty())
+    {
+        params.camera_json_path = argv[n++];
+        params.distortion_json_path = argv[n++];
+    }
+
+    params.corners_path = argv[n++];
+    params.output_video_path = argv[n++];
+
+    for (int i(n); i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for option " << arg << std::endl;
+            std::exit(1);
+        }
+
+        if (arg == "--log")
+        {
+            params.log_path = argv[++i];
+        }
+        else if (arg == "--fourcc")
+        {
+            params.fourcc = argv[++i];
+
+            if (params.fourcc.size() != 4)
+            {
+                std::cerr << "Invalid fourcc: " << params.fourcc << std::endl;
+                std::exit(1);
+            }
+        }
+        else if (arg == "--draw-threads")
+        {
+            params.nb_draw_threads = ocvp::cli::parse_count(arg, argv[++i]);
+        }
+        else if (arg == "--queue-size")
+        {
+            params.queue_size = std::max<size_t>(1, ocvp::cli::parse_count(arg, argv[++i]));
+        }
+        else if (arg == "--frame-pool")
+        {
+            params.frame_pool = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+
+    if (params.nb_draw_threads == 0)
+    {
+        unsigned int nb_cores = std::thread::hardware_concurrency();
+        params.nb_draw_threads = nb_cores > 4 ? nb_cores - 3 : 1;
+    }
+
+    return params;
+}
+
+/**
+ * @brief reads the sidecar file giving the corners of the sheet in each frame
+ */
+std::map<int, ocvp::A4SheetOfPaper> load_corners(const std::string& path)
+{
+    std::ifstream file{ path };
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    std::map<int, ocvp::A4SheetOfPaper> result;
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(file, line))
+    {
+        ++line_number;
+
+        size_t first = line.find_first_not_of(" \t\r");
+
+        if (first == std::string::npos || line[first] == '#')
+        {
+            continue;
+        }
+
+        std::istringstream stream{ line };
+        std::string field;
+        std::vector<double> numbers;
+
+        try
+        {
+            while (std::getline(stream, field, ','))
+            {
+                numbers.push_back(std::stod(field));
+            }
+        }
+        catch (const std::exception&)
+        {
+            numbers.clear();
+        }
+
+        if (numbers.size() != 9)
+        {
+            throw std::runtime_error(path + ":" + std::to_string(line_number)
+                                     + ": expected frame,x1,y1,x2,y2,x3,y3,x4,y4");
+        }
+
+        auto point = [&numbers](size_t i)
+        { return cv::Point(cvRound(numbers[2 * i + 1]), cvRound(numbers[2 * i + 2])); };
+
+        ocvp::A4SheetOfPaper& sheet = result[static_cast<int>(numbers[0])];
+        sheet.bottom_left = point(0);
+        sheet.bottom_right = point(1);
+        sheet.top_right = point(2);
+        sheet.top_left = point(3);
+    }
+
+    return result;
+}
+
+void write_log_header(std::ostream& out)
+{
+    out << "frame,timestamp_ms,status,rvec_x,rvec_y,rvec_z,tvec_x,tvec_y,tvec_z,"
+           "reprojection_error,warm_start\n";
+}
+
+void write_log_line(std::ostream& out, const Frame& frame)
+{
+    out << frame.index << "," << frame.timestamp_ms << ",";
+
+    if (!frame.has_pose)
+    {
+        out << (frame.has_corners ? "failed" : "no_corners") << ",,,,,,,,\n";
+        return;
+    }
+
+    const cv::Mat& rvec = frame.pose.rvec;
+    const cv::Mat& tvec = frame.pose.tvec;
+
+    out << "ok," << rvec.at<double>(0) << "," << rvec.at<double>(1) << "," << rvec.at<double>(2)
+        << "," << tvec.at<double>(0) << "," << tvec.at<double>(1) << "," << tvec.at<double>(2)
+        << "," << frame.reprojection_error << "," << (frame.warm_start ? 1 : 0) << "\n";
+}
+
+/**
+ * @brief decoding stage: reads the frames of the video and attaches their corners
+ */
+void decode_frames(cv::VideoCapture& capture,
+                   const std::map<int, ocvp::A4SheetOfPaper>& corners,
+                   FrameQueue& output)
+{
+    for (int index(0);; ++index)
+    {
+        Frame frame;
+
+        if (!capture.read(frame.image) || frame.image.empty())
+        {
+            break;
+        }
+
+        // after a read, the position is that of the frame just decoded
+        frame.timestamp_ms = capture.get(cv::CAP_PROP_POS_MSEC);
+        frame.index = index;
+
+        auto it = corners.find(index);
+
+        if (it != corners.end())
+        {
+            frame.has_corners = true;
+            frame.corners = it->second;
+        }
+
+        output.push(std::move(frame));
+    }
+
+    output.push(Frame());
+}
+
+/**
+ * @brief solving stage: estimates the pose in each frame
+ *
+ * Frames are solved in order, each one starting from the pose of the
+ * previous one (see ocvp::PoseTracker), then dealt to the drawing threads
+ * in a round-robin fashion.
+ */
+void solve_frames(ocvp::PoseTracker& tracker,
+                  FrameQueue& input,
+                  std::vector<std::unique_ptr<FrameQueue>>& outputs)
+{
+    for (size_t n(0);; ++n)
+    {
+        Frame frame = input.pop();
+
+        if (frame.index < 0)
+        {
+            break;
+        }
+
+        if (frame.has_corners)
+        {
+            try
+            {
+                frame.pose = tracker.track(frame.corners);
+                frame.has_pose = true;
+                frame.reprojection_error = tracker.reprojection_error();
+                frame.warm_start = tracker.last_solve_was_warm();
+            }
+            catch (const std::exception& ex)
+            {
+                frame.error = ex.what();
+            }
+        }
+        else
+        {
+            tracker.reset();
+        }
+
+        outputs[n % outputs.size()]->push(std::move(frame));
+    }
+
+    for (std::unique_ptr<FrameQueue>& output : outputs)
+    {
+        output->push(Frame());
+    }
+}
+
+/**
+ * @brief drawing stage: draws the frame axes on the frames that have a pose
+ */
+void draw_frames(const ocvp::CameraIntrinsics& intrinsics,
+                 const ocvp::DistortionCoefficients& distortion,
+                 FrameQueue& input,
+                 FrameQueue& output)
+{
+    constexpr float length = 0.1;
+    constexpr int thickness = 6;
+
+    for (;;)
+    {
+        Frame frame = input.pop();
+
+        if (frame.index < 0)
+        {
+            output.push(std::move(frame));
+            break;
+        }
+
+        if (frame.has_pose)
+        {
+            ocvp::draw_frame_axes(frame.image,
+                                  intrinsics,
+                                  distortion,
+                                  frame.pose.rvec,
+                                  frame.pose.tvec,
+                                  length,
+                                  thickness);
+        }
+
+        output.push(std::move(frame));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1 || ocvp::cli::is_help(argv[1]))
+        print_help();
+
+    Params params = parse_cli(argc, argv);
+    const ocvp::FramePool* frame_pool = ocvp::cli::install_frame_pool(params.frame_pool);
+
+    ocvp::CameraIntrinsics intrinsics;
+    ocvp::DistortionCoefficients distortion;
+    std::map<int, ocvp::A4SheetOfPaper> corners;
+
+    try
+    {
+        ocvp::CameraCalibration calibration
+          = ocvp::cli::load_calibration(params.registry_path,
+                                        params.camera_id,
+                                        params.camera_json_path,
+                                        params.distortion_json_path);
+        intrinsics = calibration.intrinsics;
+        distortion = calibration.distortion;
+        corners = load_corners(params.corners_path);
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    cv::VideoCapture capture{ params.input_video_path };
+
+    if (!capture.isOpened())
+    {
+        std::cerr << "Could not open " << params.input_video_path << std::endl;
+        return 1;
+    }
+
+    double fps = capture.get(cv::CAP_PROP_FPS);
+    cv::Size frame_size{ static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH)),
+                         static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT)) };
+    int fourcc = params.fourcc.empty() ? static_cast<int>(capture.get(cv::CAP_PROP_FOURCC))
+                                       : cv::VideoWriter::fourcc(params.fourcc[0],
+                                                                 params.fourcc[1],
+                                                                 params.fourcc[2],
+                                                                 params.fourcc[3]);
+
+    cv::VideoWriter writer{ params.output_video_path, fourcc, fps > 0 ? fps : 30, frame_size };
+
+    if (!writer.isOpened())
+    {
+        std::cerr << "Could not open " << params.output_video_path << " for writing" << std::endl;
+        return 1;
+    }
+
+    std::ofstream log;
+
+    if (!params.log_path.empty())
+    {
+        log.open(params.log_path);
+
+        if (!log.is_open())
+        {
+            std::cerr << "Could not open " << params.log_path << std::endl;
+            return 1;
+        }
+
+        log.precision(std::numeric_limits<double>::max_digits10);
+        write_log_header(log);
+    }
+
+    ocvp::PoseTracker tracker{ intrinsics, distortion };
+
+    FrameQueue decoded{ params.queue_size };
+    std::vector<std::unique_ptr<FrameQueue>> solved;
+    std::vector<std::unique_ptr<FrameQueue>> drawn;
+
+    for (size_t i(0); i < params.nb_draw_threads; ++i)
+    {
+        solved.push_back(std::make_unique<FrameQueue>(params.queue_size));
+        drawn.push_back(std::make_unique<FrameQueue>(params.queue_size));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([&]() { decode_frames(capture, corners, decoded); });
+    threads.emplace_back([&]() { solve_frames(tracker, decoded, solved); });
+
+    for (size_t i(0); i < params.nb_draw_threads; ++i)
+    {
+        threads.emplace_back(
+          [&, i]() { draw_frames(intrinsics, distortion, *solved[i], *drawn[i]); });
+    }
+
+    // encoding stage: frames are collected from the drawing threads in the
+    // order in which they were dealt, i.e. in the order of the video
+    size_t nb_frames = 0;
+    size_t nb_poses = 0;
+    size_t nb_failures = 0;
+
+    for (;; ++nb_frames)
+    {
+        Frame frame = drawn[nb_frames % drawn.size()]->pop();
+
+        if (frame.index < 0)
+        {
+            break;
+        }
+
+        writer.write(frame.image);
+
+        nb_poses += frame.has_pose ? 1 : 0;
+        nb_failures += frame.has_corners && !frame.has_pose ? 1 : 0;
+
+        if (!frame.error.empty())
+        {
+            std::cerr << "frame " << frame.index << ": " << frame.error << std::endl;
+        }
+
+        if (log.is_open())
+        {
+            write_log_line(log, frame);
+        }
+    }
+
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+
+    writer.release();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double rate = elapsed.count() > 0 ? nb_frames / elapsed.count() : 0;
+
+    std::cerr << nb_frames << " frames (" << nb_poses << " poses, " << nb_failures
+              << " failed) in " << elapsed.count() << "s: " << rate << " frames/s, "
+              << tracker.warm_start_ratio() * 100 << "% warm starts" << std::endl;
+    ocvp::cli::print_frame_pool_statistics(frame_pool);
+
+    return nb_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/calibration.h"
+#include "ocvp/camera.h"
+#include "ocvp/pnp.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+
+static void BM_make_camera_matrix(benchmark::State& state)
+{
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+
+    for (auto _ : state)
+    {
+        cv::Mat m = ocvp::make_camera_matrix(intrinsics);
+        benchmark::DoNotOptimize(m.data);
+    }
+}
+BENCHMARK(BM_make_camera_matrix);
+
+static void BM_make_distcoeffs_vector(benchmark::State& state)
+{
+    ocvp::DistortionCoefficients coeffs = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        std::vector<double> v = ocvp::make_distcoeffs_vector(coeffs);
+        benchmark::DoNotOptimize(v.data());
+    }
+}
+BENCHMARK(BM_make_distcoeffs_vector);
+
+static void BM_make_camera_model(benchmark::State& state)
+{
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients coeffs = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        ocvp::CameraModel camera = ocvp::make_camera_model(intrinsics, coeffs);
+        benchmark::DoNotOptimize(camera);
+    }
+}
+BENCHMARK(BM_make_camera_model);
+
+static void BM_save_camera_intrinsics(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file("camera.json");
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+
+    for (auto _ : state)
+    {
+        ocvp::save_camera_intrinsics(path, intrinsics);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_save_camera_intrinsics);
+
+static void BM_load_camera_intrinsics(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file("camera.json");
+    ocvp::save_camera_intrinsics(path, benchdata::camera_intrinsics());
+
+    for (auto _ : state)
+    {
+        ocvp::CameraIntrinsics intrinsics = ocvp::load_camera_intrinsics(path);
+        benchmark::DoNotOptimize(intrinsics);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_load_camera_intrinsics);
+
+static void BM_save_distortion_coeffs(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file("distortion.json");
+    ocvp::DistortionCoefficients coeffs = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        ocvp::save_distortion_coeffs(path, coeffs);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_save_distortion_coeffs);
+
+static void BM_load_distortion_coeffs(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file("distortion.json");
+    ocvp::save_distortion_coeffs(path, benchdata::distortion_coeffs());
+
+    for (auto _ : state)
+    {
+        ocvp::DistortionCoefficients coeffs = ocvp::load_distortion_coeffs(path);
+        benchmark::DoNotOptimize(coeffs);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_load_distortion_coeffs);
+
+static ocvp::CameraCalibration calibration()
+{
+    ocvp::CameraCalibration result;
+    result.intrinsics = benchdata::camera_intrinsics();
+    result.distortion = benchdata::distortion_coeffs();
+    result.image_size = cv::Size(4000, 3000);
+    return result;
+}
+
+// Both JSON files, as done by the apps before the binary format
+static void BM_import_calibration_json(benchmark::State& state)
+{
+    const std::string camera_path = benchdata::temp_file("camera.json");
+    const std::string distortion_path = benchdata::temp_file("distortion.json");
+    ocvp::export_calibration_json(calibration(), camera_path, distortion_path);
+
+    for (auto _ : state)
+    {
+        ocvp::CameraCalibration c = ocvp::import_calibration_json(camera_path, distortion_path);
+        benchmark::DoNotOptimize(c);
+    }
+
+    std::remove(camera_path.c_str());
+    std::remove(distortion_path.c_str());
+}
+BENCHMARK(BM_import_calibration_json);
+
+static void BM_load_calibration(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file(".ocvpcal");
+    ocvp::save_calibration(path, calibration());
+
+    for (auto _ : state)
+    {
+        ocvp::CameraCalibration c = ocvp::load_calibration(path);
+        benchmark::DoNotOptimize(c);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_load_calibration);
+
+// Cost of a hit, i.e. of the modification time check
+static void BM_calibration_cache_get(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file(".ocvpcal");
+    ocvp::save_calibration(path, calibration());
+    ocvp::CalibrationCache cache;
+
+    for (auto _ : state)
+    {
+        std::shared_ptr<const ocvp::CameraCalibration> c = cache.get(path);
+        benchmark::DoNotOptimize(c.get());
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_calibration_cache_get);
+
+// The argument is the number of cameras in the registry
+static void BM_camera_registry_find(benchmark::State& state)
+{
+    std::vector<std::pair<std::string, ocvp::CameraCalibration>> cameras;
+
+    for (int i(0); i < state.range(0); ++i)
+    {
+        cameras.emplace_back("camera-" + std::to_string(i), calibration());
+    }
+
+    const ocvp::CameraRegistry registry{ cameras };
+    const std::string id = cameras.back().first;
+
+    for (auto _ : state)
+    {
+        const ocvp::CameraCalibration* c = registry.find(id);
+        benchmark::DoNotOptimize(c);
+    }
+}
+BENCHMARK(BM_camera_registry_find)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BM_save_pnp_result(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file("pnpresult.json");
+    ocvp::PnPResult result = benchdata::sheet_pose();
+
+    for (auto _ : state)
+    {
+        ocvp::save_pnp_result(path, result);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_save_pnp_result);
+
+static void BM_load_pnp_result(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file("pnpresult.json");
+    ocvp::save_pnp_result(path, benchdata::sheet_pose());
+
+    for (auto _ : state)
+    {
+        ocvp::PnPResult result = ocvp::load_pnp_result(path);
+        benchmark::DoNotOptimize(result.rvec.data);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_load_pnp_result);
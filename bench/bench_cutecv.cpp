@@ -0,0 +1,88 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "utils/cutecv.h"
+
+#include <benchmark/benchmark.h>
+
+/*
+ * The arguments are the dimensions of the image: 1920x1080 and a
+ * 24 MP (6000x4000) photo.
+ */
+
+static void BM_to_opencv_rgb32(benchmark::State& state)
+{
+    QImage image{ int(state.range(0)), int(state.range(1)), QImage::Format_RGB32 };
+    image.fill(Qt::darkCyan);
+
+    for (auto _ : state)
+    {
+        cv::Mat mat = to_opencv(image);
+        benchmark::DoNotOptimize(mat.data);
+    }
+}
+BENCHMARK(BM_to_opencv_rgb32)->Args({ 1920, 1080 })->Args({ 6000, 4000 });
+
+static void BM_to_opencv_rgb888(benchmark::State& state)
+{
+    QImage image{ int(state.range(0)), int(state.range(1)), QImage::Format_RGB888 };
+    image.fill(Qt::darkCyan);
+
+    for (auto _ : state)
+    {
+        cv::Mat mat = to_opencv(image);
+        benchmark::DoNotOptimize(mat.data);
+    }
+}
+BENCHMARK(BM_to_opencv_rgb888)
+  ->Args({ 1920, 1080 })
+  ->Args({ 6000, 4000 })
+  ->Unit(benchmark::kMillisecond);
+
+static void BM_to_opencv_writable(benchmark::State& state)
+{
+    QImage image{ int(state.range(0)), int(state.range(1)), QImage::Format_RGB32 };
+    image.fill(Qt::darkCyan);
+
+    for (auto _ : state)
+    {
+        QImage copy = image; // shared, to_opencv_writable() has to detach it
+        cv::Mat mat = to_opencv_writable(copy);
+        benchmark::DoNotOptimize(mat.data);
+    }
+}
+BENCHMARK(BM_to_opencv_writable)
+  ->Args({ 1920, 1080 })
+  ->Args({ 6000, 4000 })
+  ->Unit(benchmark::kMillisecond);
+
+static void BM_to_qimage_bgr(benchmark::State& state)
+{
+    cv::Mat mat = benchdata::image(int(state.range(0)), int(state.range(1)));
+
+    for (auto _ : state)
+    {
+        QImage image = to_qimage(mat);
+        benchmark::DoNotOptimize(image.constBits());
+    }
+}
+BENCHMARK(BM_to_qimage_bgr)->Args({ 1920, 1080 })->Args({ 6000, 4000 });
+
+static void BM_to_qimage_float(benchmark::State& state)
+{
+    cv::Mat mat;
+    benchdata::image(int(state.range(0)), int(state.range(1))).convertTo(mat, CV_32F);
+
+    for (auto _ : state)
+    {
+        QImage image = to_qimage(mat);
+        benchmark::DoNotOptimize(image.constBits());
+    }
+}
+BENCHMARK(BM_to_qimage_float)
+  ->Args({ 1920, 1080 })
+  ->Args({ 6000, 4000 })
+  ->Unit(benchmark::kMillisecond);
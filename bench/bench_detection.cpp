@@ -0,0 +1,98 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/detection.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Reports the largest distance (in pixels) between a detected corner and
+// the corresponding corner of benchdata::a4sheet().
+static void set_accuracy_counter(benchmark::State& state, const ocvp::A4SheetOfPaper& sheet)
+{
+    ocvp::A4SheetOfPaper expected = benchdata::a4sheet();
+    double error = 0;
+
+    auto update = [&error](const cv::Point& a, const cv::Point& b)
+    {
+        cv::Point d = a - b;
+        error = std::max(error, std::sqrt(static_cast<double>(d.dot(d))));
+    };
+
+    update(sheet.bottom_left, expected.bottom_left);
+    update(sheet.bottom_right, expected.bottom_right);
+    update(sheet.top_right, expected.top_right);
+    update(sheet.top_left, expected.top_left);
+
+    state.counters["corner_error_px"] = error;
+}
+
+static void set_throughput_counters(benchmark::State& state, const cv::Mat& image)
+{
+    state.SetItemsProcessed(state.iterations());
+    state.counters["megapixels"] = benchmark::Counter(
+      state.iterations() * image.total() * 1e-6, benchmark::Counter::kIsRate);
+}
+
+static void BM_detect_a4_sheet(benchmark::State& state)
+{
+    cv::Mat image = benchdata::sheet_image();
+    ocvp::A4SheetOfPaper sheet;
+
+    for (auto _ : state)
+    {
+        sheet = ocvp::detect_a4_sheet(image);
+        benchmark::DoNotOptimize(sheet);
+    }
+
+    set_throughput_counters(state, image);
+    set_accuracy_counter(state, sheet);
+}
+BENCHMARK(BM_detect_a4_sheet)->Unit(benchmark::kMillisecond);
+
+static void BM_detect_a4_sheet_roi(benchmark::State& state)
+{
+    cv::Mat image = benchdata::sheet_image();
+
+    ocvp::A4SheetOfPaper expected = benchdata::a4sheet();
+    std::vector<cv::Point> corners{
+        expected.bottom_left, expected.bottom_right, expected.top_right, expected.top_left
+    };
+    cv::Rect roi = cv::boundingRect(corners);
+    roi -= cv::Point(roi.width / 10, roi.height / 10);
+    roi += cv::Size(roi.width / 5, roi.height / 5);
+
+    ocvp::A4SheetOfPaper sheet;
+
+    for (auto _ : state)
+    {
+        sheet = ocvp::detect_a4_sheet(image, roi);
+        benchmark::DoNotOptimize(sheet);
+    }
+
+    set_throughput_counters(state, image);
+    set_accuracy_counter(state, sheet);
+}
+BENCHMARK(BM_detect_a4_sheet_roi)->Unit(benchmark::kMillisecond);
+
+static void BM_detect_a4_sheet_gray(benchmark::State& state)
+{
+    cv::Mat image;
+    cv::cvtColor(benchdata::sheet_image(), image, cv::COLOR_BGR2GRAY);
+    ocvp::A4SheetOfPaper sheet;
+
+    for (auto _ : state)
+    {
+        sheet = ocvp::detect_a4_sheet(image);
+        benchmark::DoNotOptimize(sheet);
+    }
+
+    set_throughput_counters(state, image);
+    set_accuracy_counter(state, sheet);
+}
+BENCHMARK(BM_detect_a4_sheet_gray)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,212 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/contour.h"
+#include "ocvp/drawframe.h"
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/imgproc.hpp>
+
+namespace
+{
+
+/*
+ * Returns quadrilaterals spread over an image, like the sheets detected in
+ * a picture of a warehouse.
+ */
+std::vector<std::vector<cv::Point>> scattered_quads(int count, cv::Size image_size)
+{
+    cv::RNG rng{ 0x5EE7 };
+    std::vector<std::vector<cv::Point>> quads;
+
+    for (int i(0); i < count; ++i)
+    {
+        const cv::Point center(rng.uniform(0, image_size.width), rng.uniform(0, image_size.height));
+        const int w = rng.uniform(40, 200);
+        const int h = rng.uniform(40, 280);
+
+        quads.push_back({ center + cv::Point(-w / 2 + rng.uniform(-8, 8), h / 2),
+                          center + cv::Point(w / 2, h / 2 + rng.uniform(-8, 8)),
+                          center + cv::Point(w / 2 + rng.uniform(-8, 8), -h / 2),
+                          center + cv::Point(-w / 2, -h / 2 + rng.uniform(-8, 8)) });
+    }
+
+    return quads;
+}
+
+// Arguments of the contour benchmarks: number of polygons and antialiasing
+void contours_args(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "polygons", "aa" });
+
+    for (int count : { 1, 100, 1000, 5000 })
+    {
+        for (int aa(0); aa < 2; ++aa)
+        {
+            b->Args({ count, aa });
+        }
+    }
+}
+
+/*
+ * Returns poses of sheets spread in front of the camera of
+ * benchdata::camera_intrinsics(), some of them out of the field of view.
+ */
+std::vector<ocvp::PnPResult> scattered_poses(int count)
+{
+    cv::RNG rng{ 0xF4A3 };
+    std::vector<ocvp::PnPResult> poses;
+
+    for (int i(0); i < count; ++i)
+    {
+        const double z = rng.uniform(0.5, 3.0);
+
+        ocvp::PnPResult pose;
+        pose.rvec = (cv::Mat_<double>(3, 1) << rng.uniform(-0.5, 0.5),
+                     rng.uniform(-0.5, 0.5),
+                     rng.uniform(-3.0, 3.0));
+        pose.tvec = (cv::Mat_<double>(3, 1) << rng.uniform(-0.8, 0.8) * z,
+                     rng.uniform(-0.6, 0.6) * z,
+                     z);
+        poses.push_back(pose);
+    }
+
+    return poses;
+}
+
+// Arguments of the frame axes benchmarks: number of poses
+void poses_args(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "poses" });
+
+    for (int count : { 1, 10, 100, 1000 })
+    {
+        b->Args({ count });
+    }
+}
+
+} // namespace
+
+static void BM_draw_contour(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    ocvp::A4SheetOfPaper sheet = benchdata::a4sheet();
+    std::vector<cv::Point> points{
+        sheet.bottom_left, sheet.bottom_right, sheet.top_right, sheet.top_left
+    };
+    const int thickness = static_cast<int>(state.range(0));
+
+    for (auto _ : state)
+    {
+        ocvp::draw_contour(image, points, cv::Scalar(0, 0, 255), thickness);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_draw_contour)->ArgName("thickness")->Arg(1)->Arg(8);
+
+// The per-edge loop that draw_contour() used, on an 8K image
+static void BM_draw_contours_per_edge(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(7680, 4320);
+    auto quads = scattered_quads(static_cast<int>(state.range(0)), image.size());
+    const int line_type = state.range(1) ? cv::LINE_AA : cv::LINE_8;
+
+    for (auto _ : state)
+    {
+        for (const std::vector<cv::Point>& points : quads)
+        {
+            for (size_t i(0); i < points.size(); ++i)
+            {
+                cv::line(image,
+                         points[i],
+                         points[(i + 1) % points.size()],
+                         cv::Scalar(0, 0, 255),
+                         8,
+                         line_type);
+            }
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * quads.size());
+}
+BENCHMARK(BM_draw_contours_per_edge)->Apply(contours_args)->Unit(benchmark::kMillisecond);
+
+static void BM_draw_contours(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(7680, 4320);
+    auto quads = scattered_quads(static_cast<int>(state.range(0)), image.size());
+    const bool antialiased = state.range(1) != 0;
+
+    for (auto _ : state)
+    {
+        ocvp::draw_contours(image, quads, cv::Scalar(0, 0, 255), 8, antialiased);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * quads.size());
+}
+BENCHMARK(BM_draw_contours)->Apply(contours_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_draw_frame_axes(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+    ocvp::PnPResult pose = benchdata::sheet_pose();
+
+    for (auto _ : state)
+    {
+        ocvp::draw_frame_axes(image, intrinsics, distortion, pose.rvec, pose.tvec, 0.1f, 6);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_draw_frame_axes);
+
+static void BM_draw_frame_axes_loop(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+    std::vector<ocvp::PnPResult> poses = scattered_poses(static_cast<int>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        for (const ocvp::PnPResult& pose : poses)
+        {
+            ocvp::draw_frame_axes(image, intrinsics, distortion, pose.rvec, pose.tvec, 0.1f, 6);
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * poses.size());
+}
+BENCHMARK(BM_draw_frame_axes_loop)->Apply(poses_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_draw_frame_axes_batch(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+    std::vector<ocvp::PnPResult> poses = scattered_poses(static_cast<int>(state.range(0)));
+    size_t nb_drawn = 0;
+
+    for (auto _ : state)
+    {
+        nb_drawn = ocvp::draw_frame_axes_batch(image, camera, poses, 0.1f, 6);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * poses.size());
+    state.counters["drawn"] = static_cast<double>(nb_drawn);
+}
+BENCHMARK(BM_draw_frame_axes_batch)
+  ->Apply(poses_args)
+  ->Unit(benchmark::kMillisecond)
+  ->UseRealTime();
@@ -0,0 +1,82 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/framepool.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+
+namespace
+{
+
+/*
+ * Allocates a frame with the given allocator, writes every page of it (as
+ * decoding would) and frees it.
+ */
+void allocate_frame(benchmark::State& state, cv::MatAllocator* allocator)
+{
+    const int width = static_cast<int>(state.range(0));
+    const int height = width * 9 / 16;
+
+    for (auto _ : state)
+    {
+        cv::Mat frame;
+        frame.allocator = allocator;
+        frame.create(height, width, CV_8UC3);
+
+        for (size_t i(0); i < frame.total() * frame.elemSize(); i += 4096)
+        {
+            frame.data[i] = 1;
+        }
+
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * width * height * 3);
+}
+
+ocvp::FramePool& frame_pool()
+{
+    static ocvp::FramePool pool;
+    return pool;
+}
+
+} // namespace
+
+// The argument is the width of a 16:9 BGR frame
+static void BM_allocate_frame_std(benchmark::State& state)
+{
+    allocate_frame(state, cv::Mat::getStdAllocator());
+}
+BENCHMARK(BM_allocate_frame_std)->Arg(1920)->Arg(3840)->Arg(7680)->Threads(1)->Threads(4);
+
+static void BM_allocate_frame_pool(benchmark::State& state)
+{
+    allocate_frame(state, &frame_pool());
+
+    if (state.thread_index() == 0)
+    {
+        ocvp::FramePoolStatistics stats = frame_pool().statistics();
+        const double nb_allocations = static_cast<double>(stats.nb_hits + stats.nb_misses);
+        state.counters["hit_ratio"] = nb_allocations > 0 ? stats.nb_hits / nb_allocations : 0;
+        state.counters["peak_MiB"] = stats.peak_bytes / (1024.0 * 1024.0);
+    }
+}
+BENCHMARK(BM_allocate_frame_pool)->Arg(1920)->Arg(3840)->Arg(7680)->Threads(1)->Threads(4);
+
+static void BM_allocate_frame_huge_pages(benchmark::State& state)
+{
+    static ocvp::FramePool pool{ []()
+                                 {
+                                     ocvp::FramePoolOptions options;
+                                     options.huge_pages = true;
+                                     return options;
+                                 }() };
+
+    allocate_frame(state, &pool);
+}
+BENCHMARK(BM_allocate_frame_huge_pages)->Arg(3840)->Arg(7680);
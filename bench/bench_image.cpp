@@ -0,0 +1,272 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/contour.h"
+#include "ocvp/image.h"
+#include "ocvp/imagebatch.h"
+#include "ocvp/imagewriter.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+
+namespace
+{
+
+const char* image_formats[] = { ".jpg", ".png", ".bmp" };
+
+/*
+ * Arguments of the image benchmarks: index in image_formats and width of
+ * the image (with a 4:3 aspect ratio).
+ */
+void image_args(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "format", "width" });
+
+    for (int format(0); format < 3; ++format)
+    {
+        for (int width : { 640, 1920, 4000 })
+        {
+            b->Args({ format, width });
+        }
+    }
+}
+
+void reduced_args(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "reduction", "gray" });
+
+    for (int reduction : { 1, 2, 4, 8 })
+    {
+        for (int gray(0); gray < 2; ++gray)
+        {
+            b->Args({ reduction, gray });
+        }
+    }
+}
+
+/*
+ * A batch of 16 JPEG images of 4000x3000 pixels, with the paths of the
+ * results of their processing.
+ */
+std::vector<ocvp::ImageBatchItem> make_batch()
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    std::vector<ocvp::ImageBatchItem> items(16);
+
+    for (ocvp::ImageBatchItem& item : items)
+    {
+        item.input_path = benchdata::temp_file(".jpg");
+        item.output_path = benchdata::temp_file(".jpg");
+        ocvp::save_image(image, item.input_path);
+    }
+
+    return items;
+}
+
+void remove_batch(const std::vector<ocvp::ImageBatchItem>& items)
+{
+    for (const ocvp::ImageBatchItem& item : items)
+    {
+        std::remove(item.input_path.c_str());
+        std::remove(item.output_path.c_str());
+    }
+}
+
+void draw_sheet(cv::Mat& image)
+{
+    ocvp::A4SheetOfPaper sheet = benchdata::a4sheet();
+    std::vector<cv::Point> points{
+        sheet.bottom_left, sheet.bottom_right, sheet.top_right, sheet.top_left
+    };
+
+    ocvp::draw_contour(image, points, cv::Scalar(0, 0, 255), 8);
+}
+
+} // namespace
+
+static void BM_save_image(benchmark::State& state)
+{
+    const char* extension = image_formats[state.range(0)];
+    const int width = static_cast<int>(state.range(1));
+    const std::string path = benchdata::temp_file(extension);
+    cv::Mat image = benchdata::image(width, width * 3 / 4);
+
+    for (auto _ : state)
+    {
+        bool ok = ocvp::save_image(image, path);
+        benchmark::DoNotOptimize(ok);
+    }
+
+    state.SetLabel(extension);
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_save_image)->Apply(image_args)->Unit(benchmark::kMillisecond);
+
+static void BM_load_image(benchmark::State& state)
+{
+    const char* extension = image_formats[state.range(0)];
+    const int width = static_cast<int>(state.range(1));
+    const std::string path = benchdata::temp_file(extension);
+    cv::Mat image = benchdata::image(width, width * 3 / 4);
+    ocvp::save_image(image, path);
+
+    for (auto _ : state)
+    {
+        cv::Mat loaded = ocvp::load_image(path);
+        benchmark::DoNotOptimize(loaded.data);
+    }
+
+    state.SetLabel(extension);
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_load_image)->Apply(image_args)->Unit(benchmark::kMillisecond);
+
+// Arguments: reduction (1, 2, 4 or 8) and grayscale (0 or 1), on a 4000x3000 JPEG
+static void BM_load_image_reduced(benchmark::State& state)
+{
+    const std::string path = benchdata::temp_file(".jpg");
+    ocvp::save_image(benchdata::image(4000, 3000), path);
+
+    ocvp::LoadOptions options;
+    options.reduction = static_cast<int>(state.range(0));
+    options.grayscale = state.range(1) != 0;
+    size_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        cv::Mat loaded = ocvp::load_image(path, options);
+        bytes = loaded.total() * loaded.elemSize();
+        benchmark::DoNotOptimize(loaded.data);
+    }
+
+    state.counters["image_bytes"] = static_cast<double>(bytes);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_load_image_reduced)->Apply(reduced_args)->Unit(benchmark::kMillisecond);
+
+// The argument is the JPEG quality
+static void BM_encode_image_jpeg(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    ocvp::EncodeOptions options;
+    options.jpeg_quality = static_cast<int>(state.range(0));
+    size_t size = 0;
+
+    for (auto _ : state)
+    {
+        std::vector<uchar> buffer = ocvp::encode_image(image, ".jpg", options);
+        size = buffer.size();
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.counters["file_bytes"] = static_cast<double>(size);
+}
+BENCHMARK(BM_encode_image_jpeg)->Arg(50)->Arg(75)->Arg(95)->Unit(benchmark::kMillisecond);
+
+// Time to write 16 images with save_image(), for comparison with BM_async_image_writer
+static void BM_save_image_sequential(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    const std::string path = benchdata::temp_file(".jpg");
+
+    for (auto _ : state)
+    {
+        for (int i(0); i < 16; ++i)
+        {
+            ocvp::save_image(image, path);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * 16);
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_save_image_sequential)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The argument is the number of threads of the writer
+static void BM_async_image_writer(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(4000, 3000);
+    std::vector<std::string> paths;
+
+    for (int i(0); i < 16; ++i)
+    {
+        paths.push_back(benchdata::temp_file(".jpg"));
+    }
+
+    ocvp::AsyncImageWriterOptions options;
+    options.nb_threads = static_cast<size_t>(state.range(0));
+    ocvp::AsyncImageWriter writer{ options };
+
+    for (auto _ : state)
+    {
+        for (const std::string& path : paths)
+        {
+            writer.write(image, path);
+        }
+
+        writer.wait();
+    }
+
+    ocvp::AsyncImageWriterStatistics stats = writer.statistics();
+    const double nb_images = static_cast<double>(stats.nb_written + stats.nb_failed);
+    state.counters["latency_ms"] = nb_images > 0 ? stats.total_latency_ms / nb_images : 0;
+    state.counters["blocked_ms"] = nb_images > 0 ? stats.total_blocked_ms / nb_images : 0;
+    state.SetItemsProcessed(state.iterations() * 16);
+
+    for (const std::string& path : paths)
+    {
+        std::remove(path.c_str());
+    }
+}
+BENCHMARK(BM_async_image_writer)->Arg(1)->Arg(2)->Arg(4)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// What drawcontour did for each image before its batch mode
+static void BM_image_batch_serial(benchmark::State& state)
+{
+    std::vector<ocvp::ImageBatchItem> items = make_batch();
+
+    for (auto _ : state)
+    {
+        for (const ocvp::ImageBatchItem& item : items)
+        {
+            cv::Mat image = ocvp::load_image(item.input_path);
+            draw_sheet(image);
+            ocvp::save_image(image, item.output_path);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * items.size());
+    remove_batch(items);
+}
+BENCHMARK(BM_image_batch_serial)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The argument is the number of decoding threads and of encoding threads
+static void BM_process_image_batch(benchmark::State& state)
+{
+    std::vector<ocvp::ImageBatchItem> items = make_batch();
+
+    ocvp::ImageBatchOptions options;
+    options.nb_threads = static_cast<size_t>(state.range(0));
+    options.nb_encode_threads = options.nb_threads;
+    ocvp::ImageBatchStatistics stats;
+
+    for (auto _ : state)
+    {
+        stats = ocvp::process_image_batch(
+          items, [](size_t, cv::Mat& image, double) { draw_sheet(image); }, options);
+    }
+
+    state.counters["peak_decoded_MiB"] = stats.peak_decoded_bytes / (1024.0 * 1024.0);
+    state.counters["reader_blocked_ms"] = stats.blocked_ms;
+    state.SetItemsProcessed(state.iterations() * items.size());
+    remove_batch(items);
+}
+BENCHMARK(BM_process_image_batch)->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,121 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/pixelformat.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+
+int source_type(ocvp::PixelConversion conversion)
+{
+    return conversion == ocvp::PixelConversion::RGB32_TO_BGR
+               || conversion == ocvp::PixelConversion::RGBA_TO_BGR
+             ? CV_8UC4
+             : CV_8UC3;
+}
+
+const char* conversion_name(ocvp::PixelConversion conversion)
+{
+    switch (conversion)
+    {
+    case ocvp::PixelConversion::BGR_TO_RGB32:
+        return "BGR_TO_RGB32";
+    case ocvp::PixelConversion::RGB32_TO_BGR:
+        return "RGB32_TO_BGR";
+    case ocvp::PixelConversion::BGR_TO_RGBA:
+        return "BGR_TO_RGBA";
+    case ocvp::PixelConversion::RGBA_TO_BGR:
+        return "RGBA_TO_BGR";
+    case ocvp::PixelConversion::BGR_TO_GRAY:
+        return "BGR_TO_GRAY";
+    case ocvp::PixelConversion::RGB_TO_BGR:
+        return "RGB_TO_BGR";
+    }
+
+    return "";
+}
+
+/*
+ * Arguments: the conversion and, for convert_pixels(), the SimdLevel.
+ */
+void conversion_args(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "conversion", "simd" });
+
+    for (int conversion(0); conversion <= static_cast<int>(ocvp::PixelConversion::RGB_TO_BGR);
+         ++conversion)
+    {
+        for (int level(0); level <= static_cast<int>(ocvp::SimdLevel::AVX2); ++level)
+        {
+            b->Args({ conversion, level });
+        }
+    }
+}
+
+} // namespace
+
+/*
+ * Both benchmarks use a 4K frame.
+ * The output of convert_pixels() is checked against the reference once,
+ * before timing, so that a fast but wrong kernel cannot go unnoticed.
+ */
+
+static void BM_convert_pixels(benchmark::State& state)
+{
+    auto conversion = static_cast<ocvp::PixelConversion>(state.range(0));
+    auto level = static_cast<ocvp::SimdLevel>(state.range(1));
+
+    if (level > ocvp::best_simd_level())
+    {
+        state.SkipWithError("instruction set not supported by this CPU");
+        return;
+    }
+
+    cv::Mat src = benchdata::image(3840, 2160, source_type(conversion));
+    cv::Mat dst;
+    cv::Mat expected;
+
+    ocvp::convert_pixels(src, dst, conversion, level);
+    ocvp::convert_pixels_reference(src, expected, conversion);
+
+    if (cv::norm(dst, expected, cv::NORM_INF) != 0)
+    {
+        state.SkipWithError("output differs from convert_pixels_reference()");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        ocvp::convert_pixels(src, dst, conversion, level);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetLabel(conversion_name(conversion));
+    state.SetItemsProcessed(state.iterations() * src.total());
+}
+BENCHMARK(BM_convert_pixels)->Apply(conversion_args)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_convert_pixels_reference(benchmark::State& state)
+{
+    auto conversion = static_cast<ocvp::PixelConversion>(state.range(0));
+    cv::Mat src = benchdata::image(3840, 2160, source_type(conversion));
+    cv::Mat dst;
+
+    for (auto _ : state)
+    {
+        ocvp::convert_pixels_reference(src, dst, conversion);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetLabel(conversion_name(conversion));
+    state.SetItemsProcessed(state.iterations() * src.total());
+}
+BENCHMARK(BM_convert_pixels_reference)
+  ->ArgName("conversion")
+  ->DenseRange(0, static_cast<int>(ocvp::PixelConversion::RGB_TO_BGR))
+  ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,349 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/pnp.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+
+// Reports the distance between a pose and the one used to generate the
+// corners of benchdata::a4sheet(), which are rounded to the pixel.
+static void set_accuracy_counters(benchmark::State& state, const ocvp::Pose& pose)
+{
+    ocvp::Pose expected = ocvp::to_pose(benchdata::sheet_pose());
+    cv::Matx33d delta = ocvp::get_rotation_matrix(pose.rvec)
+                        * ocvp::get_rotation_matrix(expected.rvec).t();
+
+    state.counters["rotation_error_deg"] =
+      cv::norm(ocvp::get_rotation_vector(delta)) * 180 / CV_PI;
+    state.counters["translation_error_mm"] = cv::norm(pose.tvec - expected.tvec) * 1000;
+}
+
+static void BM_solve_pnp(benchmark::State& state)
+{
+    ocvp::A4SheetOfPaper sheet = benchdata::a4sheet();
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        ocvp::PnPResult result = ocvp::solve_pnp(sheet, intrinsics, distortion);
+        benchmark::DoNotOptimize(result.rvec.data);
+    }
+
+    set_accuracy_counters(state, ocvp::to_pose(ocvp::solve_pnp(sheet, intrinsics, distortion)));
+}
+BENCHMARK(BM_solve_pnp);
+
+static void BM_solve_pnp_fixed(benchmark::State& state)
+{
+    ocvp::A4SheetOfPaper sheet = benchdata::a4sheet();
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+
+    for (auto _ : state)
+    {
+        ocvp::Pose pose;
+        bool ok = ocvp::solve_pnp(sheet, camera, pose);
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(pose);
+    }
+
+    ocvp::Pose pose;
+    ocvp::solve_pnp(sheet, camera, pose);
+    set_accuracy_counters(state, pose);
+}
+BENCHMARK(BM_solve_pnp_fixed);
+
+// The argument is the number of Gauss-Newton steps
+static void BM_solve_pnp_a4(benchmark::State& state)
+{
+    ocvp::A4SheetOfPaper sheet = benchdata::a4sheet();
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+    const int refinement_steps = static_cast<int>(state.range(0));
+
+    for (auto _ : state)
+    {
+        ocvp::Pose pose;
+        bool ok = ocvp::solve_pnp_a4(sheet, camera, pose, refinement_steps);
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(pose);
+    }
+
+    ocvp::Pose pose;
+    ocvp::solve_pnp_a4(sheet, camera, pose, refinement_steps);
+    set_accuracy_counters(state, pose);
+}
+BENCHMARK(BM_solve_pnp_a4)->DenseRange(0, 2);
+
+// The argument selects the target: 0 for A4Target, whose size is known at
+// compile time, 1 for a PlanarTarget of the same size that is not
+// recognized as a standard size (hence solved by the generic code)
+static void BM_solve_pnp_target(benchmark::State& state)
+{
+    ocvp::A4SheetOfPaper sheet = benchdata::a4sheet();
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+    ocvp::PlanarTarget target = ocvp::A4Target();
+
+    if (state.range(0) == 1)
+    {
+        target.width = std::nextafter(target.width, 1.0);
+    }
+
+    for (auto _ : state)
+    {
+        ocvp::Pose pose;
+        bool ok = ocvp::solve_pnp(sheet, target, camera, pose);
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(pose);
+    }
+
+    ocvp::Pose pose;
+    ocvp::solve_pnp(sheet, target, camera, pose);
+    set_accuracy_counters(state, pose);
+}
+BENCHMARK(BM_solve_pnp_target)->ArgName("runtime")->DenseRange(0, 1);
+
+// Returns the corners of sheets spread in front of the camera
+static std::vector<ocvp::A4SheetOfPaper> scattered_sheets(int count)
+{
+    cv::RNG rng{ 0x5A4 };
+    std::vector<ocvp::A4SheetOfPaper> sheets;
+
+    for (int i(0); i < count; ++i)
+    {
+        const double z = rng.uniform(0.6, 2.5);
+
+        ocvp::PnPResult pose;
+        pose.rvec = (cv::Mat_<double>(3, 1) << rng.uniform(-0.4, 0.4),
+                     rng.uniform(-0.4, 0.4),
+                     rng.uniform(-0.5, 0.5));
+        pose.tvec = (cv::Mat_<double>(3, 1) << rng.uniform(-0.5, 0.4) * z,
+                     rng.uniform(-0.4, 0.3) * z,
+                     z);
+        sheets.push_back(benchdata::a4sheet(pose));
+    }
+
+    return sheets;
+}
+
+// The argument is the number of sheets
+static void BM_solve_pnp_loop(benchmark::State& state)
+{
+    std::vector<ocvp::A4SheetOfPaper> sheets = scattered_sheets(static_cast<int>(state.range(0)));
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        for (const ocvp::A4SheetOfPaper& sheet : sheets)
+        {
+            ocvp::PnPResult result = ocvp::solve_pnp(sheet, intrinsics, distortion);
+            benchmark::DoNotOptimize(result.rvec.data);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * sheets.size());
+}
+BENCHMARK(BM_solve_pnp_loop)->Arg(10)->Arg(50)->Arg(200)->UseRealTime();
+
+static void BM_solve_pnp_many(benchmark::State& state)
+{
+    std::vector<ocvp::A4SheetOfPaper> sheets = scattered_sheets(static_cast<int>(state.range(0)));
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        std::vector<ocvp::PnPTargetResult> results =
+          ocvp::solve_pnp_many(sheets, intrinsics, distortion);
+        benchmark::DoNotOptimize(results.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * sheets.size());
+}
+BENCHMARK(BM_solve_pnp_many)->Arg(10)->Arg(50)->Arg(200)->UseRealTime();
+
+// Points of a grid printed on a A4 sheet seen in sheet_pose(), with 0.5px of
+// noise; a given percentage of them are moved to random locations.
+struct Correspondences
+{
+    std::vector<cv::Point2d> object_points;
+    std::vector<cv::Point2d> image_points;
+};
+
+static Correspondences grid_correspondences(int count, int outlier_percentage)
+{
+    cv::RNG rng{ 0x6E1D };
+    Correspondences result;
+    std::vector<cv::Point3d> object_points;
+
+    for (int i(0); i < count; ++i)
+    {
+        const cv::Point2d p{ rng.uniform(0.0, 0.21), rng.uniform(0.0, 0.297) };
+        result.object_points.push_back(p);
+        object_points.emplace_back(p.x, p.y, 0);
+    }
+
+    const ocvp::PnPResult pose = benchdata::sheet_pose();
+    cv::projectPoints(object_points,
+                      pose.rvec,
+                      pose.tvec,
+                      ocvp::make_camera_matrix(benchdata::camera_intrinsics()),
+                      ocvp::make_distcoeffs_vector(benchdata::distortion_coeffs()),
+                      result.image_points);
+
+    for (cv::Point2d& p : result.image_points)
+    {
+        if (rng.uniform(0, 100) < outlier_percentage)
+        {
+            p = cv::Point2d(rng.uniform(0.0, 4000.0), rng.uniform(0.0, 3000.0));
+        }
+        else
+        {
+            p += cv::Point2d(rng.gaussian(0.5), rng.gaussian(0.5));
+        }
+    }
+
+    return result;
+}
+
+static void ransac_args(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({ "points", "outliers%", "simd" });
+
+    for (int count : { 100, 500 })
+    {
+        for (int outliers : { 10, 40 })
+        {
+            for (int level(0); level <= 2; ++level)
+            {
+                b->Args({ count, outliers, level });
+            }
+        }
+    }
+}
+
+// The last argument selects the highest SimdLevel allowed (0: None, 1: SSE4.1, 2: AVX2)
+static void BM_solve_pnp_ransac(benchmark::State& state)
+{
+    const Correspondences data = grid_correspondences(static_cast<int>(state.range(0)),
+                                                      static_cast<int>(state.range(1)));
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+    ocvp::PnPRansacOptions options;
+    options.max_level = static_cast<ocvp::SimdLevel>(state.range(2));
+    ocvp::PnPRansacResult result;
+
+    for (auto _ : state)
+    {
+        result = ocvp::solve_pnp_ransac(data.object_points, data.image_points, camera, options);
+        benchmark::DoNotOptimize(result.pose);
+    }
+
+    state.counters["iterations"] = result.nb_iterations;
+    state.counters["inliers"] = static_cast<double>(result.nb_inliers);
+    set_accuracy_counters(state, result.pose);
+}
+BENCHMARK(BM_solve_pnp_ransac)->Apply(ransac_args)->UseRealTime();
+
+// Reference: OpenCV's RANSAC with the iterative method, and the same
+// threshold and confidence as the default PnPRansacOptions
+static void BM_solve_pnp_ransac_opencv(benchmark::State& state)
+{
+    const Correspondences data = grid_correspondences(static_cast<int>(state.range(0)),
+                                                      static_cast<int>(state.range(1)));
+    std::vector<cv::Point3d> object_points;
+
+    for (const cv::Point2d& p : data.object_points)
+    {
+        object_points.emplace_back(p.x, p.y, 0);
+    }
+
+    const cv::Mat camera_matrix = ocvp::make_camera_matrix(benchdata::camera_intrinsics());
+    const std::vector<double> dist_coeffs =
+      ocvp::make_distcoeffs_vector(benchdata::distortion_coeffs());
+    const ocvp::PnPRansacOptions options;
+    ocvp::PnPResult result;
+    std::vector<int> inliers;
+
+    for (auto _ : state)
+    {
+        cv::solvePnPRansac(object_points,
+                           data.image_points,
+                           camera_matrix,
+                           dist_coeffs,
+                           result.rvec,
+                           result.tvec,
+                           false,
+                           options.max_iterations,
+                           static_cast<float>(options.reprojection_threshold),
+                           options.confidence,
+                           inliers);
+        benchmark::DoNotOptimize(result.rvec.data);
+    }
+
+    state.counters["inliers"] = static_cast<double>(inliers.size());
+    set_accuracy_counters(state, ocvp::to_pose(result));
+}
+BENCHMARK(BM_solve_pnp_ransac_opencv)
+  ->ArgNames({ "points", "outliers%" })
+  ->Args({ 100, 10 })
+  ->Args({ 100, 40 })
+  ->Args({ 500, 10 })
+  ->Args({ 500, 40 })
+  ->UseRealTime();
+
+static void BM_get_rotation_matrix(benchmark::State& state)
+{
+    ocvp::PnPResult pose = benchdata::sheet_pose();
+
+    for (auto _ : state)
+    {
+        cv::Mat rot = ocvp::get_rotation_matrix(pose.rvec);
+        benchmark::DoNotOptimize(rot.data);
+    }
+}
+BENCHMARK(BM_get_rotation_matrix);
+
+static void BM_get_rotation_matrix_fixed(benchmark::State& state)
+{
+    ocvp::Pose pose = ocvp::to_pose(benchdata::sheet_pose());
+
+    for (auto _ : state)
+    {
+        cv::Matx33d rot = ocvp::get_rotation_matrix(pose.rvec);
+        benchmark::DoNotOptimize(rot);
+    }
+}
+BENCHMARK(BM_get_rotation_matrix_fixed);
+
+static void BM_compute_camera_position(benchmark::State& state)
+{
+    ocvp::PnPResult pose = benchdata::sheet_pose();
+
+    for (auto _ : state)
+    {
+        cv::Mat pos = ocvp::compute_camera_position(pose.rvec, pose.tvec);
+        benchmark::DoNotOptimize(pos.data);
+    }
+}
+BENCHMARK(BM_compute_camera_position);
+
+static void BM_compute_camera_position_fixed(benchmark::State& state)
+{
+    ocvp::Pose pose = ocvp::to_pose(benchdata::sheet_pose());
+
+    for (auto _ : state)
+    {
+        cv::Vec3d pos = ocvp::compute_camera_position(pose);
+        benchmark::DoNotOptimize(pos);
+    }
+}
+BENCHMARK(BM_compute_camera_position_fixed);
@@ -0,0 +1,79 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/posetracker.h"
+
+#include <benchmark/benchmark.h>
+
+static const int nb_frames = 300;
+
+static void BM_solve_pnp_sequence(benchmark::State& state)
+{
+    std::vector<ocvp::A4SheetOfPaper> frames = benchdata::a4sheet_sequence(nb_frames);
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        for (const ocvp::A4SheetOfPaper& sheet : frames)
+        {
+            ocvp::PnPResult result = ocvp::solve_pnp(sheet, intrinsics, distortion);
+            benchmark::DoNotOptimize(result.rvec.data);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * frames.size());
+}
+BENCHMARK(BM_solve_pnp_sequence);
+
+static void BM_solve_pnp_sequence_guess(benchmark::State& state)
+{
+    std::vector<ocvp::A4SheetOfPaper> frames = benchdata::a4sheet_sequence(nb_frames);
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        ocvp::PnPResult result = ocvp::solve_pnp(frames.front(), intrinsics, distortion);
+
+        for (const ocvp::A4SheetOfPaper& sheet : frames)
+        {
+            result = ocvp::solve_pnp(sheet, intrinsics, distortion, result);
+            benchmark::DoNotOptimize(result.rvec.data);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * frames.size());
+}
+BENCHMARK(BM_solve_pnp_sequence_guess);
+
+// The argument is PoseTrackerOptions::max_iterations
+static void BM_pose_tracker_sequence(benchmark::State& state)
+{
+    std::vector<ocvp::A4SheetOfPaper> frames = benchdata::a4sheet_sequence(nb_frames);
+    ocvp::PoseTrackerOptions options;
+    options.max_iterations = static_cast<int>(state.range(0));
+    double warm_start_ratio = 0;
+
+    for (auto _ : state)
+    {
+        ocvp::PoseTracker tracker{ benchdata::camera_intrinsics(),
+                                   benchdata::distortion_coeffs(),
+                                   options };
+
+        for (const ocvp::A4SheetOfPaper& sheet : frames)
+        {
+            ocvp::PnPResult result = tracker.track(sheet);
+            benchmark::DoNotOptimize(result.rvec.data);
+        }
+
+        warm_start_ratio = tracker.warm_start_ratio();
+    }
+
+    state.SetItemsProcessed(state.iterations() * frames.size());
+    state.counters["warm_start_ratio"] = warm_start_ratio;
+}
+BENCHMARK(BM_pose_tracker_sequence)->Arg(1)->Arg(3)->Arg(5)->Arg(10);
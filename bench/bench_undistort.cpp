@@ -0,0 +1,253 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "benchdata.h"
+
+#include "ocvp/undistort.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static const cv::Size image_size{ 4000, 3000 };
+
+static ocvp::UndistortMapFormat map_format(const benchmark::State& state)
+{
+    return state.range(0) ? ocvp::UndistortMapFormat::FixedPoint : ocvp::UndistortMapFormat::Float;
+}
+
+// directory in which cv::tempfile() creates its files
+static std::string temp_dir()
+{
+    std::string path = benchdata::temp_file(".tmp");
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? std::string(".") : path.substr(0, separator);
+}
+
+static void BM_undistort_opencv(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(image_size.width, image_size.height);
+    cv::Mat camera_matrix = ocvp::make_camera_matrix(benchdata::camera_intrinsics());
+    std::vector<double> dist_coeffs = ocvp::make_distcoeffs_vector(benchdata::distortion_coeffs());
+    cv::Mat output;
+
+    for (auto _ : state)
+    {
+        cv::undistort(image, output, camera_matrix, dist_coeffs);
+        benchmark::DoNotOptimize(output.data);
+    }
+}
+BENCHMARK(BM_undistort_opencv)->Unit(benchmark::kMillisecond);
+
+// The argument selects the map format (0: float, 1: fixed-point)
+static void BM_compute_undistort_maps(benchmark::State& state)
+{
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+
+    for (auto _ : state)
+    {
+        ocvp::UndistortMaps maps =
+          ocvp::compute_undistort_maps(intrinsics, distortion, image_size, map_format(state));
+        benchmark::DoNotOptimize(maps.map1.data);
+    }
+}
+BENCHMARK(BM_compute_undistort_maps)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+static void BM_undistort_cached(benchmark::State& state)
+{
+    cv::Mat image = benchdata::image(image_size.width, image_size.height);
+    ocvp::CameraIntrinsics intrinsics = benchdata::camera_intrinsics();
+    ocvp::DistortionCoefficients distortion = benchdata::distortion_coeffs();
+    ocvp::UndistortMapCache cache{ std::string(), map_format(state) };
+    cv::Mat output;
+
+    for (auto _ : state)
+    {
+        cache.undistort(image, output, intrinsics, distortion);
+        benchmark::DoNotOptimize(output.data);
+    }
+}
+BENCHMARK(BM_undistort_cached)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Startup cost of a process whose maps were persisted by a previous one
+static void BM_undistort_map_cache_load(benchmark::State& state)
+{
+    const std::string dir = temp_dir();
+    std::string path;
+
+    {
+        ocvp::UndistortMapCache cache{ dir, map_format(state) };
+        cache.get(benchdata::camera_intrinsics(), benchdata::distortion_coeffs(), image_size);
+        path = cache.file_path(ocvp::undistort_map_key(
+          benchdata::camera_intrinsics(), benchdata::distortion_coeffs(), image_size));
+    }
+
+    for (auto _ : state)
+    {
+        ocvp::UndistortMapCache cache{ dir, map_format(state) };
+        ocvp::UndistortMaps maps =
+          cache.get(benchdata::camera_intrinsics(), benchdata::distortion_coeffs(), image_size);
+        benchmark::DoNotOptimize(maps.map1.data);
+    }
+
+    std::remove(path.c_str());
+}
+BENCHMARK(BM_undistort_map_cache_load)->Arg(0)->Arg(1);
+
+// Points spread over the image, stored as a structure of arrays
+struct PointBatch
+{
+    std::vector<float> x;
+    std::vector<float> y;
+};
+
+static PointBatch point_batch(size_t count)
+{
+    PointBatch batch;
+    batch.x.resize(count);
+    batch.y.resize(count);
+    cv::RNG rng{ 42 };
+
+    for (size_t i(0); i < count; ++i)
+    {
+        batch.x[i] = rng.uniform(0.f, float(image_size.width - 1));
+        batch.y[i] = rng.uniform(0.f, float(image_size.height - 1));
+    }
+
+    return batch;
+}
+
+// Largest distance, in pixels, to the exact undistort_point() result
+static double max_error_px(const PointBatch& batch,
+                           const std::vector<float>& undistorted_x,
+                           const std::vector<float>& undistorted_y)
+{
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+    const double fx = camera.camera_matrix(0, 0);
+    const double fy = camera.camera_matrix(1, 1);
+    double error = 0;
+
+    for (size_t i(0); i < std::min(batch.x.size(), size_t(65536)); ++i)
+    {
+        cv::Point2d p = ocvp::undistort_point(camera, cv::Point2d(batch.x[i], batch.y[i]));
+        const double dx = (undistorted_x[i] - p.x) * fx;
+        const double dy = (undistorted_y[i] - p.y) * fy;
+        error = std::max(error, std::hypot(dx, dy));
+    }
+
+    return error;
+}
+
+static void set_point_counters(benchmark::State& state,
+                               const PointBatch& batch,
+                               const std::vector<float>& undistorted_x,
+                               const std::vector<float>& undistorted_y)
+{
+    state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(batch.x.size()));
+    state.counters["max_error_px"] = max_error_px(batch, undistorted_x, undistorted_y);
+}
+
+// The iterative method of OpenCV (5 iterations with the default criteria)
+static void BM_undistort_points_opencv(benchmark::State& state)
+{
+    PointBatch batch = point_batch(size_t(state.range(0)));
+    std::vector<cv::Point2f> points(batch.x.size());
+    std::vector<cv::Point2f> output;
+    cv::Mat camera_matrix = ocvp::make_camera_matrix(benchdata::camera_intrinsics());
+    std::vector<double> dist_coeffs = ocvp::make_distcoeffs_vector(benchdata::distortion_coeffs());
+
+    for (size_t i(0); i < points.size(); ++i)
+    {
+        points[i] = cv::Point2f(batch.x[i], batch.y[i]);
+    }
+
+    for (auto _ : state)
+    {
+        cv::undistortPoints(points, output, camera_matrix, dist_coeffs);
+        benchmark::DoNotOptimize(output.data());
+    }
+
+    std::vector<float> undistorted_x(output.size());
+    std::vector<float> undistorted_y(output.size());
+
+    for (size_t i(0); i < output.size(); ++i)
+    {
+        undistorted_x[i] = output[i].x;
+        undistorted_y[i] = output[i].y;
+    }
+
+    set_point_counters(state, batch, undistorted_x, undistorted_y);
+}
+BENCHMARK(BM_undistort_points_opencv)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// Iterated until convergence, one point at a time
+static void BM_undistort_point_exact(benchmark::State& state)
+{
+    PointBatch batch = point_batch(size_t(state.range(0)));
+    std::vector<float> undistorted_x(batch.x.size());
+    std::vector<float> undistorted_y(batch.y.size());
+    ocvp::CameraModel camera =
+      ocvp::make_camera_model(benchdata::camera_intrinsics(), benchdata::distortion_coeffs());
+
+    for (auto _ : state)
+    {
+        for (size_t i(0); i < batch.x.size(); ++i)
+        {
+            cv::Point2d p = ocvp::undistort_point(camera, cv::Point2d(batch.x[i], batch.y[i]));
+            undistorted_x[i] = static_cast<float>(p.x);
+            undistorted_y[i] = static_cast<float>(p.y);
+        }
+
+        benchmark::DoNotOptimize(undistorted_x.data());
+    }
+
+    set_point_counters(state, batch, undistorted_x, undistorted_y);
+}
+BENCHMARK(BM_undistort_point_exact)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// The argument is the maximum interpolation error, in thousandths of a pixel
+static void BM_make_undistort_lut(benchmark::State& state)
+{
+    const double max_error = state.range(0) / 1000.0;
+    int step = 0;
+
+    for (auto _ : state)
+    {
+        ocvp::UndistortLut lut{ benchdata::camera_intrinsics(),
+                                benchdata::distortion_coeffs(),
+                                image_size,
+                                max_error };
+        step = lut.step();
+        benchmark::DoNotOptimize(lut.x_table());
+    }
+
+    state.counters["step"] = step;
+}
+BENCHMARK(BM_make_undistort_lut)->Arg(100)->Arg(10)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// The argument selects the highest SimdLevel allowed (0: None, 1: SSE4.1, 2: AVX2)
+static void BM_undistort_points_batch(benchmark::State& state)
+{
+    PointBatch batch = point_batch(1 << 20);
+    ocvp::UndistortLut lut{ benchdata::camera_intrinsics(),
+                            benchdata::distortion_coeffs(),
+                            image_size };
+    std::vector<float> undistorted_x;
+    std::vector<float> undistorted_y;
+    const auto level = static_cast<ocvp::SimdLevel>(state.range(0));
+
+    for (auto _ : state)
+    {
+        ocvp::undistort_points_batch(lut, batch.x, batch.y, undistorted_x, undistorted_y, level);
+        benchmark::DoNotOptimize(undistorted_x.data());
+    }
+
+    set_point_counters(state, batch, undistorted_x, undistorted_y);
+    state.counters["step"] = lut.step();
+}
+BENCHMARK(BM_undistort_points_batch)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
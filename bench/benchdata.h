@@ -0,0 +1,169 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef BENCHDATA_H
+#define BENCHDATA_H
+
+/**
+ * @file benchdata.h
+ * @brief synthetic inputs shared by the benchmarks
+ */
+
+#include "ocvp/camera.h"
+#include "ocvp/pnp.h"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace benchdata
+{
+
+/**
+ * @brief intrinsics of a 12 MP (4000x3000) camera
+ */
+inline ocvp::CameraIntrinsics camera_intrinsics()
+{
+    ocvp::CameraIntrinsics intrinsics;
+    intrinsics.fx = 3200;
+    intrinsics.fy = 3200;
+    intrinsics.cx = 2000;
+    intrinsics.cy = 1500;
+    return intrinsics;
+}
+
+inline ocvp::DistortionCoefficients distortion_coeffs()
+{
+    ocvp::DistortionCoefficients coeffs;
+    coeffs.k1 = 0.12;
+    coeffs.k2 = -0.35;
+    coeffs.p1 = 0.001;
+    coeffs.p2 = -0.0005;
+    coeffs.k3 = 0.2;
+    coeffs.k4 = 0;
+    coeffs.k5 = 0;
+    coeffs.k6 = 0;
+    return coeffs;
+}
+
+/**
+ * @brief returns a pose of the sheet of paper, seen from about 60cm
+ */
+inline ocvp::PnPResult sheet_pose()
+{
+    ocvp::PnPResult pose;
+    pose.rvec = (cv::Mat_<double>(3, 1) << 0.15, -0.25, 0.05);
+    pose.tvec = (cv::Mat_<double>(3, 1) << -0.1, -0.15, 0.6);
+    return pose;
+}
+
+/**
+ * @brief returns the corners of a A4 sheet of paper seen in a given pose
+ */
+inline ocvp::A4SheetOfPaper a4sheet(const ocvp::PnPResult& pose)
+{
+    std::vector<cv::Point3d> object_points{ cv::Point3d(0, 0, 0),
+                                            cv::Point3d(0.21, 0, 0),
+                                            cv::Point3d(0.21, 0.297, 0),
+                                            cv::Point3d(0, 0.297, 0) };
+
+    std::vector<cv::Point2d> image_points;
+    cv::projectPoints(object_points,
+                      pose.rvec,
+                      pose.tvec,
+                      ocvp::make_camera_matrix(camera_intrinsics()),
+                      ocvp::make_distcoeffs_vector(distortion_coeffs()),
+                      image_points);
+
+    ocvp::A4SheetOfPaper sheet;
+    sheet.bottom_left = image_points.at(0);
+    sheet.bottom_right = image_points.at(1);
+    sheet.top_right = image_points.at(2);
+    sheet.top_left = image_points.at(3);
+    return sheet;
+}
+
+/**
+ * @brief returns the corners of a A4 sheet of paper seen in sheet_pose()
+ */
+inline ocvp::A4SheetOfPaper a4sheet()
+{
+    return a4sheet(sheet_pose());
+}
+
+/**
+ * @brief returns the corners of the sheet in consecutive frames of a video
+ * @param nb_frames  number of frames
+ *
+ * The camera slowly moves around sheet_pose(), like a hand-held camera.
+ */
+inline std::vector<ocvp::A4SheetOfPaper> a4sheet_sequence(int nb_frames)
+{
+    std::vector<ocvp::A4SheetOfPaper> result;
+    result.reserve(nb_frames);
+
+    for (int i(0); i < nb_frames; ++i)
+    {
+        const double t = i / 30.0;
+        ocvp::Pose pose = ocvp::to_pose(sheet_pose());
+        pose.rvec += cv::Vec3d(0.1 * std::sin(t), 0.1 * std::sin(0.7 * t), 0.05 * std::cos(t));
+        pose.tvec += cv::Vec3d(
+          0.03 * std::sin(0.5 * t), 0.02 * std::cos(0.3 * t), 0.05 * std::sin(0.2 * t));
+        result.push_back(a4sheet(ocvp::to_pnp_result(pose)));
+    }
+
+    return result;
+}
+
+/**
+ * @brief returns a smooth, photo-like, BGR image
+ *
+ * Pure noise would not be representative of the compression ratio
+ * (and timings) of real pictures.
+ */
+inline cv::Mat image(int width, int height, int type = CV_8UC3)
+{
+    cv::Mat small{ 48, 64, type };
+    cv::RNG rng{ 0x0CF9 };
+    rng.fill(small, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    cv::Mat result;
+    cv::resize(small, result, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
+    return result;
+}
+
+/**
+ * @brief returns a 4000x3000 BGR picture of a white sheet of paper seen in sheet_pose()
+ *
+ * The sheet stands out on a darker version of image().
+ */
+inline cv::Mat sheet_image()
+{
+    cv::Mat result = image(4000, 3000) * 0.5;
+
+    ocvp::A4SheetOfPaper sheet = a4sheet();
+    std::vector<cv::Point> corners{
+        sheet.bottom_left, sheet.bottom_right, sheet.top_right, sheet.top_left
+    };
+
+    cv::fillConvexPoly(result, corners, cv::Scalar(235, 240, 240), cv::LINE_AA);
+    return result;
+}
+
+/**
+ * @brief returns the path of a temporary file
+ * @param suffix  suffix of the file name, including the extension
+ */
+inline std::string temp_file(const std::string& suffix)
+{
+    return cv::tempfile(suffix.c_str());
+}
+
+} // namespace benchdata
+
+#endif // BENCHDATA_H
@@ -0,0 +1,114 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "camera.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief the result of a camera calibration
+ *
+ * The image size is (0, 0) when it is not known, e.g. for calibrations
+ * imported from JSON files that do not specify it.
+ */
+struct CameraCalibration
+{
+    CameraIntrinsics intrinsics = {};
+    DistortionCoefficients distortion = {};
+    cv::Size image_size;
+};
+
+PLAYGROUND_API bool is_binary_calibration(const std::string& filepath);
+PLAYGROUND_API void save_calibration(const std::string& filepath,
+                                     const CameraCalibration& calibration);
+PLAYGROUND_API CameraCalibration load_calibration(const std::string& filepath);
+
+PLAYGROUND_API CameraCalibration import_calibration_json(const std::string& camera_json_path,
+                                                         const std::string& distortion_json_path);
+PLAYGROUND_API void export_calibration_json(const CameraCalibration& calibration,
+                                            const std::string& camera_json_path,
+                                            const std::string& distortion_json_path);
+
+/**
+ * @brief process-wide cache of calibration files
+ *
+ * Files are parsed once; further requests for the same path return the
+ * same object until the file is modified.
+ */
+class PLAYGROUND_API CalibrationCache
+{
+public:
+    CalibrationCache() = default;
+    CalibrationCache(const CalibrationCache&) = delete;
+
+    static CalibrationCache& global();
+
+    std::shared_ptr<const CameraCalibration> get(const std::string& filepath);
+
+    CameraIntrinsics camera_intrinsics(const std::string& filepath);
+    DistortionCoefficients distortion_coeffs(const std::string& filepath);
+
+    size_t size() const;
+    void clear();
+
+    CalibrationCache& operator=(const CalibrationCache&) = delete;
+
+private:
+    struct Entry
+    {
+        int64_t mtime_ns = 0;
+        uint64_t file_size = 0;
+        std::shared_ptr<const CameraCalibration> calibration;
+    };
+
+private:
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+};
+
+/**
+ * @brief calibrations of a set of cameras, indexed by camera id
+ *
+ * A registry is immutable once constructed, so it can be read concurrently
+ * by any number of threads without synchronization.
+ */
+class PLAYGROUND_API CameraRegistry
+{
+public:
+    CameraRegistry() = default;
+    explicit CameraRegistry(std::vector<std::pair<std::string, CameraCalibration>> cameras);
+
+    size_t size() const;
+    bool empty() const;
+
+    const std::vector<std::string>& ids() const;
+
+    const CameraCalibration* find(const std::string& id) const;
+    const CameraCalibration& at(const std::string& id) const;
+
+private:
+    std::vector<std::string> m_ids;
+    std::vector<CameraCalibration> m_calibrations;
+    std::unordered_map<std::string, size_t> m_index;
+};
+
+PLAYGROUND_API void save_camera_registry(const std::string& filepath,
+                                         const CameraRegistry& registry);
+PLAYGROUND_API CameraRegistry load_camera_registry(const std::string& filepath);
+
+} // namespace ocvp
+
+#endif // CALIBRATION_H
@@ -8,6 +8,7 @@
 #include "defs.h"
 
 #include <opencv2/core/mat.hpp>
+#include <opencv2/core/matx.hpp>
 
 #include <string>
 #include <vector>
@@ -53,6 +54,26 @@ PLAYGROUND_API DistortionCoefficients load_distortion_coeffs(const std::string&
 
 PLAYGROUND_API std::vector<double> make_distcoeffs_vector(const DistortionCoefficients& coeffs);
 
+/**
+ * @brief fixed-size camera model, to be built once per calibration
+ *
+ * Unlike the cv::Mat and std::vector returned by make_camera_matrix() and
+ * make_distcoeffs_vector(), the members of this struct do not use the heap.
+ */
+struct CameraModel
+{
+    cv::Matx33d camera_matrix;
+    cv::Vec<double, 8> dist_coeffs; ///< [ k1, k2, p1, p2, k3, k4, k5, k6 ]
+};
+
+PLAYGROUND_API cv::Matx33d make_camera_matx(const CameraIntrinsics& intrinsics);
+PLAYGROUND_API cv::Vec<double, 8> make_distcoeffs_vec(const DistortionCoefficients& coeffs);
+PLAYGROUND_API CameraModel make_camera_model(const CameraIntrinsics& intrinsics,
+                                             const DistortionCoefficients& coeffs);
+
+PLAYGROUND_API cv::Point2d distort_point(const CameraModel& camera, const cv::Point2d& normalized);
+PLAYGROUND_API cv::Point2d undistort_point(const CameraModel& camera, const cv::Point2d& pixel);
+
 } // namespace ocvp
 
 #endif // CAMERA_H
@@ -19,6 +19,12 @@ PLAYGROUND_API void draw_contour(cv::Mat& image,
                                  const cv::Scalar& color,
                                  int thickness = 6);
 
+PLAYGROUND_API void draw_contours(cv::Mat& image,
+                                  const std::vector<std::vector<cv::Point>>& contours,
+                                  const cv::Scalar& color,
+                                  int thickness = 6,
+                                  bool antialiased = false);
+
 } // namespace ocvp
 
 #endif // CONTOUR_H
@@ -0,0 +1,18 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef DETECTION_H
+#define DETECTION_H
+
+#include "pnp.h"
+
+namespace ocvp
+{
+
+PLAYGROUND_API A4SheetOfPaper detect_a4_sheet(const cv::Mat& image,
+                                              const cv::Rect& roi = cv::Rect());
+
+} // namespace ocvp
+
+#endif // DETECTION_H
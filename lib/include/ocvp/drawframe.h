@@ -6,6 +6,9 @@
 #define DRAWFRAME_H
 
 #include "camera.h"
+#include "pnp.h"
+
+#include <vector>
 
 namespace ocvp
 {
@@ -18,6 +21,25 @@ PLAYGROUND_API void draw_frame_axes(cv::Mat& image,
                                     float length = 1.f,
                                     int thickness = 6);
 
+PLAYGROUND_API bool draw_planar_target(cv::Mat& image,
+                                       const CameraModel& camera,
+                                       const PlanarTarget& target,
+                                       const Pose& pose,
+                                       const cv::Scalar& color = cv::Scalar(0, 255, 255),
+                                       int thickness = 6);
+
+PLAYGROUND_API size_t draw_frame_axes_batch(cv::Mat& image,
+                                            const CameraModel& camera,
+                                            const PnPResult* poses,
+                                            size_t count,
+                                            float length = 1.f,
+                                            int thickness = 6);
+PLAYGROUND_API size_t draw_frame_axes_batch(cv::Mat& image,
+                                            const CameraModel& camera,
+                                            const std::vector<PnPResult>& poses,
+                                            float length = 1.f,
+                                            int thickness = 6);
+
 } // namespace ocvp
 
 #endif // DRAWFRAME_H
@@ -0,0 +1,109 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include "defs.h"
+
+#include <opencv2/core/mat.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace ocvp
+{
+
+struct FramePoolOptions
+{
+    size_t min_pooled_size = 64 * 1024;             ///< smaller buffers are left to the heap
+    size_t max_cached_bytes = 1024 * 1024 * 1024;   ///< bound of the free buffers kept by the pool
+    bool huge_pages = false;                        ///< backs large buffers with huge pages (Linux)
+    size_t huge_page_threshold = 4 * 1024 * 1024;   ///< size from which huge pages are used
+};
+
+/**
+ * @brief statistics of a FramePool
+ *
+ * Only the buffers handled by the pool (i.e. not smaller than
+ * FramePoolOptions::min_pooled_size) are counted. Sizes are those of the
+ * size classes.
+ */
+struct FramePoolStatistics
+{
+    size_t nb_hits = 0;      ///< allocations served by a free buffer
+    size_t nb_misses = 0;    ///< allocations of a new buffer
+    size_t nb_released = 0;  ///< buffers freed because the cache was full, or by trim()
+    size_t in_use_bytes = 0;
+    size_t cached_bytes = 0; ///< free buffers kept for later allocations
+    size_t peak_bytes = 0;   ///< maximum of in_use_bytes + cached_bytes
+};
+
+/**
+ * @brief a cv::Mat allocator recycling buffers, for repeated same-size frames
+ *
+ * Freed buffers are kept in free lists, by size class, and reused by the
+ * next allocations of the same class; so a steady flow of frames of the
+ * same size no longer allocates (nor page-faults) once the pool is warm.
+ * Buffers are 64-byte aligned.
+ *
+ * Each thread has its own free lists (threads beyond the number of cores
+ * share them); an allocation that finds no buffer in the lists of its
+ * thread takes one from the lists of the other threads, so that buffers
+ * freed by a thread can be reused by another one.
+ *
+ * The pool must outlive the matrices it allocated.
+ */
+class PLAYGROUND_API FramePool : public cv::MatAllocator
+{
+public:
+    explicit FramePool(const FramePoolOptions& options = FramePoolOptions());
+    FramePool(const FramePool&) = delete;
+    ~FramePool();
+
+    static FramePool& install(const FramePoolOptions& options = FramePoolOptions());
+
+    const FramePoolOptions& options() const;
+    FramePoolStatistics statistics() const;
+
+    void trim();
+
+    static size_t size_class(size_t size);
+
+    cv::UMatData* allocate(int dims,
+                           const int* sizes,
+                           int type,
+                           void* data,
+                           size_t* step,
+                           cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data,
+                  cv::AccessFlag accessflags,
+                  cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+    FramePool& operator=(const FramePool&) = delete;
+
+private:
+    struct FreeLists;
+
+    void* acquire(size_t size) const;
+    void release(void* buffer, size_t size) const;
+    FreeLists& local_free_lists() const;
+
+private:
+    FramePoolOptions m_options;
+    std::vector<std::unique_ptr<FreeLists>> m_free_lists;
+    mutable std::atomic<size_t> m_nb_hits;
+    mutable std::atomic<size_t> m_nb_misses;
+    mutable std::atomic<size_t> m_nb_released;
+    mutable std::atomic<size_t> m_allocated_bytes; // in use + cached
+    mutable std::atomic<size_t> m_cached_bytes;
+    mutable std::atomic<size_t> m_peak_bytes;
+};
+
+} // namespace ocvp
+
+#endif // FRAMEPOOL_H
@@ -10,12 +10,51 @@
 #include <opencv2/core/mat.hpp>
 
 #include <string>
+#include <vector>
 
 namespace ocvp
 {
 
+/**
+ * @brief decoding options of load_image()
+ */
+struct LoadOptions
+{
+    int reduction = 1;               ///< 1, 2, 4 or 8: the image is decoded at 1/reduction scale
+    bool grayscale = false;          ///< decodes a single channel
+    bool ignore_orientation = false; ///< ignores the EXIF orientation tag
+};
+
 PLAYGROUND_API cv::Mat load_image(const std::string& filepath);
+PLAYGROUND_API cv::Mat load_image(const std::string& filepath,
+                                  const LoadOptions& options,
+                                  double* scale = nullptr);
+PLAYGROUND_API cv::Mat decode_image(const std::vector<uchar>& bytes,
+                                    const LoadOptions& options = LoadOptions(),
+                                    double* scale = nullptr);
+
+/**
+ * @brief encoding options of save_image() and encode_image()
+ *
+ * The defaults are those of OpenCV, options that do not apply to the
+ * format of the image are ignored.
+ */
+struct EncodeOptions
+{
+    int jpeg_quality = 95;         ///< 0 to 100
+    bool jpeg_progressive = false;
+    bool jpeg_optimize = false;    ///< optimizes the Huffman tables (smaller, slower)
+    int png_compression = 1;       ///< 0 (none) to 9 (smallest, slowest)
+};
+
 PLAYGROUND_API bool save_image(const cv::Mat& image, const std::string& filepath);
+PLAYGROUND_API bool save_image(const cv::Mat& image,
+                               const std::string& filepath,
+                               const EncodeOptions& options);
+
+PLAYGROUND_API std::vector<uchar> encode_image(const cv::Mat& image,
+                                               const std::string& format,
+                                               const EncodeOptions& options = EncodeOptions());
 
 } // namespace ocvp
 
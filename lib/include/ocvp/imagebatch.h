@@ -0,0 +1,91 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef IMAGEBATCH_H
+#define IMAGEBATCH_H
+
+#include "image.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief an image listed in a directory or in a line of a manifest
+ */
+struct ImageBatchInput
+{
+    std::string path;
+    std::vector<std::string> arguments; ///< the other words of the manifest line
+    size_t line_number = 0;             ///< 0 if the image was found in a directory
+};
+
+/**
+ * @brief an image to process and the path of the result
+ */
+struct ImageBatchItem
+{
+    std::string input_path;
+    std::string output_path;
+};
+
+struct ImageBatchOptions
+{
+    size_t nb_threads = 0;                         ///< decoding and drawing, 0 for one per core
+    size_t nb_encode_threads = 0;                  ///< encoding and writing, 0 for one per core
+    size_t max_decoded_bytes = 1024 * 1024 * 1024; ///< bound of the decoded pixels in flight
+    LoadOptions load_options;
+    EncodeOptions encode_options;
+};
+
+/**
+ * @brief statistics of process_image_batch()
+ *
+ * Decoding and drawing times are summed over the threads; the write latency
+ * is summed over the images and includes the time spent in the queue of
+ * the encoding threads.
+ */
+struct ImageBatchStatistics
+{
+    size_t nb_written = 0;
+    size_t nb_failed = 0;
+    uint64_t bytes_read = 0;        ///< size of the input files
+    uint64_t bytes_written = 0;     ///< size of the output files
+    double elapsed_ms = 0;
+    double read_ms = 0;
+    double decode_ms = 0;
+    double draw_ms = 0;
+    double write_latency_ms = 0;
+    double blocked_ms = 0;          ///< time the reader waited for decoded images to be released
+    size_t peak_decoded_bytes = 0;  ///< sampled each time an image is decoded
+    std::vector<std::string> errors;
+};
+
+/**
+ * @brief draws onto an image of a batch
+ *
+ * The function receives the index of the item, the decoded image (which it
+ * may replace) and the scale of the image with respect to the file (see
+ * LoadOptions::reduction). It is called concurrently from several threads.
+ */
+using ImageBatchDrawFunction = std::function<void(size_t, cv::Mat&, double)>;
+
+PLAYGROUND_API std::vector<ImageBatchInput> read_image_batch_inputs(const std::string& path);
+
+PLAYGROUND_API std::vector<ImageBatchItem> make_image_batch(
+  const std::vector<ImageBatchInput>& inputs,
+  const std::string& output_dir);
+
+PLAYGROUND_API ImageBatchStatistics
+process_image_batch(const std::vector<ImageBatchItem>& items,
+                    const ImageBatchDrawFunction& draw,
+                    const ImageBatchOptions& options = ImageBatchOptions());
+
+} // namespace ocvp
+
+#endif // IMAGEBATCH_H
@@ -0,0 +1,88 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include "image.h"
+#include "workerpool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ocvp
+{
+
+struct AsyncImageWriterOptions
+{
+    size_t nb_threads = 0;                       ///< 0 for one thread per core
+    size_t max_queue_size = 16;                  ///< maximum number of images not written yet
+    size_t max_queued_bytes = 512 * 1024 * 1024; ///< maximum size of the pixels of those images
+};
+
+/**
+ * @brief statistics of an AsyncImageWriter
+ *
+ * The latency of an image is the time between the call to write() and the
+ * end of the writing of the file.
+ */
+struct AsyncImageWriterStatistics
+{
+    size_t nb_written = 0;
+    size_t nb_failed = 0;
+    uint64_t bytes_written = 0;  ///< size of the encoded files
+    double total_latency_ms = 0;
+    double max_latency_ms = 0;
+    double total_blocked_ms = 0; ///< time spent by write() waiting for room in the queue
+    std::string last_error;
+};
+
+/**
+ * @brief encodes and writes images on background threads
+ *
+ * write() returns as soon as the image is queued; it only blocks if the
+ * queue is full, either in number of images or in bytes of pixels.
+ * The destructor waits for the queued images to be written.
+ */
+class PLAYGROUND_API AsyncImageWriter
+{
+public:
+    explicit AsyncImageWriter(const AsyncImageWriterOptions& options = AsyncImageWriterOptions());
+    AsyncImageWriter(const AsyncImageWriter&) = delete;
+    ~AsyncImageWriter();
+
+    const AsyncImageWriterOptions& options() const;
+
+    void write(const cv::Mat& image,
+               const std::string& filepath,
+               const EncodeOptions& options = EncodeOptions());
+
+    void wait();
+
+    size_t queue_size() const;
+    size_t queued_bytes() const;
+    AsyncImageWriterStatistics statistics() const;
+
+    AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+private:
+    void process(const cv::Mat& image,
+                 const std::string& filepath,
+                 const EncodeOptions& options,
+                 std::chrono::steady_clock::time_point queued_at);
+
+private:
+    AsyncImageWriterOptions m_options;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    size_t m_queue_size = 0;
+    size_t m_queued_bytes = 0;
+    AsyncImageWriterStatistics m_statistics;
+    WorkerPool m_pool; // last, so that it is destroyed (and joined) first
+};
+
+} // namespace ocvp
+
+#endif // IMAGEWRITER_H
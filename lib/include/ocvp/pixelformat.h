@@ -0,0 +1,55 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+
+#include "defs.h"
+
+#include <opencv2/core/mat.hpp>
+
+namespace ocvp
+{
+
+/**
+ * @brief 8-bit pixel format conversions
+ *
+ * "RGB32" refers to the memory layout of QImage::Format_RGB32 on
+ * little-endian machines, i.e. the bytes B, G, R, 0xFF.
+ * "RGBA" is the byte order R, G, B, A.
+ */
+enum class PixelConversion
+{
+    BGR_TO_RGB32, ///< CV_8UC3 to CV_8UC4
+    RGB32_TO_BGR, ///< CV_8UC4 to CV_8UC3, alpha is dropped
+    BGR_TO_RGBA,  ///< CV_8UC3 to CV_8UC4
+    RGBA_TO_BGR,  ///< CV_8UC4 to CV_8UC3, alpha is dropped
+    BGR_TO_GRAY,  ///< CV_8UC3 to CV_8UC1, using ITU-R BT.601 luma weights
+    RGB_TO_BGR,   ///< CV_8UC3 to CV_8UC3, swaps the first and last channels
+};
+
+/**
+ * @brief instruction sets used by the conversion kernels
+ */
+enum class SimdLevel
+{
+    None,
+    SSE41,
+    AVX2,
+};
+
+PLAYGROUND_API SimdLevel best_simd_level();
+
+PLAYGROUND_API void convert_pixels(const cv::Mat& src,
+                                   cv::Mat& dst,
+                                   PixelConversion conversion,
+                                   SimdLevel max_level = SimdLevel::AVX2);
+
+PLAYGROUND_API void convert_pixels_reference(const cv::Mat& src,
+                                             cv::Mat& dst,
+                                             PixelConversion conversion);
+
+} // namespace ocvp
+
+#endif // PIXELFORMAT_H
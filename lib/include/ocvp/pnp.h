@@ -6,14 +6,20 @@
 #define PNP_H
 
 #include "camera.h"
+#include "pixelformat.h"
+#include "target.h"
+
+#include <cstdint>
+#include <vector>
 
 namespace ocvp
 {
 
 /**
- * @brief stores the 2D coordinates on a picture of a A4 sheet of paper
+ * @brief stores the 2D coordinates on a picture of the corners of a
+ * rectangular target (see PlanarTarget)
  */
-struct A4SheetOfPaper
+struct TargetCorners
 {
     cv::Point bottom_left;
     cv::Point bottom_right;
@@ -21,6 +27,11 @@ struct A4SheetOfPaper
     cv::Point top_left;
 };
 
+/**
+ * @brief stores the 2D coordinates on a picture of a A4 sheet of paper
+ */
+using A4SheetOfPaper = TargetCorners;
+
 /**
  * @brief stores the result of Perspective-n-Point (PnP) pose computation problem
  */
@@ -33,6 +44,14 @@ struct PnPResult
 PLAYGROUND_API PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
                                    const CameraIntrinsics& intrinsics,
                                    const DistortionCoefficients& distortion);
+PLAYGROUND_API PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
+                                   const CameraIntrinsics& intrinsics,
+                                   const DistortionCoefficients& distortion,
+                                   const PnPResult& initial_guess);
+PLAYGROUND_API PnPResult solve_pnp(const TargetCorners& corners,
+                                   const PlanarTarget& target,
+                                   const CameraIntrinsics& intrinsics,
+                                   const DistortionCoefficients& distortion);
 
 PLAYGROUND_API void save_pnp_result(const std::string& filepath, const PnPResult& result);
 PLAYGROUND_API PnPResult load_pnp_result(const std::string& filepath);
@@ -41,6 +60,108 @@ PLAYGROUND_API cv::Mat get_rotation_matrix(const cv::Mat& rvec);
 
 PLAYGROUND_API cv::Mat compute_camera_position(const cv::Mat& rvec, const cv::Mat& tvec);
 
+/**
+ * @brief fixed-size counterpart of PnPResult
+ */
+struct Pose
+{
+    cv::Vec3d rvec;
+    cv::Vec3d tvec;
+};
+
+PLAYGROUND_API Pose to_pose(const PnPResult& result);
+PLAYGROUND_API PnPResult to_pnp_result(const Pose& pose);
+
+PLAYGROUND_API bool solve_pnp(const A4SheetOfPaper& a4sheet,
+                              const CameraModel& camera,
+                              Pose& pose);
+
+PLAYGROUND_API bool solve_pnp(const TargetCorners& corners,
+                              const PlanarTarget& target,
+                              const CameraModel& camera,
+                              Pose& pose);
+
+PLAYGROUND_API bool solve_pnp_a4(const A4SheetOfPaper& a4sheet,
+                                 const CameraModel& camera,
+                                 Pose& pose,
+                                 int refinement_steps = 1);
+PLAYGROUND_API bool solve_pnp_planar(const TargetCorners& corners,
+                                     const PlanarTarget& target,
+                                     const CameraModel& camera,
+                                     Pose& pose,
+                                     int refinement_steps = 1);
+
+/**
+ * @brief outcome of one of the problems solved by solve_pnp_many()
+ */
+enum class PnPStatus
+{
+    Solved,
+    DegenerateCorners, ///< the corners are not those of a convex quadrilateral
+    Failed,            ///< the solver did not find a pose
+};
+
+struct PnPTargetResult
+{
+    PnPStatus status = PnPStatus::Failed;
+    Pose pose;                     ///< only meaningful if the problem was solved
+    double reprojection_error = 0; ///< RMS distance (in pixels) to the projected corners
+};
+
+PLAYGROUND_API std::vector<PnPTargetResult> solve_pnp_many(
+  const std::vector<A4SheetOfPaper>& sheets,
+  const CameraModel& camera);
+PLAYGROUND_API std::vector<PnPTargetResult> solve_pnp_many(
+  const std::vector<TargetCorners>& targets,
+  const PlanarTarget& target,
+  const CameraModel& camera);
+PLAYGROUND_API std::vector<PnPTargetResult> solve_pnp_many(
+  const std::vector<A4SheetOfPaper>& sheets,
+  const CameraIntrinsics& intrinsics,
+  const DistortionCoefficients& distortion);
+
+PLAYGROUND_API const char* to_string(PnPStatus status);
+
+struct PnPRansacOptions
+{
+    double reprojection_threshold = 4.0; ///< distance (in pixels) below which a point is an inlier
+    double confidence = 0.999;  ///< probability that a sample free of outliers is drawn
+    int max_iterations = 10000; ///< maximum number of hypotheses
+    uint64_t seed = 0;          ///< the result only depends on the seed and the input
+    int refinement_iterations = 10; ///< Gauss-Newton iterations on the inliers
+    SimdLevel max_level = SimdLevel::AVX2;
+};
+
+/**
+ * @brief result of solve_pnp_ransac()
+ */
+struct PnPRansacResult
+{
+    bool solved = false;
+    Pose pose;
+    std::vector<uchar> inlier_mask; ///< 1 for the inliers, 0 for the outliers
+    size_t nb_inliers = 0;
+    int nb_iterations = 0;          ///< number of hypotheses that were scored
+    double reprojection_error = 0;  ///< RMS distance (in pixels) to the projected inliers
+    double elapsed_ms = 0;
+};
+
+PLAYGROUND_API PnPRansacResult solve_pnp_ransac(
+  const std::vector<cv::Point2d>& object_points,
+  const std::vector<cv::Point2d>& image_points,
+  const CameraModel& camera,
+  const PnPRansacOptions& options = PnPRansacOptions());
+
+PLAYGROUND_API cv::Matx33d get_rotation_matrix(const cv::Vec3d& rvec);
+PLAYGROUND_API cv::Vec3d get_rotation_vector(const cv::Matx33d& rotation);
+
+PLAYGROUND_API cv::Vec3d compute_camera_position(const Pose& pose);
+
+PLAYGROUND_API cv::Point2d project_point(const CameraModel& camera,
+                                         const cv::Matx33d& rotation,
+                                         const cv::Vec3d& tvec,
+                                         const cv::Vec3d& object_point);
+
 } // namespace ocvp
 
 #endif // PNP_H
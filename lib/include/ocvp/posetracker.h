@@ -0,0 +1,85 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef POSETRACKER_H
+#define POSETRACKER_H
+
+#include "pnp.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief parameters of a PoseTracker
+ */
+struct PoseTrackerOptions
+{
+    int max_iterations = 5;              ///< Levenberg-Marquardt iterations of a warm solve
+    double max_reprojection_error = 2.0; ///< in pixels (RMS), see PoseTracker::track()
+    double max_error_increase = 3.0;     ///< ratio to the error of the previous frame
+    PlanarTarget target = A4Target();    ///< size of the tracked target
+};
+
+/**
+ * @brief counts the solves performed by a PoseTracker
+ */
+struct PoseTrackerStatistics
+{
+    size_t frames = 0;      ///< number of calls to PoseTracker::track()
+    size_t warm_starts = 0; ///< frames solved from the previous pose
+    size_t cold_starts = 0; ///< frames solved from scratch, including fallbacks
+    size_t fallbacks = 0;   ///< warm solves rejected because of their reprojection error
+};
+
+/**
+ * @brief solves the pose of a sheet of paper in consecutive frames
+ *
+ * Each frame is solved starting from the pose found in the previous one,
+ * with a capped number of iterations; a cold solve is performed for the
+ * first frame and whenever the warm solve loses track of the sheet.
+ */
+class PLAYGROUND_API PoseTracker
+{
+public:
+    PoseTracker(const CameraIntrinsics& intrinsics,
+                const DistortionCoefficients& distortion,
+                const PoseTrackerOptions& options = PoseTrackerOptions());
+
+    const PoseTrackerOptions& options() const;
+
+    PnPResult track(const TargetCorners& corners);
+    void reset();
+
+    bool has_pose() const;
+    const PnPResult& pose() const;
+    double reprojection_error() const;
+    bool last_solve_was_warm() const;
+
+    const PoseTrackerStatistics& statistics() const;
+    double warm_start_ratio() const;
+
+private:
+    double compute_reprojection_error(const PnPResult& pose);
+    PnPResult solve_cold();
+    PnPResult solve_warm();
+
+private:
+    PoseTrackerOptions m_options;
+    cv::Mat m_camera_matrix;
+    std::vector<double> m_dist_coeffs;
+    std::vector<cv::Point3d> m_object_points;
+    std::vector<cv::Point2d> m_image_points;
+    std::vector<cv::Point2d> m_projected_points;
+    PnPResult m_pose;
+    double m_reprojection_error = 0;
+    bool m_last_solve_was_warm = false;
+    PoseTrackerStatistics m_statistics;
+};
+
+} // namespace ocvp
+
+#endif // POSETRACKER_H
@@ -0,0 +1,74 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "pnp.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief binary protocol of the ocvpd solve service
+ *
+ * Every message is sent as a frame: a 32-bit payload size followed by the
+ * payload, whose first byte is the MessageType.
+ * Integers and doubles are little-endian; strings and byte arrays are
+ * prefixed by their 32-bit size.
+ */
+namespace protocol
+{
+
+constexpr uint32_t max_frame_size = 64 * 1024 * 1024;
+
+enum class MessageType : uint8_t
+{
+    SolveRequest = 1,
+    SolveResponse = 2,
+};
+
+/**
+ * @brief asks for the pose of a sheet of paper seen by a registered camera
+ *
+ * If @a image is not empty, it is an encoded image (e.g. a JPEG file) on
+ * which the frame axes are drawn; the annotated image is sent back encoded
+ * in the format given by @a image_format (an extension such as ".jpg").
+ */
+struct SolveRequest
+{
+    uint32_t id = 0;
+    std::string camera_id;
+    A4SheetOfPaper corners;
+    std::vector<uint8_t> image;
+    std::string image_format;
+};
+
+struct SolveResponse
+{
+    uint32_t id = 0;
+    bool ok = false;
+    std::string error;
+    cv::Vec3d rvec;
+    cv::Vec3d tvec;
+    uint64_t latency_us = 0; ///< time spent by the service on the request, in microseconds
+    std::vector<uint8_t> image;
+};
+
+PLAYGROUND_API std::vector<uint8_t> encode(const SolveRequest& request);
+PLAYGROUND_API std::vector<uint8_t> encode(const SolveResponse& response);
+
+PLAYGROUND_API MessageType message_type(const std::vector<uint8_t>& payload);
+PLAYGROUND_API SolveRequest decode_request(const std::vector<uint8_t>& payload);
+PLAYGROUND_API SolveResponse decode_response(const std::vector<uint8_t>& payload);
+
+} // namespace protocol
+
+} // namespace ocvp
+
+#endif // PROTOCOL_H
@@ -0,0 +1,131 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief a bounded, lock-free, single-producer single-consumer queue
+ *
+ * One thread may push while another one pops; the queue is a ring buffer
+ * whose head and tail are atomic indices, so neither thread ever locks.
+ * Because its capacity is fixed, the queue also bounds the memory held by
+ * a pipeline stage that is ahead of the next one.
+ *
+ * push() and pop() wait (spinning, then sleeping) when the queue is
+ * full or empty.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_slots(capacity + 1)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+
+    size_t capacity() const
+    {
+        return m_slots.size() - 1;
+    }
+
+    /**
+     * @brief pushes a value if the queue is not full
+     * @return whether the value was pushed; if not, @a value is left untouched
+     */
+    bool try_push(T&& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t next = increment(tail);
+
+        if (next == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        m_slots[tail] = std::move(value);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief pops a value if the queue is not empty
+     */
+    bool try_pop(T& value)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        value = std::move(m_slots[head]);
+        m_slots[head] = T(); // releases the resources of the slot right away
+        m_head.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    void push(T value)
+    {
+        for (int attempt(0); !try_push(std::move(value)); ++attempt)
+        {
+            backoff(attempt);
+        }
+    }
+
+    T pop()
+    {
+        T value;
+
+        for (int attempt(0); !try_pop(value); ++attempt)
+        {
+            backoff(attempt);
+        }
+
+        return value;
+    }
+
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+private:
+    size_t increment(size_t index) const
+    {
+        return index + 1 == m_slots.size() ? 0 : index + 1;
+    }
+
+    static void backoff(int attempt)
+    {
+        if (attempt < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+private:
+    std::vector<T> m_slots;
+    std::atomic<size_t> m_head{ 0 };
+    char m_padding[64]; // keeps the indices on different cache lines
+    std::atomic<size_t> m_tail{ 0 };
+};
+
+} // namespace ocvp
+
+#endif // SPSCQUEUE_H
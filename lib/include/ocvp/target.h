@@ -0,0 +1,74 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef TARGET_H
+#define TARGET_H
+
+#include "defs.h"
+
+#include <string>
+
+namespace ocvp
+{
+
+/**
+ * @brief size of a rectangular planar target, e.g. a sheet of paper
+ *
+ * The origin of the world frame is the bottom-left corner of the target,
+ * the x axis goes along its width and the y axis along its height.
+ */
+struct PlanarTarget
+{
+    double width = 0;  ///< in meters
+    double height = 0; ///< in meters
+};
+
+/**
+ * @brief a rectangular planar target whose size is known at compile time
+ * @tparam Width   width in micrometers
+ * @tparam Height  height in micrometers
+ *
+ * The solver and the drawing functions take a PlanarTarget, to which this
+ * type converts; for the standard sizes below, they use code specialized
+ * for the size, in which the geometry of the target is constant.
+ */
+template<int Width, int Height>
+struct FixedPlanarTarget
+{
+    static constexpr double width = Width / 1e6;
+    static constexpr double height = Height / 1e6;
+
+    constexpr operator PlanarTarget() const
+    {
+        return PlanarTarget{ width, height };
+    }
+};
+
+template<int Width, int Height>
+constexpr double FixedPlanarTarget<Width, Height>::width;
+template<int Width, int Height>
+constexpr double FixedPlanarTarget<Width, Height>::height;
+
+using A4Target = FixedPlanarTarget<210000, 297000>;
+using A3Target = FixedPlanarTarget<297000, 420000>;
+using LetterTarget = FixedPlanarTarget<215900, 279400>;
+
+inline bool operator==(const PlanarTarget& lhs, const PlanarTarget& rhs)
+{
+    return lhs.width == rhs.width && lhs.height == rhs.height;
+}
+
+inline bool operator!=(const PlanarTarget& lhs, const PlanarTarget& rhs)
+{
+    return !(lhs == rhs);
+}
+
+PLAYGROUND_API bool find_standard_target(const std::string& name, PlanarTarget& target);
+
+PLAYGROUND_API void save_planar_target(const std::string& filepath, const PlanarTarget& target);
+PLAYGROUND_API PlanarTarget load_planar_target(const std::string& filepath);
+
+} // namespace ocvp
+
+#endif // TARGET_H
@@ -0,0 +1,156 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef UNDISTORT_H
+#define UNDISTORT_H
+
+#include "camera.h"
+#include "pixelformat.h"
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief storage format of the maps used by cv::remap()
+ */
+enum class UndistortMapFormat
+{
+    Float,      ///< two CV_32FC1 maps, 8 bytes per pixel
+    FixedPoint, ///< CV_16SC2 + CV_16UC1 maps (see cv::convertMaps()), 6 bytes per pixel
+};
+
+/**
+ * @brief a pair of maps for cv::remap()
+ */
+struct UndistortMaps
+{
+    cv::Mat map1;
+    cv::Mat map2;
+    std::shared_ptr<const void> storage; ///< keeps the memory-mapped file (if any) alive
+};
+
+PLAYGROUND_API uint64_t undistort_map_key(const CameraIntrinsics& intrinsics,
+                                          const DistortionCoefficients& distortion,
+                                          const cv::Size& image_size);
+
+PLAYGROUND_API UndistortMaps compute_undistort_maps(const CameraIntrinsics& intrinsics,
+                                                    const DistortionCoefficients& distortion,
+                                                    const cv::Size& image_size,
+                                                    UndistortMapFormat format);
+
+/**
+ * @brief caches undistortion maps, in memory and optionally on disk
+ *
+ * This class is thread-safe.
+ */
+class PLAYGROUND_API UndistortMapCache
+{
+public:
+    explicit UndistortMapCache(const std::string& directory = std::string(),
+                               UndistortMapFormat format = UndistortMapFormat::FixedPoint);
+    UndistortMapCache(const UndistortMapCache&) = delete;
+
+    const std::string& directory() const;
+    UndistortMapFormat format() const;
+
+    UndistortMaps get(const CameraIntrinsics& intrinsics,
+                      const DistortionCoefficients& distortion,
+                      const cv::Size& image_size);
+
+    void undistort(const cv::Mat& image,
+                   cv::Mat& output,
+                   const CameraIntrinsics& intrinsics,
+                   const DistortionCoefficients& distortion);
+
+    std::string file_path(uint64_t key) const;
+
+    size_t size() const;
+    void clear();
+
+    UndistortMapCache& operator=(const UndistortMapCache&) = delete;
+
+private:
+    struct Entry
+    {
+        CameraIntrinsics intrinsics;
+        DistortionCoefficients distortion;
+        cv::Size image_size;
+        UndistortMaps maps;
+    };
+
+    bool load(const std::string& path, Entry& entry) const;
+    void save(const std::string& path, const Entry& entry) const;
+
+private:
+    std::string m_directory;
+    UndistortMapFormat m_format;
+    mutable std::mutex m_mutex;
+    std::map<uint64_t, Entry> m_entries;
+    std::map<uint64_t, std::shared_future<void>> m_in_flight;
+};
+
+/**
+ * @brief precomputed inverse of the distortion model, see undistort_points_batch()
+ *
+ * The undistorted (normalized) coordinates are tabulated on a regular grid
+ * of pixels and interpolated bilinearly in between; the grid is made fine
+ * enough for the interpolation error to stay below a given bound.
+ */
+class PLAYGROUND_API UndistortLut
+{
+public:
+    UndistortLut(const CameraIntrinsics& intrinsics,
+                 const DistortionCoefficients& distortion,
+                 const cv::Size& image_size,
+                 double max_error = 0.01);
+
+    const cv::Size& image_size() const;
+    int step() const;
+    int cols() const;
+    int rows() const;
+    double max_error() const;
+
+    const float* x_table() const;
+    const float* y_table() const;
+
+private:
+    void build(const CameraModel& camera, int step);
+    double measure_error(const CameraModel& camera) const;
+
+private:
+    cv::Size m_image_size;
+    int m_step = 0;
+    int m_cols = 0;
+    int m_rows = 0;
+    double m_max_error = 0;
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+};
+
+PLAYGROUND_API void undistort_points_batch(const UndistortLut& lut,
+                                           const float* x,
+                                           const float* y,
+                                           float* undistorted_x,
+                                           float* undistorted_y,
+                                           size_t count,
+                                           SimdLevel max_level = SimdLevel::AVX2);
+
+PLAYGROUND_API void undistort_points_batch(const UndistortLut& lut,
+                                           const std::vector<float>& x,
+                                           const std::vector<float>& y,
+                                           std::vector<float>& undistorted_x,
+                                           std::vector<float>& undistorted_y,
+                                           SimdLevel max_level = SimdLevel::AVX2);
+
+} // namespace ocvp
+
+#endif // UNDISTORT_H
@@ -0,0 +1,68 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include "defs.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief a fixed-size pool of threads executing tasks in FIFO order
+ *
+ * The threads are started by the constructor and joined by the destructor,
+ * after all pending tasks have been executed.
+ */
+class PLAYGROUND_API WorkerPool
+{
+public:
+    explicit WorkerPool(size_t nb_threads = 0);
+    WorkerPool(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    size_t size() const;
+
+    /**
+     * @brief schedules a task for execution
+     * @param f  a callable taking no arguments
+     * @return a future holding the result (or the exception) of the task
+     */
+    template<typename F>
+    auto submit(F&& f) -> std::future<decltype(f())>
+    {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        post([task]() { (*task)(); });
+        return result;
+    }
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+private:
+    void post(std::function<void()> task);
+    void run();
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stopping = false;
+};
+
+} // namespace ocvp
+
+#endif // WORKERPOOL_H
@@ -0,0 +1,485 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "calibration.h"
+
+#include "mappedfile.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace ocvp
+{
+
+namespace
+{
+
+/**
+ * Layout of a binary calibration file (little-endian).
+ * The checksum is the FNV-1a hash of all the preceding bytes.
+ */
+struct CalibrationFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    int32_t width;
+    int32_t height;
+    double intrinsics[4]; // cx, cy, fx, fy
+    double distortion[8]; // k1, k2, p1, p2, k3, k4, k5, k6
+    uint64_t checksum;
+};
+
+static_assert(sizeof(CalibrationFileHeader) == 128, "unexpected padding in CalibrationFileHeader");
+
+constexpr char calibration_file_magic[8] = { 'O', 'C', 'V', 'P', 'C', 'A', 'L', 'B' };
+constexpr uint32_t calibration_file_version = 1;
+
+uint64_t compute_checksum(const CalibrationFileHeader& header)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&header);
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i(0); i < offsetof(CalibrationFileHeader, checksum); ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+CalibrationFileHeader make_header(const CameraCalibration& calibration)
+{
+    CalibrationFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, calibration_file_magic, sizeof(header.magic));
+    header.version = calibration_file_version;
+    header.header_size = sizeof(CalibrationFileHeader);
+    header.width = calibration.image_size.width;
+    header.height = calibration.image_size.height;
+
+    header.intrinsics[0] = calibration.intrinsics.cx;
+    header.intrinsics[1] = calibration.intrinsics.cy;
+    header.intrinsics[2] = calibration.intrinsics.fx;
+    header.intrinsics[3] = calibration.intrinsics.fy;
+
+    std::vector<double> coeffs = make_distcoeffs_vector(calibration.distortion);
+    std::copy(coeffs.begin(), coeffs.end(), header.distortion);
+
+    header.checksum = compute_checksum(header);
+    return header;
+}
+
+CameraCalibration read_header(const CalibrationFileHeader& header)
+{
+    CameraCalibration calibration;
+    calibration.image_size = cv::Size(header.width, header.height);
+
+    calibration.intrinsics.cx = header.intrinsics[0];
+    calibration.intrinsics.cy = header.intrinsics[1];
+    calibration.intrinsics.fx = header.intrinsics[2];
+    calibration.intrinsics.fy = header.intrinsics[3];
+
+    calibration.distortion.k1 = header.distortion[0];
+    calibration.distortion.k2 = header.distortion[1];
+    calibration.distortion.p1 = header.distortion[2];
+    calibration.distortion.p2 = header.distortion[3];
+    calibration.distortion.k3 = header.distortion[4];
+    calibration.distortion.k4 = header.distortion[5];
+    calibration.distortion.k5 = header.distortion[6];
+    calibration.distortion.k6 = header.distortion[7];
+
+    return calibration;
+}
+
+// Reads every known key of a JSON object; missing ones are left to zero.
+CameraCalibration read_node(const cv::FileNode& fs)
+{
+    CameraCalibration calibration;
+    fs["cx"] >> calibration.intrinsics.cx;
+    fs["cy"] >> calibration.intrinsics.cy;
+    fs["fx"] >> calibration.intrinsics.fx;
+    fs["fy"] >> calibration.intrinsics.fy;
+    fs["k1"] >> calibration.distortion.k1;
+    fs["k2"] >> calibration.distortion.k2;
+    fs["k3"] >> calibration.distortion.k3;
+    fs["k4"] >> calibration.distortion.k4;
+    fs["k5"] >> calibration.distortion.k5;
+    fs["k6"] >> calibration.distortion.k6;
+    fs["p1"] >> calibration.distortion.p1;
+    fs["p2"] >> calibration.distortion.p2;
+    fs["width"] >> calibration.image_size.width;
+    fs["height"] >> calibration.image_size.height;
+
+    return calibration;
+}
+
+void write_node(cv::FileStorage& fs, const CameraCalibration& calibration)
+{
+    fs << "cx" << calibration.intrinsics.cx;
+    fs << "cy" << calibration.intrinsics.cy;
+    fs << "fx" << calibration.intrinsics.fx;
+    fs << "fy" << calibration.intrinsics.fy;
+
+    if (!calibration.image_size.empty())
+    {
+        fs << "width" << calibration.image_size.width;
+        fs << "height" << calibration.image_size.height;
+    }
+}
+
+CameraCalibration read_json(const std::string& filepath)
+{
+    cv::FileStorage fs{ filepath, cv::FileStorage::READ };
+
+    if (!fs.isOpened())
+    {
+        throw std::runtime_error("Could not open " + filepath);
+    }
+
+    return read_node(fs.root());
+}
+
+} // namespace
+
+/**
+ * @brief returns whether a file is a binary calibration file
+ * @param filepath  path of the file
+ *
+ * Only the first bytes of the file are checked.
+ */
+bool is_binary_calibration(const std::string& filepath)
+{
+    std::ifstream file{ filepath, std::ios::binary };
+    char magic[sizeof(calibration_file_magic)];
+    file.read(magic, sizeof(magic));
+    return file && std::memcmp(magic, calibration_file_magic, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief writes a calibration to a binary file
+ * @param filepath     path of the file
+ * @param calibration  the calibration
+ * @throw std::runtime_error if the file cannot be written
+ *
+ * The file has a fixed size of 128 bytes and is replaced atomically, so
+ * that processes reading it concurrently see either the old or the new
+ * calibration.
+ */
+void save_calibration(const std::string& filepath, const CameraCalibration& calibration)
+{
+    const CalibrationFileHeader header = make_header(calibration);
+
+    if (!write_file_atomically(filepath, { { &header, sizeof(header) } }))
+    {
+        throw std::runtime_error("Could not write " + filepath);
+    }
+}
+
+/**
+ * @brief reads a binary calibration file
+ * @param filepath  path of the file
+ * @throw std::runtime_error if the file cannot be read, has an unsupported
+ * version or is corrupted
+ *
+ * The file is mapped in memory and read in a single pass.
+ */
+CameraCalibration load_calibration(const std::string& filepath)
+{
+    MappedFile file{ filepath };
+    CalibrationFileHeader header;
+
+    if (file.size() < sizeof(header))
+    {
+        throw std::runtime_error("Invalid calibration file " + filepath);
+    }
+
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, calibration_file_magic, sizeof(header.magic)) != 0
+        || header.header_size < sizeof(header) || header.header_size > file.size())
+    {
+        throw std::runtime_error("Invalid calibration file " + filepath);
+    }
+
+    if (header.version != calibration_file_version)
+    {
+        throw std::runtime_error("Unsupported calibration file version in " + filepath);
+    }
+
+    if (header.checksum != compute_checksum(header))
+    {
+        throw std::runtime_error("Corrupted calibration file " + filepath);
+    }
+
+    return read_header(header);
+}
+
+/**
+ * @brief reads a calibration stored in the JSON files of the apps
+ * @param camera_json_path      file written by save_camera_intrinsics()
+ * @param distortion_json_path  file written by save_distortion_coeffs()
+ *
+ * The image size is read from the "width" and "height" keys of the camera
+ * file, which are written by export_calibration_json().
+ */
+CameraCalibration import_calibration_json(const std::string& camera_json_path,
+                                          const std::string& distortion_json_path)
+{
+    CameraCalibration calibration = read_json(camera_json_path);
+    calibration.distortion = read_json(distortion_json_path).distortion;
+    return calibration;
+}
+
+/**
+ * @brief writes a calibration in the JSON files of the apps
+ * @param calibration           the calibration
+ * @param camera_json_path      path of the camera intrinsics file
+ * @param distortion_json_path  path of the distortion coefficients file
+ *
+ * Doubles are written with enough digits to be read back exactly; the
+ * image size is added to the camera file if it is known.
+ */
+void export_calibration_json(const CameraCalibration& calibration,
+                             const std::string& camera_json_path,
+                             const std::string& distortion_json_path)
+{
+    {
+        cv::FileStorage fs{ camera_json_path, cv::FileStorage::WRITE };
+        write_node(fs, calibration);
+    }
+
+    save_distortion_coeffs(distortion_json_path, calibration.distortion);
+}
+
+/**
+ * @brief returns the cache shared by the whole process
+ */
+CalibrationCache& CalibrationCache::global()
+{
+    static CalibrationCache cache;
+    return cache;
+}
+
+/**
+ * @brief returns the calibration stored in a file
+ * @param filepath  a binary calibration file, or a JSON file with intrinsics
+ *                  and/or distortion coefficients
+ * @throw std::runtime_error if the file cannot be read
+ *
+ * The modification time and the size of the file are checked on each call;
+ * the file is parsed again only if they changed.
+ */
+std::shared_ptr<const CameraCalibration> CalibrationCache::get(const std::string& filepath)
+{
+    FileStamp stamp;
+
+    if (!get_file_stamp(filepath, stamp))
+    {
+        throw std::runtime_error("Could not open " + filepath);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        auto it = m_entries.find(filepath);
+
+        if (it != m_entries.end() && it->second.mtime_ns == stamp.mtime_ns
+            && it->second.file_size == stamp.size)
+        {
+            return it->second.calibration;
+        }
+    }
+
+    // parsed without the lock, concurrent misses on the same file are harmless
+    Entry entry;
+    entry.mtime_ns = stamp.mtime_ns;
+    entry.file_size = stamp.size;
+    entry.calibration = std::make_shared<const CameraCalibration>(
+      is_binary_calibration(filepath) ? load_calibration(filepath) : read_json(filepath));
+
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_entries[filepath] = entry;
+    return entry.calibration;
+}
+
+/**
+ * @brief cached version of load_camera_intrinsics()
+ *
+ * This also accepts binary calibration files.
+ */
+CameraIntrinsics CalibrationCache::camera_intrinsics(const std::string& filepath)
+{
+    return get(filepath)->intrinsics;
+}
+
+/**
+ * @brief cached version of load_distortion_coeffs()
+ *
+ * This also accepts binary calibration files.
+ */
+DistortionCoefficients CalibrationCache::distortion_coeffs(const std::string& filepath)
+{
+    return get(filepath)->distortion;
+}
+
+size_t CalibrationCache::size() const
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_entries.size();
+}
+
+void CalibrationCache::clear()
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_entries.clear();
+}
+
+/**
+ * @brief constructs a registry
+ * @param cameras  pairs of camera id and calibration
+ * @throw std::runtime_error if an id is empty or appears twice
+ */
+CameraRegistry::CameraRegistry(std::vector<std::pair<std::string, CameraCalibration>> cameras)
+{
+    m_ids.reserve(cameras.size());
+    m_calibrations.reserve(cameras.size());
+    m_index.reserve(cameras.size());
+
+    for (auto& camera : cameras)
+    {
+        if (camera.first.empty())
+        {
+            throw std::runtime_error("CameraRegistry: empty camera id");
+        }
+
+        if (!m_index.emplace(camera.first, m_ids.size()).second)
+        {
+            throw std::runtime_error("CameraRegistry: duplicate camera id '" + camera.first + "'");
+        }
+
+        m_ids.push_back(std::move(camera.first));
+        m_calibrations.push_back(camera.second);
+    }
+}
+
+size_t CameraRegistry::size() const
+{
+    return m_ids.size();
+}
+
+bool CameraRegistry::empty() const
+{
+    return m_ids.empty();
+}
+
+/**
+ * @brief returns the ids of the cameras, in the order of the registry file
+ */
+const std::vector<std::string>& CameraRegistry::ids() const
+{
+    return m_ids;
+}
+
+/**
+ * @brief returns the calibration of a camera
+ * @param id  the camera id
+ * @return nullptr if there is no such camera
+ */
+const CameraCalibration* CameraRegistry::find(const std::string& id) const
+{
+    auto it = m_index.find(id);
+    return it != m_index.end() ? &m_calibrations[it->second] : nullptr;
+}
+
+/**
+ * @brief returns the calibration of a camera
+ * @param id  the camera id
+ * @throw std::runtime_error if there is no such camera
+ */
+const CameraCalibration& CameraRegistry::at(const std::string& id) const
+{
+    const CameraCalibration* calibration = find(id);
+
+    if (!calibration)
+    {
+        throw std::runtime_error("unknown camera id '" + id + "'");
+    }
+
+    return *calibration;
+}
+
+/**
+ * @brief writes a registry to a JSON file
+ *
+ * The file has a "cameras" array with one object per camera, holding its
+ * "id" and the keys of the camera.json and distortion.json files.
+ */
+void save_camera_registry(const std::string& filepath, const CameraRegistry& registry)
+{
+    cv::FileStorage fs{ filepath, cv::FileStorage::WRITE };
+    fs << "cameras" << "[";
+
+    for (const std::string& id : registry.ids())
+    {
+        const CameraCalibration& calibration = registry.at(id);
+
+        fs << "{";
+        fs << "id" << id;
+        write_node(fs, calibration);
+        fs << "k1" << calibration.distortion.k1;
+        fs << "k2" << calibration.distortion.k2;
+        fs << "k3" << calibration.distortion.k3;
+        fs << "k4" << calibration.distortion.k4;
+        fs << "k5" << calibration.distortion.k5;
+        fs << "k6" << calibration.distortion.k6;
+        fs << "p1" << calibration.distortion.p1;
+        fs << "p2" << calibration.distortion.p2;
+        fs << "}";
+    }
+
+    fs << "]";
+}
+
+/**
+ * @brief reads a registry written by save_camera_registry()
+ * @param filepath  path of the file
+ * @throw std::runtime_error if the file cannot be read or is malformed
+ */
+CameraRegistry load_camera_registry(const std::string& filepath)
+{
+    cv::FileStorage fs{ filepath, cv::FileStorage::READ };
+
+    if (!fs.isOpened())
+    {
+        throw std::runtime_error("Could not open " + filepath);
+    }
+
+    cv::FileNode cameras = fs["cameras"];
+
+    if (!cameras.isSeq())
+    {
+        throw std::runtime_error("Missing \"cameras\" array in " + filepath);
+    }
+
+    std::vector<std::pair<std::string, CameraCalibration>> entries;
+    entries.reserve(cameras.size());
+
+    for (int i(0); i < static_cast<int>(cameras.size()); ++i)
+    {
+        const cv::FileNode node = cameras[i];
+        std::string id;
+        node["id"] >> id;
+        entries.emplace_back(std::move(id), read_node(node));
+    }
+
+    return CameraRegistry(std::move(entries));
+}
+
+} // namespace ocvp
@@ -6,6 +6,7 @@
 
 #include <opencv2/core.hpp>
 
+#include <cmath>
 #include <stdexcept>
 
 namespace ocvp
@@ -107,4 +108,113 @@ std::vector<double> make_distcoeffs_vector(const DistortionCoefficients& coeffs)
     };
 }
 
+/**
+ * @brief fixed-size version of make_camera_matrix()
+ * @param intrinsics
+ */
+cv::Matx33d make_camera_matx(const CameraIntrinsics& intrinsics)
+{
+    return cv::Matx33d(
+      intrinsics.fx, 0, intrinsics.cx, 0, intrinsics.fy, intrinsics.cy, 0, 0, 1);
+}
+
+/**
+ * @brief fixed-size version of make_distcoeffs_vector()
+ * @param coeffs
+ * @return the vector [ k1, k2, p1, p2, k3, k4, k5, k6 ]
+ */
+cv::Vec<double, 8> make_distcoeffs_vec(const DistortionCoefficients& coeffs)
+{
+    return cv::Vec<double, 8>(
+      coeffs.k1, coeffs.k2, coeffs.p1, coeffs.p2, coeffs.k3, coeffs.k4, coeffs.k5, coeffs.k6);
+}
+
+/**
+ * @brief builds the camera model for a given calibration
+ * @param intrinsics  camera intrinsic parameters
+ * @param coeffs      distortion coefficients
+ */
+CameraModel make_camera_model(const CameraIntrinsics& intrinsics,
+                              const DistortionCoefficients& coeffs)
+{
+    CameraModel result;
+    result.camera_matrix = make_camera_matx(intrinsics);
+    result.dist_coeffs = make_distcoeffs_vec(coeffs);
+    return result;
+}
+
+/**
+ * @brief applies the distortion model and the camera matrix to a point
+ * @param camera      the camera model
+ * @param normalized  point in normalized image coordinates (x/z, y/z)
+ * @return the point in pixels
+ *
+ * This is the rational model used by cv::projectPoints().
+ */
+cv::Point2d distort_point(const CameraModel& camera, const cv::Point2d& normalized)
+{
+    const cv::Vec<double, 8>& d = camera.dist_coeffs;
+    const double x = normalized.x;
+    const double y = normalized.y;
+
+    const double r2 = x * x + y * y;
+    const double r4 = r2 * r2;
+    const double r6 = r4 * r2;
+    const double radial = (1 + d[0] * r2 + d[1] * r4 + d[4] * r6)
+                          / (1 + d[5] * r2 + d[6] * r4 + d[7] * r6);
+
+    const double xd = x * radial + 2 * d[2] * x * y + d[3] * (r2 + 2 * x * x);
+    const double yd = y * radial + d[2] * (r2 + 2 * y * y) + 2 * d[3] * x * y;
+
+    const cv::Matx33d& k = camera.camera_matrix;
+    return cv::Point2d(k(0, 0) * xd + k(0, 2), k(1, 1) * yd + k(1, 2));
+}
+
+/**
+ * @brief inverts distort_point()
+ * @param camera  the camera model
+ * @param pixel   point in pixels
+ * @return the point in normalized image coordinates
+ *
+ * The distortion model is inverted by fixed-point iterations, like
+ * cv::undistortPoints() does.
+ */
+cv::Point2d undistort_point(const CameraModel& camera, const cv::Point2d& pixel)
+{
+    constexpr int max_iterations = 20;
+    constexpr double epsilon = 1e-14;
+
+    const cv::Vec<double, 8>& d = camera.dist_coeffs;
+    const cv::Matx33d& k = camera.camera_matrix;
+
+    const double x0 = (pixel.x - k(0, 2)) / k(0, 0);
+    const double y0 = (pixel.y - k(1, 2)) / k(1, 1);
+    double x = x0;
+    double y = y0;
+
+    for (int i(0); i < max_iterations; ++i)
+    {
+        const double r2 = x * x + y * y;
+        const double r4 = r2 * r2;
+        const double r6 = r4 * r2;
+        const double icdist = (1 + d[5] * r2 + d[6] * r4 + d[7] * r6)
+                              / (1 + d[0] * r2 + d[1] * r4 + d[4] * r6);
+        const double dx = 2 * d[2] * x * y + d[3] * (r2 + 2 * x * x);
+        const double dy = d[2] * (r2 + 2 * y * y) + 2 * d[3] * x * y;
+
+        const double nx = (x0 - dx) * icdist;
+        const double ny = (y0 - dy) * icdist;
+        const bool converged = std::abs(nx - x) + std::abs(ny - y) < epsilon;
+        x = nx;
+        y = ny;
+
+        if (converged)
+        {
+            break;
+        }
+    }
+
+    return cv::Point2d(x, y);
+}
+
 } // namespace ocvp
@@ -4,9 +4,7 @@
 
 #include "contour.h"
 
-#include <opencv2/imgproc.hpp>
-
-#include <stdexcept>
+#include "rasterizer.h"
 
 namespace ocvp
 {
@@ -17,19 +15,50 @@ namespace ocvp
  * @param points     points of the polygon (need not be closed)
  * @param color      BGR color
  * @param thickness  thickness of the lines in pixels
+ *
+ * @sa draw_contours()
  */
 void draw_contour(cv::Mat& image,
                   const std::vector<cv::Point>& points,
                   const cv::Scalar& color,
                   int thickness)
 {
-    for (size_t i(0); i < points.size(); ++i)
-    {
-        cv::Point first = points.at(i);
-        cv::Point second = points.at((i + 1) % points.size());
+    draw_contours(image, { points }, color, thickness);
+}
 
-        cv::line(image, first, second, color, thickness);
+/**
+ * @brief draws the outlines of many polygons on an image
+ * @param image        the image on which the polygons are drawn
+ * @param contours     the polygons (need not be closed)
+ * @param color        BGR color
+ * @param thickness    thickness of the lines in pixels
+ * @param antialiased  whether the edges of the lines are antialiased
+ *
+ * Lines have round ends, like those of cv::line(). All the polygons are
+ * rasterized in a single pass over the image, split in horizontal tiles
+ * drawn in parallel: every pixel is written at most once, including those
+ * shared by two edges (the joins) or by overlapping polygons.
+ */
+void draw_contours(cv::Mat& image,
+                   const std::vector<std::vector<cv::Point>>& contours,
+                   const cv::Scalar& color,
+                   int thickness,
+                   bool antialiased)
+{
+    std::vector<StrokeSegment> segments;
+
+    for (const std::vector<cv::Point>& points : contours)
+    {
+        for (size_t i(0); i < points.size(); ++i)
+        {
+            StrokeSegment s;
+            s.a = points[i];
+            s.b = points[(i + 1) % points.size()];
+            segments.push_back(s);
+        }
     }
+
+    draw_strokes(image, segments, { color }, thickness, antialiased);
 }
 
 } // namespace ocvp
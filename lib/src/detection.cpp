@@ -0,0 +1,426 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "detection.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace ocvp
+{
+
+namespace
+{
+
+// The quadrilateral search is performed on an image whose largest side is
+// at most this many pixels.
+constexpr int coarse_max_size = 1024;
+
+// Candidates smaller than this fraction of the searched area are ignored.
+constexpr double min_area_ratio = 0.01;
+
+// Number of edge points measured on each side of the quad during refinement.
+constexpr int samples_per_side = 32;
+
+using Quad = std::array<cv::Point2d, 4>;
+
+int coarse_level(const cv::Size& size)
+{
+    int level = 0;
+
+    while ((std::max(size.width, size.height) >> level) > coarse_max_size)
+    {
+        ++level;
+    }
+
+    return level;
+}
+
+cv::Mat to_grayscale(const cv::Mat& image)
+{
+    cv::Mat gray;
+
+    switch (image.channels())
+    {
+    case 1:
+        gray = image;
+        break;
+    case 3:
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+        break;
+    case 4:
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+        break;
+    default:
+        throw std::runtime_error("detect_a4_sheet(): unsupported number of channels");
+    }
+
+    return gray;
+}
+
+double signed_area(const Quad& quad)
+{
+    double area = 0;
+
+    for (size_t i(0); i < 4; ++i)
+    {
+        const cv::Point2d& a = quad[i];
+        const cv::Point2d& b = quad[(i + 1) % 4];
+        area += a.x * b.y - b.x * a.y;
+    }
+
+    return area / 2;
+}
+
+bool touches_border(const std::vector<cv::Point>& polygon, const cv::Size& size)
+{
+    auto on_border = [&size](const cv::Point& p)
+    { return p.x <= 1 || p.y <= 1 || p.x >= size.width - 2 || p.y >= size.height - 2; };
+
+    return std::any_of(polygon.begin(), polygon.end(), on_border);
+}
+
+// Returns the largest convex quadrilateral among the contours of a binary image.
+// Quads touching the border of the image are rejected: they are either
+// cut by the border or the border itself.
+void find_quads(const cv::Mat& binary, double min_area, Quad& best, double& best_area)
+{
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(binary, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+    std::vector<cv::Point> approx;
+
+    for (const std::vector<cv::Point>& contour : contours)
+    {
+        if (contour.size() < 4)
+        {
+            continue;
+        }
+
+        cv::approxPolyDP(contour, approx, 0.02 * cv::arcLength(contour, true), true);
+
+        if (approx.size() != 4 || !cv::isContourConvex(approx)
+            || touches_border(approx, binary.size()))
+        {
+            continue;
+        }
+
+        double area = std::abs(cv::contourArea(approx));
+
+        if (area < min_area || area <= best_area)
+        {
+            continue;
+        }
+
+        best_area = area;
+
+        for (size_t i(0); i < 4; ++i)
+        {
+            best[i] = cv::Point2d(approx[i]);
+        }
+    }
+}
+
+// Looks for the sheet on a (downscaled) grayscale image.
+// Candidates come both from the edges of the image and from its bright
+// regions (the sheet being usually brighter than its surroundings).
+bool find_sheet(const cv::Mat& gray, Quad& quad)
+{
+    cv::Mat blurred;
+    cv::GaussianBlur(gray, blurred, cv::Size(5, 5), 0);
+
+    cv::Mat binary;
+    double otsu = cv::threshold(blurred, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+
+    cv::Mat edges;
+    cv::Canny(blurred, edges, otsu / 2, otsu);
+    cv::dilate(edges, edges, cv::Mat());
+
+    const double min_area = min_area_ratio * gray.cols * gray.rows;
+    double best_area = 0;
+    find_quads(edges, min_area, quad, best_area);
+    find_quads(binary, min_area, quad, best_area);
+
+    return best_area > 0;
+}
+
+// Bilinear interpolation of the intensity of an 8-bit image.
+double intensity(const cv::Mat& image, double x, double y)
+{
+    const int x0 = static_cast<int>(std::floor(x));
+    const int y0 = static_cast<int>(std::floor(y));
+    const double fx = x - x0;
+    const double fy = y - y0;
+    const int cn = image.channels();
+
+    auto pixel = [&](int px, int py) -> double
+    {
+        px = std::min(std::max(px, 0), image.cols - 1);
+        py = std::min(std::max(py, 0), image.rows - 1);
+        const uchar* p = image.ptr<uchar>(py) + px * cn;
+
+        if (cn == 1)
+        {
+            return p[0];
+        }
+
+        return 0.114 * p[0] + 0.587 * p[1] + 0.299 * p[2];
+    };
+
+    return (1 - fy) * ((1 - fx) * pixel(x0, y0) + fx * pixel(x0 + 1, y0))
+           + fy * ((1 - fx) * pixel(x0, y0 + 1) + fx * pixel(x0 + 1, y0 + 1));
+}
+
+// Fits a line on the strongest intensity step found along the normal of a
+// side of the coarse quad; returns false if not enough points were found.
+// The line is returned as (vx, vy, x0, y0), like cv::fitLine() does.
+bool refine_side(const cv::Mat& image,
+                 const cv::Point2d& a,
+                 const cv::Point2d& b,
+                 double search_radius,
+                 cv::Vec4f& line)
+{
+    const cv::Point2d direction = b - a;
+    const double length = std::sqrt(direction.dot(direction));
+
+    if (length < 1)
+    {
+        return false;
+    }
+
+    const cv::Point2d normal{ -direction.y / length, direction.x / length };
+    const int nb_steps = static_cast<int>(std::ceil(2 * search_radius));
+
+    std::vector<cv::Point2f> points;
+    points.reserve(samples_per_side);
+    std::vector<double> profile(2 * nb_steps + 1);
+
+    for (int k(0); k < samples_per_side; ++k)
+    {
+        // stays away from the corners, where the other side interferes
+        const double s = 0.1 + 0.8 * (k + 0.5) / samples_per_side;
+        const cv::Point2d center = a + direction * s;
+
+        for (int i(-nb_steps); i <= nb_steps; ++i)
+        {
+            const cv::Point2d p = center + normal * (0.5 * i);
+            profile[i + nb_steps] = intensity(image, p.x, p.y);
+        }
+
+        int best = -1;
+        double best_gradient = 0;
+
+        for (int i(1); i + 1 < static_cast<int>(profile.size()); ++i)
+        {
+            const double gradient = std::abs(profile[i + 1] - profile[i - 1]);
+
+            if (gradient > best_gradient)
+            {
+                best_gradient = gradient;
+                best = i;
+            }
+        }
+
+        if (best < 2 || best + 2 >= static_cast<int>(profile.size()) || best_gradient < 8)
+        {
+            continue;
+        }
+
+        // sub-sample position of the maximum of the gradient (parabola fit)
+        const double g0 = std::abs(profile[best] - profile[best - 2]);
+        const double g1 = best_gradient;
+        const double g2 = std::abs(profile[best + 2] - profile[best]);
+        const double denominator = g0 - 2 * g1 + g2;
+        const double offset = denominator < 0 ? 0.5 * (g0 - g2) / denominator : 0;
+
+        const cv::Point2d p = center + normal * (0.5 * (best - nb_steps + offset));
+        points.emplace_back(static_cast<float>(p.x), static_cast<float>(p.y));
+    }
+
+    if (points.size() < samples_per_side / 4)
+    {
+        return false;
+    }
+
+    cv::fitLine(points, line, cv::DIST_HUBER, 0, 0.01, 0.01);
+    return true;
+}
+
+bool intersect(const cv::Vec4f& l1, const cv::Vec4f& l2, cv::Point2d& result)
+{
+    const double det = l1[0] * l2[1] - l1[1] * l2[0];
+
+    if (std::abs(det) < 1e-6)
+    {
+        return false;
+    }
+
+    const double dx = l2[2] - l1[2];
+    const double dy = l2[3] - l1[3];
+    const double t = (dx * l2[1] - dy * l2[0]) / det;
+    result = cv::Point2d(l1[2] + t * l1[0], l1[3] + t * l1[1]);
+    return true;
+}
+
+// Moves the corners of a quad, found on a downscaled image, to the
+// intersections of its sides measured at full resolution.
+// Only a band of pixels around the sides of the quad is read.
+void refine_quad(const cv::Mat& image, double search_radius, Quad& quad)
+{
+    std::array<cv::Vec4f, 4> lines;
+
+    for (size_t i(0); i < 4; ++i)
+    {
+        if (!refine_side(image, quad[i], quad[(i + 1) % 4], search_radius, lines[i]))
+        {
+            return;
+        }
+    }
+
+    Quad refined;
+
+    for (size_t i(0); i < 4; ++i)
+    {
+        // corner i is shared by the sides (i - 1) and i
+        if (!intersect(lines[(i + 3) % 4], lines[i], refined[i]))
+        {
+            return;
+        }
+
+        const cv::Point2d d = refined[i] - quad[i];
+
+        if (d.dot(d) > 4 * search_radius * search_radius)
+        {
+            return;
+        }
+    }
+
+    quad = refined;
+}
+
+// Orders the corners as expected by solve_pnp(): the bottom side of the
+// sheet is taken to be the short side that is the lowest in the image.
+A4SheetOfPaper to_a4sheet(Quad quad)
+{
+    // bottom-left, bottom-right, top-right, top-left has a negative signed
+    // area in image coordinates (y pointing down)
+    if (signed_area(quad) > 0)
+    {
+        std::reverse(quad.begin(), quad.end());
+    }
+
+    auto side_length = [&quad](size_t i)
+    {
+        const cv::Point2d d = quad[(i + 1) % 4] - quad[i];
+        return std::sqrt(d.dot(d));
+    };
+
+    // the short sides are either (0, 2) or (1, 3)
+    const size_t first_short_side
+      = side_length(0) + side_length(2) <= side_length(1) + side_length(3) ? 0 : 1;
+    const size_t other_short_side = first_short_side + 2;
+
+    auto middle_y = [&quad](size_t i) { return quad[i].y + quad[(i + 1) % 4].y; };
+
+    const size_t start
+      = middle_y(first_short_side) >= middle_y(other_short_side) ? first_short_side
+                                                                 : other_short_side;
+
+    auto corner = [&](size_t i)
+    {
+        const cv::Point2d& p = quad[(start + i) % 4];
+        return cv::Point(cvRound(p.x), cvRound(p.y));
+    };
+
+    A4SheetOfPaper sheet;
+    sheet.bottom_left = corner(0);
+    sheet.bottom_right = corner(1);
+    sheet.top_right = corner(2);
+    sheet.top_left = corner(3);
+    return sheet;
+}
+
+} // namespace
+
+/**
+ * @brief detects a A4 sheet of paper in an image
+ * @param image  8-bit grayscale, BGR or BGRA image
+ * @param roi    if not empty, the region of the image in which the sheet is searched
+ * @return the corners of the sheet, in the order expected by solve_pnp()
+ * @throw std::runtime_error if no sheet could be found
+ *
+ * Quadrilaterals are searched on a downscaled version of the image (whose
+ * largest side is at most 1024 pixels); the largest convex one is kept.
+ * Its sides are then located precisely on the full-resolution image, by
+ * looking for the strongest intensity step along a few normals, and its
+ * corners are computed as the intersections of the fitted lines.
+ *
+ * The image does not tell which short side of the sheet is its bottom:
+ * the lowest one in the image is chosen.
+ */
+A4SheetOfPaper detect_a4_sheet(const cv::Mat& image, const cv::Rect& roi)
+{
+    if (image.empty() || image.dims != 2 || image.depth() != CV_8U)
+    {
+        throw std::runtime_error("detect_a4_sheet(): expected a 8-bit image");
+    }
+
+    const cv::Rect area = roi.area() > 0 ? roi & cv::Rect(0, 0, image.cols, image.rows)
+                                         : cv::Rect(0, 0, image.cols, image.rows);
+
+    if (area.area() == 0)
+    {
+        throw std::runtime_error("detect_a4_sheet(): the ROI is outside of the image");
+    }
+
+    const cv::Mat view = image(area);
+    const int level = coarse_level(view.size());
+    const double scale = 1 << level;
+
+    cv::Mat coarse;
+
+    if (level > 0)
+    {
+        cv::resize(view,
+                   coarse,
+                   cv::Size(view.cols >> level, view.rows >> level),
+                   0,
+                   0,
+                   cv::INTER_AREA);
+    }
+    else
+    {
+        coarse = view;
+    }
+
+    Quad quad;
+
+    if (!find_sheet(to_grayscale(coarse), quad))
+    {
+        throw std::runtime_error("detect_a4_sheet(): no sheet of paper found");
+    }
+
+    for (cv::Point2d& p : quad)
+    {
+        // centers of coarse pixels are at the center of scale x scale blocks
+        p = (p + cv::Point2d(0.5, 0.5)) * scale - cv::Point2d(0.5, 0.5);
+    }
+
+    refine_quad(view, 2 * scale + 2, quad);
+
+    for (cv::Point2d& p : quad)
+    {
+        p += cv::Point2d(area.x, area.y);
+    }
+
+    return to_a4sheet(quad);
+}
+
+} // namespace ocvp
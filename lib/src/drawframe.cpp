@@ -4,9 +4,12 @@
 
 #include "drawframe.h"
 
+#include "rasterizer.h"
+
 #include <opencv2/calib3d.hpp>
 #include <opencv2/core.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace ocvp
@@ -39,4 +42,191 @@ void draw_frame_axes(cv::Mat& image,
                       thickness);
 }
 
+/**
+ * @brief draws the outline of a planar target on an image
+ * @param image      input/output image on which the outline is drawn
+ * @param camera     the camera model
+ * @param target     size of the target
+ * @param pose       screen-to-world pose of the target
+ * @param color      BGR color
+ * @param thickness  thickness (in pixels) of the outline
+ * @return false if the target is (partly) behind the camera, in which case
+ *         nothing is drawn
+ *
+ * The edges are split in short segments, so that they are curved by the
+ * distortion like those of the target on the picture.
+ */
+bool draw_planar_target(cv::Mat& image,
+                        const CameraModel& camera,
+                        const PlanarTarget& target,
+                        const Pose& pose,
+                        const cv::Scalar& color,
+                        int thickness)
+{
+    constexpr int nb_subdivisions = 8;
+
+    const cv::Matx33d rotation = get_rotation_matrix(pose.rvec);
+    const cv::Vec3d corners[] = {
+        cv::Vec3d(0, 0, 0),
+        cv::Vec3d(target.width, 0, 0),
+        cv::Vec3d(target.width, target.height, 0),
+        cv::Vec3d(0, target.height, 0),
+    };
+
+    for (const cv::Vec3d& corner : corners)
+    {
+        if (!((rotation * corner + pose.tvec)[2] > 0))
+        {
+            return false;
+        }
+    }
+
+    std::vector<StrokeSegment> segments;
+    cv::Point2d previous = project_point(camera, rotation, pose.tvec, corners[0]);
+
+    for (int i(0); i < 4; ++i)
+    {
+        const cv::Vec3d& a = corners[i];
+        const cv::Vec3d& b = corners[(i + 1) % 4];
+
+        for (int j(1); j <= nb_subdivisions; ++j)
+        {
+            const double t = j / double(nb_subdivisions);
+
+            StrokeSegment s;
+            s.a = previous;
+            s.b = project_point(camera, rotation, pose.tvec, a + t * (b - a));
+            segments.push_back(s);
+            previous = s.b;
+        }
+    }
+
+    draw_strokes(image, segments, { color }, thickness, false);
+
+    return true;
+}
+
+/**
+ * @brief draws the axes of the world frames of many poses on an image
+ * @param image      input/output image on which the axes are drawn
+ * @param camera     the camera model
+ * @param poses      screen-to-world poses
+ * @param count      number of poses
+ * @param length     3D-world length of the axes (defaults to 1)
+ * @param thickness  thickness (in pixels) of the axes
+ * @return the number of poses whose axes were drawn
+ *
+ * Produces the same axes as draw_frame_axes() (x in red, y in green, z in
+ * blue), but the endpoints of all the axes are projected with a single call
+ * to cv::projectPoints() and all the axes are drawn in a single pass over
+ * the image (see draw_contours()).
+ * Poses whose axes are behind the camera, or whose projection does not
+ * intersect the image, are skipped.
+ */
+size_t draw_frame_axes_batch(cv::Mat& image,
+                             const CameraModel& camera,
+                             const PnPResult* poses,
+                             size_t count,
+                             float length,
+                             int thickness)
+{
+    // the endpoints are computed in camera coordinates, so that the poses
+    // share the same (identity) transformation in cv::projectPoints()
+    std::vector<cv::Point3d> points;
+    points.reserve(4 * count);
+
+    for (size_t i(0); i < count; ++i)
+    {
+        const Pose pose = to_pose(poses[i]);
+        const cv::Matx33d rotation = get_rotation_matrix(pose.rvec);
+        const cv::Vec3d axes[] = {
+            pose.tvec,
+            pose.tvec + length * rotation.col(0),
+            pose.tvec + length * rotation.col(1),
+            pose.tvec + length * rotation.col(2),
+        };
+
+        const bool in_front = std::all_of(std::begin(axes),
+                                          std::end(axes),
+                                          [](const cv::Vec3d& p) { return p[2] > 0; });
+
+        if (in_front)
+        {
+            for (const cv::Vec3d& p : axes)
+            {
+                points.emplace_back(p[0], p[1], p[2]);
+            }
+        }
+    }
+
+    if (points.empty())
+    {
+        return 0;
+    }
+
+    std::vector<cv::Point2d> projected;
+    cv::projectPoints(points,
+                      cv::Vec3d(0, 0, 0),
+                      cv::Vec3d(0, 0, 0),
+                      camera.camera_matrix,
+                      camera.dist_coeffs,
+                      projected);
+
+    static const std::vector<cv::Scalar> colors = {
+        cv::Scalar(0, 0, 255),
+        cv::Scalar(0, 255, 0),
+        cv::Scalar(255, 0, 0),
+    };
+
+    const double margin = thickness / 2.0;
+    std::vector<StrokeSegment> segments;
+    size_t nb_drawn = 0;
+
+    for (size_t i(0); i < projected.size(); i += 4)
+    {
+        const cv::Point2d* p = projected.data() + i;
+        const auto x = std::minmax({ p[0].x, p[1].x, p[2].x, p[3].x });
+        const auto y = std::minmax({ p[0].y, p[1].y, p[2].y, p[3].y });
+
+        if (x.second < -margin || x.first > image.cols + margin || y.second < -margin
+            || y.first > image.rows + margin)
+        {
+            continue;
+        }
+
+        for (int axis(0); axis < 3; ++axis)
+        {
+            StrokeSegment s;
+            s.a = p[0];
+            s.b = p[axis + 1];
+            s.color = axis;
+            segments.push_back(s);
+        }
+
+        ++nb_drawn;
+    }
+
+    draw_strokes(image, segments, colors, thickness, false);
+
+    return nb_drawn;
+}
+
+/**
+ * @brief draws the axes of the world frames of many poses on an image
+ * @param image      input/output image on which the axes are drawn
+ * @param camera     the camera model
+ * @param poses      screen-to-world poses
+ * @param length     3D-world length of the axes (defaults to 1)
+ * @param thickness  thickness (in pixels) of the axes
+ * @return the number of poses whose axes were drawn
+ */
+size_t draw_frame_axes_batch(cv::Mat& image,
+                             const CameraModel& camera,
+                             const std::vector<PnPResult>& poses,
+                             float length,
+                             int thickness)
+{
+    return draw_frame_axes_batch(image, camera, poses.data(), poses.size(), length, thickness);
+}
+
 } // namespace ocvp
@@ -0,0 +1,366 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "framepool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ocvp
+{
+
+namespace
+{
+
+constexpr size_t alignment = 64;
+constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+size_t round_up(size_t size, size_t multiple)
+{
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+void* allocate_buffer(size_t size, bool huge_pages)
+{
+#ifdef _WIN32
+    (void)huge_pages; // large pages require a privilege, they are not used
+    void* buffer = _aligned_malloc(size, alignment);
+#else
+    void* buffer = nullptr;
+    const size_t buffer_alignment = huge_pages ? huge_page_size : alignment;
+
+    if (huge_pages)
+    {
+        size = round_up(size, huge_page_size);
+    }
+
+    if (posix_memalign(&buffer, buffer_alignment, size) != 0)
+    {
+        buffer = nullptr;
+    }
+
+#ifdef __linux__
+    if (buffer && huge_pages)
+    {
+        // transparent huge pages: a hint, that the kernel may ignore
+        madvise(buffer, size, MADV_HUGEPAGE);
+    }
+#endif
+#endif
+
+    if (!buffer)
+    {
+        throw std::bad_alloc();
+    }
+
+    return buffer;
+}
+
+void free_buffer(void* buffer)
+{
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+// Index of the calling thread, in order of first use
+size_t thread_index()
+{
+    static std::atomic<size_t> next_index{ 0 };
+    thread_local size_t index = next_index++;
+    return index;
+}
+
+void update_peak(std::atomic<size_t>& peak, size_t value)
+{
+    size_t current = peak.load();
+
+    while (value > current && !peak.compare_exchange_weak(current, value))
+    {
+    }
+}
+
+} // namespace
+
+struct FramePool::FreeLists
+{
+    std::mutex mutex;
+    std::map<size_t, std::vector<void*>> buffers; // by size class
+
+    void* pop(size_t size)
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        auto it = buffers.find(size);
+
+        if (it == buffers.end() || it->second.empty())
+        {
+            return nullptr;
+        }
+
+        void* buffer = it->second.back();
+        it->second.pop_back();
+        return buffer;
+    }
+
+    void push(void* buffer, size_t size)
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        buffers[size].push_back(buffer);
+    }
+};
+
+/**
+ * @brief constructs an empty pool
+ * @param options
+ */
+FramePool::FramePool(const FramePoolOptions& options)
+    : m_options(options),
+      m_nb_hits(0),
+      m_nb_misses(0),
+      m_nb_released(0),
+      m_allocated_bytes(0),
+      m_cached_bytes(0),
+      m_peak_bytes(0)
+{
+    const size_t nb_lists = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i(0); i < nb_lists; ++i)
+    {
+        m_free_lists.push_back(std::make_unique<FreeLists>());
+    }
+}
+
+/**
+ * @brief frees the cached buffers
+ */
+FramePool::~FramePool()
+{
+    trim();
+}
+
+/**
+ * @brief makes a pool the default allocator of OpenCV
+ * @param options  options of the pool, ignored if a pool is already installed
+ * @return the installed pool
+ *
+ * The pool is never destroyed, so that it outlives every matrix, including
+ * static ones and those of OpenCV.
+ */
+FramePool& FramePool::install(const FramePoolOptions& options)
+{
+    static FramePool* pool = [&options]()
+    {
+        auto* p = new FramePool(options);
+        cv::Mat::setDefaultAllocator(p);
+        return p;
+    }();
+
+    return *pool;
+}
+
+const FramePoolOptions& FramePool::options() const
+{
+    return m_options;
+}
+
+FramePoolStatistics FramePool::statistics() const
+{
+    FramePoolStatistics stats;
+    stats.nb_hits = m_nb_hits;
+    stats.nb_misses = m_nb_misses;
+    stats.nb_released = m_nb_released;
+    stats.cached_bytes = m_cached_bytes;
+    const size_t allocated_bytes = m_allocated_bytes;
+    stats.in_use_bytes = allocated_bytes - std::min(allocated_bytes, stats.cached_bytes);
+    stats.peak_bytes = m_peak_bytes;
+    return stats;
+}
+
+/**
+ * @brief frees the cached buffers
+ */
+void FramePool::trim()
+{
+    for (std::unique_ptr<FreeLists>& lists : m_free_lists)
+    {
+        std::lock_guard<std::mutex> lock{ lists->mutex };
+
+        for (auto& entry : lists->buffers)
+        {
+            for (void* buffer : entry.second)
+            {
+                free_buffer(buffer);
+                m_cached_bytes -= entry.first;
+                m_allocated_bytes -= entry.first;
+                ++m_nb_released;
+            }
+
+            entry.second.clear();
+        }
+    }
+}
+
+/**
+ * @brief returns the size of the buffers allocated for a given size
+ *
+ * There are 8 classes per power of two, so that at most 1/8 of a buffer
+ * is wasted.
+ */
+size_t FramePool::size_class(size_t size)
+{
+    size_t power = 1;
+
+    while (power <= size / 2)
+    {
+        power *= 2;
+    }
+
+    return round_up(size, std::max<size_t>(alignment, power / 8));
+}
+
+cv::UMatData* FramePool::allocate(int dims,
+                                  const int* sizes,
+                                  int type,
+                                  void* data,
+                                  size_t* step,
+                                  cv::AccessFlag /* flags */,
+                                  cv::UMatUsageFlags /* usageFlags */) const
+{
+    // same layout as cv::Mat::getStdAllocator()
+    size_t total = CV_ELEM_SIZE(type);
+
+    for (int i(dims - 1); i >= 0; --i)
+    {
+        if (step)
+        {
+            if (data && step[i] != CV_AUTOSTEP)
+            {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            }
+            else
+            {
+                step[i] = total;
+            }
+        }
+
+        total *= sizes[i];
+    }
+
+    auto* u = new cv::UMatData(this);
+    u->size = total;
+
+    if (data)
+    {
+        u->data = u->origdata = static_cast<uchar*>(data);
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+    else
+    {
+        u->data = u->origdata = static_cast<uchar*>(acquire(total));
+    }
+
+    return u;
+}
+
+bool FramePool::allocate(cv::UMatData* data,
+                         cv::AccessFlag /* accessflags */,
+                         cv::UMatUsageFlags /* usageFlags */) const
+{
+    return data != nullptr;
+}
+
+void FramePool::deallocate(cv::UMatData* data) const
+{
+    if (!data)
+    {
+        return;
+    }
+
+    CV_Assert(data->urefcount == 0);
+    CV_Assert(data->refcount == 0);
+
+    if (!(data->flags & cv::UMatData::USER_ALLOCATED))
+    {
+        release(data->origdata, data->size);
+        data->origdata = nullptr;
+    }
+
+    delete data;
+}
+
+void* FramePool::acquire(size_t size) const
+{
+    if (size < m_options.min_pooled_size)
+    {
+        return cv::fastMalloc(size);
+    }
+
+    const size_t class_size = size_class(size);
+    const size_t first = thread_index() % m_free_lists.size();
+    void* buffer = nullptr;
+
+    for (size_t i(0); i < m_free_lists.size() && !buffer; ++i)
+    {
+        buffer = m_free_lists[(first + i) % m_free_lists.size()]->pop(class_size);
+    }
+
+    if (buffer)
+    {
+        ++m_nb_hits;
+        m_cached_bytes -= class_size;
+        return buffer;
+    }
+
+    const bool huge_pages = m_options.huge_pages && class_size >= m_options.huge_page_threshold;
+    buffer = allocate_buffer(class_size, huge_pages);
+    ++m_nb_misses;
+    update_peak(m_peak_bytes, m_allocated_bytes += class_size);
+    return buffer;
+}
+
+void FramePool::release(void* buffer, size_t size) const
+{
+    if (size < m_options.min_pooled_size)
+    {
+        cv::fastFree(buffer);
+        return;
+    }
+
+    const size_t class_size = size_class(size);
+
+    if ((m_cached_bytes += class_size) > m_options.max_cached_bytes)
+    {
+        m_cached_bytes -= class_size;
+        m_allocated_bytes -= class_size;
+        ++m_nb_released;
+        free_buffer(buffer);
+        return;
+    }
+
+    local_free_lists().push(buffer, class_size);
+}
+
+FramePool::FreeLists& FramePool::local_free_lists() const
+{
+    return *m_free_lists[thread_index() % m_free_lists.size()];
+}
+
+} // namespace ocvp
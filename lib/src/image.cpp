@@ -7,10 +7,76 @@
 #include <opencv2/imgcodecs.hpp>
 
 #include <stdexcept>
+#include <string>
 
 namespace ocvp
 {
 
+namespace
+{
+
+// Only the options that differ from the defaults are passed to OpenCV: some
+// parameters, like the PNG compression level, also change other settings.
+std::vector<int> encode_params(const EncodeOptions& options)
+{
+    const EncodeOptions defaults;
+    std::vector<int> params;
+
+    if (options.jpeg_quality != defaults.jpeg_quality)
+    {
+        params.insert(params.end(), { cv::IMWRITE_JPEG_QUALITY, options.jpeg_quality });
+    }
+
+    if (options.jpeg_progressive)
+    {
+        params.insert(params.end(), { cv::IMWRITE_JPEG_PROGRESSIVE, 1 });
+    }
+
+    if (options.jpeg_optimize)
+    {
+        params.insert(params.end(), { cv::IMWRITE_JPEG_OPTIMIZE, 1 });
+    }
+
+    if (options.png_compression != defaults.png_compression)
+    {
+        params.insert(params.end(), { cv::IMWRITE_PNG_COMPRESSION, options.png_compression });
+    }
+
+    return params;
+}
+
+int imread_flags(const LoadOptions& options)
+{
+    int flags;
+
+    switch (options.reduction)
+    {
+    case 1:
+        flags = options.grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+        break;
+    case 2:
+        flags = options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+        break;
+    case 4:
+        flags = options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+        break;
+    case 8:
+        flags = options.grayscale ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+        break;
+    default:
+        throw std::runtime_error("Invalid image reduction " + std::to_string(options.reduction));
+    }
+
+    if (options.ignore_orientation)
+    {
+        flags |= cv::IMREAD_IGNORE_ORIENTATION;
+    }
+
+    return flags;
+}
+
+} // namespace
+
 /**
  * @brief loads an image into memory
  * @param filepath  path to the image
@@ -21,7 +87,28 @@ namespace ocvp
  */
 cv::Mat load_image(const std::string& filepath)
 {
-    cv::Mat img = cv::imread(filepath);
+    return load_image(filepath, LoadOptions());
+}
+
+/**
+ * @brief loads an image into memory, possibly at a reduced resolution
+ * @param filepath  path to the image
+ * @param options   decoding options
+ * @param scale     if not null, receives the ratio between the size of the
+ *                  returned image and the full-resolution size (1/reduction)
+ * @throw std::runtime_error on failure, or if the reduction is not 1, 2, 4 or 8
+ *
+ * JPEG images are decoded directly at the reduced size (using the DCT
+ * scaling of the decoder), which is much faster and uses much less memory
+ * than a full-resolution decode; other formats are decoded then resized.
+ * A point (x, y) of the returned image is at (x / scale, y / scale) in the
+ * full-resolution image, up to the rounding of the reduced size.
+ *
+ * @warning BGR format is used for colored images
+ */
+cv::Mat load_image(const std::string& filepath, const LoadOptions& options, double* scale)
+{
+    cv::Mat img = cv::imread(filepath, imread_flags(options));
 
     if (img.data == nullptr)
     {
@@ -33,6 +120,43 @@ cv::Mat load_image(const std::string& filepath)
         throw std::runtime_error("Image could not be loaded");
     }
 
+    if (scale)
+    {
+        *scale = 1.0 / options.reduction;
+    }
+
+    return img;
+}
+
+/**
+ * @brief decodes an image file that was read into memory
+ * @param bytes    content of the file
+ * @param options  decoding options
+ * @param scale    if not null, receives 1/reduction (see load_image())
+ * @throw std::runtime_error on failure, or if the reduction is not 1, 2, 4 or 8
+ *
+ * @warning BGR format is used for colored images
+ */
+cv::Mat decode_image(const std::vector<uchar>& bytes, const LoadOptions& options, double* scale)
+{
+    const int flags = imread_flags(options);
+    cv::Mat img;
+
+    if (!bytes.empty())
+    {
+        img = cv::imdecode(bytes, flags);
+    }
+
+    if (img.data == nullptr)
+    {
+        throw std::runtime_error("Image could not be decoded");
+    }
+
+    if (scale)
+    {
+        *scale = 1.0 / options.reduction;
+    }
+
     return img;
 }
 
@@ -49,4 +173,38 @@ bool save_image(const cv::Mat& image, const std::string& filepath)
     return cv::imwrite(filepath, image);
 }
 
+/**
+ * @brief saves an image onto the disk
+ * @param image     the image
+ * @param filepath  save path
+ * @param options   encoding options
+ * @return whether the image was successfully saved
+ */
+bool save_image(const cv::Mat& image, const std::string& filepath, const EncodeOptions& options)
+{
+    return cv::imwrite(filepath, image, encode_params(options));
+}
+
+/**
+ * @brief encodes an image in memory
+ * @param image    the image
+ * @param format   extension of the format, e.g. ".jpg"
+ * @param options  encoding options
+ * @return the content of the image file
+ * @throw std::runtime_error on failure
+ */
+std::vector<uchar> encode_image(const cv::Mat& image,
+                                const std::string& format,
+                                const EncodeOptions& options)
+{
+    std::vector<uchar> buffer;
+
+    if (!cv::imencode(format, image, buffer, encode_params(options)))
+    {
+        throw std::runtime_error("Image could not be encoded as " + format);
+    }
+
+    return buffer;
+}
+
 } // namespace ocvp
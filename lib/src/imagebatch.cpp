@@ -0,0 +1,376 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "imagebatch.h"
+
+#include "imagewriter.h"
+#include "workerpool.h"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/utils/filesystem.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+bool has_image_extension(const std::string& path)
+{
+    static const char* extensions[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".webp" };
+
+    const size_t dot = path.find_last_of('.');
+
+    if (dot == std::string::npos)
+    {
+        return false;
+    }
+
+    std::string ext = path.substr(dot);
+    std::transform(ext.begin(),
+                   ext.end(),
+                   ext.begin(),
+                   [](char c) { return static_cast<char>(std::tolower(static_cast<uchar>(c))); });
+
+    return std::find(std::begin(extensions), std::end(extensions), ext) != std::end(extensions);
+}
+
+std::string file_name(const std::string& path)
+{
+    const size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+bool read_file(const std::string& path, std::vector<uchar>& bytes)
+{
+    std::ifstream file{ path, std::ios::binary | std::ios::ate };
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    const std::streamoff size = file.tellg();
+
+    if (size < 0)
+    {
+        return false;
+    }
+
+    bytes.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), size);
+    return static_cast<bool>(file);
+}
+
+} // namespace
+
+/**
+ * @brief lists the images of a batch
+ * @param path  a directory, or a manifest file
+ * @throw std::runtime_error if the manifest cannot be read
+ *
+ * The images of a directory are the files with a known image extension,
+ * in alphabetical order (subdirectories are not searched).
+ * Each non-empty line of a manifest (except lines starting with #) is a
+ * list of whitespace-separated words: the path of the image followed by
+ * arguments whose meaning depends on the program.
+ */
+std::vector<ImageBatchInput> read_image_batch_inputs(const std::string& path)
+{
+    std::vector<ImageBatchInput> inputs;
+
+    if (cv::utils::fs::isDirectory(path))
+    {
+        std::vector<std::string> files;
+        cv::glob(path, files, false);
+
+        for (const std::string& f : files)
+        {
+            if (has_image_extension(f))
+            {
+                ImageBatchInput input;
+                input.path = f;
+                inputs.push_back(input);
+            }
+        }
+
+        return inputs;
+    }
+
+    std::ifstream manifest{ path };
+
+    if (!manifest.is_open())
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(manifest, line))
+    {
+        ++line_number;
+
+        std::istringstream words{ line };
+        ImageBatchInput input;
+
+        if (!(words >> input.path) || input.path[0] == '#')
+        {
+            continue;
+        }
+
+        std::string word;
+
+        while (words >> word)
+        {
+            input.arguments.push_back(word);
+        }
+
+        input.line_number = line_number;
+        inputs.push_back(std::move(input));
+    }
+
+    return inputs;
+}
+
+/**
+ * @brief maps the images of a batch to files of an output directory
+ * @param inputs      the images
+ * @param output_dir  the directory, created if it does not exist
+ * @throw std::runtime_error if the directory cannot be created or if two
+ *        inputs have the same file name
+ *
+ * The output file has the same name as the input file, so that the
+ * extension (and thus the format) is preserved.
+ */
+std::vector<ImageBatchItem> make_image_batch(const std::vector<ImageBatchInput>& inputs,
+                                             const std::string& output_dir)
+{
+    if (!cv::utils::fs::createDirectories(output_dir))
+    {
+        throw std::runtime_error("Could not create directory " + output_dir);
+    }
+
+    std::vector<ImageBatchItem> items;
+    std::set<std::string> names;
+    items.reserve(inputs.size());
+
+    for (const ImageBatchInput& input : inputs)
+    {
+        std::string name = file_name(input.path);
+
+        if (!names.insert(name).second)
+        {
+            throw std::runtime_error("Several images are named " + name);
+        }
+
+        ImageBatchItem item;
+        item.input_path = input.path;
+        item.output_path = cv::utils::fs::join(output_dir, name);
+        items.push_back(item);
+    }
+
+    return items;
+}
+
+/**
+ * @brief reads, decodes, draws onto and writes a batch of images
+ * @param items    the images
+ * @param draw     called on each decoded image
+ * @param options  number of threads, memory bound, decoding and encoding options
+ *
+ * The stages run concurrently: the calling thread reads the files ahead of
+ * a pool of threads that decode and draw, and an AsyncImageWriter encodes
+ * and writes the results.
+ * The pixels of the images that are decoded and not written yet are
+ * bounded by @a options.max_decoded_bytes: half of it for the images being
+ * drawn, half for the images waiting to be encoded. The reader stops
+ * reading ahead when the next images (estimated to be as large as the
+ * largest image so far) would not fit.
+ * An image larger than the bound is still processed, alone.
+ *
+ * Failures do not stop the batch; they are reported in the statistics.
+ */
+ImageBatchStatistics process_image_batch(const std::vector<ImageBatchItem>& items,
+                                         const ImageBatchDrawFunction& draw,
+                                         const ImageBatchOptions& options)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    AsyncImageWriterOptions writer_options;
+    writer_options.nb_threads = options.nb_encode_threads;
+    writer_options.max_queue_size = std::numeric_limits<size_t>::max();
+    writer_options.max_queued_bytes = options.max_decoded_bytes / 2;
+    const size_t max_drawing_bytes = options.max_decoded_bytes - writer_options.max_queued_bytes;
+
+    ImageBatchStatistics stats;
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t nb_decoding = 0;   // images read and not decoded yet
+    size_t drawing_bytes = 0; // images decoded and not handed to the writer yet
+    size_t largest_image = 0;
+
+    AsyncImageWriter writer{ writer_options };
+
+    auto process = [&](size_t index, std::vector<uchar>& bytes)
+    {
+        const ImageBatchItem& item = items[index];
+        std::string error;
+        cv::Mat image;
+        double scale = 1;
+
+        auto decode_start = std::chrono::steady_clock::now();
+
+        try
+        {
+            image = decode_image(bytes, options.load_options, &scale);
+        }
+        catch (const std::exception& ex)
+        {
+            error = ex.what();
+        }
+
+        std::vector<uchar>().swap(bytes);
+        const double decode_ms = elapsed_ms(decode_start);
+        const size_t image_bytes = image.total() * image.elemSize();
+        const size_t queued_bytes = writer.queued_bytes();
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            --nb_decoding;
+            drawing_bytes += image_bytes;
+            largest_image = std::max(largest_image, image_bytes);
+            stats.peak_decoded_bytes =
+              std::max(stats.peak_decoded_bytes, drawing_bytes + queued_bytes);
+            stats.decode_ms += decode_ms;
+        }
+
+        condition.notify_all();
+
+        if (error.empty())
+        {
+            auto draw_start = std::chrono::steady_clock::now();
+
+            try
+            {
+                draw(index, image, scale);
+            }
+            catch (const std::exception& ex)
+            {
+                error = ex.what();
+            }
+
+            const double draw_ms = elapsed_ms(draw_start);
+
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                stats.draw_ms += draw_ms;
+            }
+        }
+
+        if (error.empty())
+        {
+            // blocks while the images waiting to be encoded use half of the bound
+            writer.write(image, item.output_path, options.encode_options);
+        }
+
+        image.release();
+
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            drawing_bytes -= image_bytes;
+
+            if (!error.empty())
+            {
+                ++stats.nb_failed;
+                stats.errors.push_back(item.input_path + ": " + error);
+            }
+        }
+
+        condition.notify_all();
+    };
+
+    {
+        WorkerPool pool{ options.nb_threads };
+
+        // each thread has the next file at hand when it finishes an image
+        const size_t max_decoding = 2 * pool.size();
+
+        for (size_t i(0); i < items.size(); ++i)
+        {
+            auto read_start = std::chrono::steady_clock::now();
+            std::vector<uchar> bytes;
+
+            if (!read_file(items[i].input_path, bytes))
+            {
+                std::lock_guard<std::mutex> lock{ mutex };
+                ++stats.nb_failed;
+                stats.errors.push_back(items[i].input_path + ": could not be read");
+                continue;
+            }
+
+            stats.read_ms += elapsed_ms(read_start);
+            stats.bytes_read += bytes.size();
+
+            {
+                auto wait_start = std::chrono::steady_clock::now();
+                std::unique_lock<std::mutex> lock{ mutex };
+
+                condition.wait(lock,
+                               [&]()
+                               {
+                                   if (nb_decoding == 0 && drawing_bytes == 0)
+                                   {
+                                       return true;
+                                   }
+
+                                   return nb_decoding < max_decoding
+                                          && drawing_bytes + (nb_decoding + 1) * largest_image
+                                               <= max_drawing_bytes;
+                               });
+
+                stats.blocked_ms += elapsed_ms(wait_start);
+                ++nb_decoding;
+            }
+
+            pool.submit([&process, i, bytes = std::move(bytes)]() mutable { process(i, bytes); });
+        }
+    }
+
+    writer.wait();
+
+    AsyncImageWriterStatistics writer_stats = writer.statistics();
+    stats.nb_written = writer_stats.nb_written;
+    stats.nb_failed += writer_stats.nb_failed;
+    stats.bytes_written = writer_stats.bytes_written;
+    stats.write_latency_ms = writer_stats.total_latency_ms;
+
+    if (writer_stats.nb_failed > 0)
+    {
+        stats.errors.push_back(std::to_string(writer_stats.nb_failed)
+                               + " image(s) could not be written: " + writer_stats.last_error);
+    }
+
+    stats.elapsed_ms = elapsed_ms(start);
+
+    return stats;
+}
+
+} // namespace ocvp
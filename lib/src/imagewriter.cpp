@@ -0,0 +1,181 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "imagewriter.h"
+
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+size_t pixel_bytes(const cv::Mat& image)
+{
+    return image.total() * image.elemSize();
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+} // namespace
+
+/**
+ * @brief constructs a writer
+ * @param options  number of threads and bounds of the queue
+ */
+AsyncImageWriter::AsyncImageWriter(const AsyncImageWriterOptions& options)
+    : m_options(options),
+      m_pool(options.nb_threads)
+{
+    m_options.nb_threads = m_pool.size();
+    m_options.max_queue_size = std::max<size_t>(1, m_options.max_queue_size);
+}
+
+/**
+ * @brief waits for all the queued images to be written
+ */
+AsyncImageWriter::~AsyncImageWriter()
+{
+    wait();
+}
+
+const AsyncImageWriterOptions& AsyncImageWriter::options() const
+{
+    return m_options;
+}
+
+/**
+ * @brief queues an image to be encoded and written
+ * @param image     the image
+ * @param filepath  path of the file, whose extension selects the format
+ * @param options   encoding options
+ *
+ * The pixels are not copied: @a image must not be modified until it is
+ * written (releasing or reassigning the cv::Mat is fine).
+ * An image larger than the byte limit is accepted when the queue is empty.
+ * Failures are reported in the statistics, not by this function.
+ */
+void AsyncImageWriter::write(const cv::Mat& image,
+                             const std::string& filepath,
+                             const EncodeOptions& options)
+{
+    const size_t bytes = pixel_bytes(image);
+    const auto queued_at = std::chrono::steady_clock::now();
+
+    {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+
+        m_condition.wait(lock,
+                         [&]()
+                         {
+                             return m_queue_size == 0
+                                    || (m_queue_size < m_options.max_queue_size
+                                        && m_queued_bytes + bytes <= m_options.max_queued_bytes);
+                         });
+
+        m_statistics.total_blocked_ms += elapsed_ms(queued_at);
+        ++m_queue_size;
+        m_queued_bytes += bytes;
+    }
+
+    m_pool.submit([this, image, filepath, options, queued_at]()
+                  { process(image, filepath, options, queued_at); });
+}
+
+/**
+ * @brief blocks until all the queued images are written
+ */
+void AsyncImageWriter::wait()
+{
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_condition.wait(lock, [this]() { return m_queue_size == 0; });
+}
+
+/**
+ * @brief returns the number of images queued and not written yet
+ */
+size_t AsyncImageWriter::queue_size() const
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_queue_size;
+}
+
+/**
+ * @brief returns the size of the pixels of the images queued and not written yet
+ */
+size_t AsyncImageWriter::queued_bytes() const
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_queued_bytes;
+}
+
+AsyncImageWriterStatistics AsyncImageWriter::statistics() const
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_statistics;
+}
+
+void AsyncImageWriter::process(const cv::Mat& image,
+                               const std::string& filepath,
+                               const EncodeOptions& options,
+                               std::chrono::steady_clock::time_point queued_at)
+{
+    std::string error;
+    size_t file_size = 0;
+
+    try
+    {
+        const size_t dot = filepath.find_last_of('.');
+        const std::string format =
+          dot == std::string::npos ? std::string() : filepath.substr(dot);
+        std::vector<uchar> buffer = encode_image(image, format, options);
+
+        // a reader (or a crash) never sees a partially written image
+        if (!write_file_atomically(filepath, { { buffer.data(), buffer.size() } }))
+        {
+            throw std::runtime_error("Could not write " + filepath);
+        }
+
+        file_size = buffer.size();
+    }
+    catch (const std::exception& ex)
+    {
+        error = ex.what();
+    }
+
+    const double latency = elapsed_ms(queued_at);
+
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        if (error.empty())
+        {
+            ++m_statistics.nb_written;
+            m_statistics.bytes_written += file_size;
+        }
+        else
+        {
+            ++m_statistics.nb_failed;
+            m_statistics.last_error = error;
+        }
+
+        m_statistics.total_latency_ms += latency;
+        m_statistics.max_latency_ms = std::max(m_statistics.max_latency_ms, latency);
+
+        --m_queue_size;
+        m_queued_bytes -= pixel_bytes(image);
+    }
+
+    m_condition.notify_all();
+}
+
+} // namespace ocvp
@@ -0,0 +1,218 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "mappedfile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ocvp
+{
+
+/**
+ * @brief maps a file in memory
+ * @param path  path of the file
+ * @throw std::runtime_error if the file cannot be opened, is empty or cannot be mapped
+ */
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Could not map " + path);
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+    if (!data)
+    {
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+
+        CloseHandle(file);
+        throw std::runtime_error("Could not map " + path);
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_data = data;
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd == -1)
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+
+    struct stat info;
+
+    if (::fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not map " + path);
+    }
+
+    void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("Could not map " + path);
+    }
+
+    m_data = data;
+    m_size = static_cast<size_t>(info.st_size);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    ::munmap(m_data, m_size);
+#endif
+}
+
+const unsigned char* MappedFile::data() const
+{
+    return static_cast<const unsigned char*>(m_data);
+}
+
+size_t MappedFile::size() const
+{
+    return m_size;
+}
+
+/**
+ * @brief reads the modification time and the size of a file
+ * @param path   path of the file
+ * @param stamp  receives the result
+ * @return whether the file exists
+ */
+bool get_file_stamp(const std::string& path, FileStamp& stamp)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+    {
+        return false;
+    }
+
+    // FILETIME counts intervals of 100 nanoseconds
+    const uint64_t mtime = (uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32)
+                           | info.ftLastWriteTime.dwLowDateTime;
+    stamp.mtime_ns = static_cast<int64_t>(mtime * 100);
+    stamp.size = (uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+#else
+    struct stat info;
+
+    if (::stat(path.c_str(), &info) != 0)
+    {
+        return false;
+    }
+
+#if defined(__APPLE__)
+    const struct timespec& mtime = info.st_mtimespec;
+#else
+    const struct timespec& mtime = info.st_mtim;
+#endif
+
+    stamp.mtime_ns = int64_t(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+    stamp.size = static_cast<uint64_t>(info.st_size);
+#endif
+
+    return true;
+}
+
+/**
+ * @brief writes a file so that readers never see it partially written
+ * @param path    path of the file
+ * @param chunks  content of the file, as a list of (pointer, size) pairs
+ * @return whether the file was written
+ *
+ * The content is written to a temporary file which is then renamed.
+ */
+bool write_file_atomically(const std::string& path,
+                           const std::vector<std::pair<const void*, size_t>>& chunks)
+{
+#ifdef _WIN32
+    const unsigned long pid = GetCurrentProcessId();
+#else
+    const unsigned long pid = static_cast<unsigned long>(::getpid());
+#endif
+
+    const std::string temp_path =
+      path + "." + std::to_string(pid) + "-"
+      + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    {
+        std::ofstream file{ temp_path, std::ios::binary | std::ios::trunc };
+
+        for (const auto& chunk : chunks)
+        {
+            file.write(static_cast<const char*>(chunk.first),
+                       static_cast<std::streamsize>(chunk.second));
+        }
+
+        if (!file)
+        {
+            file.close();
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    bool renamed = MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = std::rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+
+    if (!renamed)
+    {
+        std::remove(temp_path.c_str());
+    }
+
+    return renamed;
+}
+
+} // namespace ocvp
@@ -0,0 +1,67 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief a file mapped read-only in memory
+ */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const unsigned char* data() const;
+    size_t size() const;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+/**
+ * @brief modification time and size of a file, used to detect changes
+ */
+struct FileStamp
+{
+    int64_t mtime_ns = 0;
+    uint64_t size = 0;
+};
+
+inline bool operator==(const FileStamp& lhs, const FileStamp& rhs)
+{
+    return lhs.mtime_ns == rhs.mtime_ns && lhs.size == rhs.size;
+}
+
+inline bool operator!=(const FileStamp& lhs, const FileStamp& rhs)
+{
+    return !(lhs == rhs);
+}
+
+bool get_file_stamp(const std::string& path, FileStamp& stamp);
+
+bool write_file_atomically(const std::string& path,
+                           const std::vector<std::pair<const void*, size_t>>& chunks);
+
+} // namespace ocvp
+
+#endif // MAPPEDFILE_H
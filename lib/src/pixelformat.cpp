@@ -0,0 +1,479 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "pixelformat.h"
+#include "simd.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+using RowKernel = void (*)(const uchar* src, uchar* dst, int width);
+
+// Fixed-point BT.601 weights, scaled by 2^14 (they sum to 2^14).
+constexpr int gray_shift = 14;
+constexpr int gray_b = 1868;
+constexpr int gray_g = 9617;
+constexpr int gray_r = 4899;
+
+inline uchar to_gray(uchar b, uchar g, uchar r)
+{
+    return static_cast<uchar>((gray_b * b + gray_g * g + gray_r * r + (1 << (gray_shift - 1)))
+                              >> gray_shift);
+}
+
+/*
+ * Scalar kernels, also used for the last pixels of a row by the SIMD kernels.
+ * Channels are named after the source format; Swap exchanges channels 0 and 2.
+ */
+
+template<bool Swap>
+void expand_3_to_4(const uchar* src, uchar* dst, int width)
+{
+    for (int x(0); x < width; ++x, src += 3, dst += 4)
+    {
+        dst[0] = src[Swap ? 2 : 0];
+        dst[1] = src[1];
+        dst[2] = src[Swap ? 0 : 2];
+        dst[3] = 255;
+    }
+}
+
+template<bool Swap>
+void compact_4_to_3(const uchar* src, uchar* dst, int width)
+{
+    for (int x(0); x < width; ++x, src += 4, dst += 3)
+    {
+        dst[0] = src[Swap ? 2 : 0];
+        dst[1] = src[1];
+        dst[2] = src[Swap ? 0 : 2];
+    }
+}
+
+void swap_3(const uchar* src, uchar* dst, int width)
+{
+    for (int x(0); x < width; ++x, src += 3, dst += 3)
+    {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+    }
+}
+
+void gray_3(const uchar* src, uchar* dst, int width)
+{
+    for (int x(0); x < width; ++x, src += 3)
+    {
+        dst[x] = to_gray(src[0], src[1], src[2]);
+    }
+}
+
+#ifdef OCVP_X86_SIMD
+
+/*
+ * SSE kernels.
+ * Loads are unaligned and may cover a few bytes past the pixels being
+ * processed; the loop conditions guarantee that these bytes still belong to
+ * the row. Stores of 3-channel data write up to 4 bytes too many, which are
+ * overwritten by the next iteration or by the scalar tail.
+ */
+
+template<bool Swap>
+OCVP_TARGET_SSE41 void expand_3_to_4_sse(const uchar* src, uchar* dst, int width)
+{
+    const __m128i mask = Swap ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                              : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+
+    for (; x + 6 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * x), v);
+    }
+
+    expand_3_to_4<Swap>(src + 3 * x, dst + 4 * x, width - x);
+}
+
+template<bool Swap>
+OCVP_TARGET_SSE41 void compact_4_to_3_sse(const uchar* src, uchar* dst, int width)
+{
+    const __m128i mask = Swap
+                           ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                           : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int x = 0;
+
+    for (; x + 6 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x), _mm_shuffle_epi8(v, mask));
+    }
+
+    compact_4_to_3<Swap>(src + 4 * x, dst + 3 * x, width - x);
+}
+
+OCVP_TARGET_SSE41 void swap_3_sse(const uchar* src, uchar* dst, int width)
+{
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+    int x = 0;
+
+    for (; x + 6 <= width; x += 5)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * x), _mm_shuffle_epi8(v, mask));
+    }
+
+    swap_3(src + 3 * x, dst + 3 * x, width - x);
+}
+
+OCVP_TARGET_SSE41 inline __m128i gray_weights_sse()
+{
+    return _mm_setr_epi16(gray_b, gray_g, gray_r, 0, gray_b, gray_g, gray_r, 0);
+}
+
+OCVP_TARGET_SSE41 void gray_3_sse(const uchar* src, uchar* dst, int width)
+{
+    // pixels 0-1 and 2-3 of a 12-byte group, widened to 16 bits as (B, G, R, 0)
+    const __m128i lo_mask = _mm_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1);
+    const __m128i hi_mask
+      = _mm_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1);
+    const __m128i weights = gray_weights_sse();
+    const __m128i rounding = _mm_set1_epi32(1 << (gray_shift - 1));
+
+    int x = 0;
+
+    for (; x + 6 <= width; x += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x));
+        __m128i lo = _mm_madd_epi16(_mm_shuffle_epi8(v, lo_mask), weights);
+        __m128i hi = _mm_madd_epi16(_mm_shuffle_epi8(v, hi_mask), weights);
+        __m128i sum = _mm_add_epi32(_mm_hadd_epi32(lo, hi), rounding);
+        sum = _mm_srli_epi32(sum, gray_shift);
+        sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), sum);
+        int packed = _mm_cvtsi128_si32(sum);
+        std::memcpy(dst + x, &packed, 4);
+    }
+
+    gray_3(src + 3 * x, dst + x, width - x);
+}
+
+/*
+ * AVX2 kernels.
+ * _mm256_shuffle_epi8 works within 128-bit lanes, so 3-channel data is
+ * loaded (or stored) as two overlapping 16-byte halves.
+ */
+
+OCVP_TARGET_AVX2 inline __m256i load_halves(const uchar* lo, const uchar* hi)
+{
+    return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lo))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi)),
+      1);
+}
+
+OCVP_TARGET_AVX2 inline void store_halves(uchar* lo, uchar* hi, __m256i v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lo), _mm256_castsi256_si128(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(hi), _mm256_extracti128_si256(v, 1));
+}
+
+template<bool Swap>
+OCVP_TARGET_AVX2 void expand_3_to_4_avx2(const uchar* src, uchar* dst, int width)
+{
+    const __m256i mask = _mm256_broadcastsi128_si256(
+      Swap ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+           : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+    int x = 0;
+
+    for (; x + 10 <= width; x += 8)
+    {
+        __m256i v = load_halves(src + 3 * x, src + 3 * x + 12);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alpha);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4 * x), v);
+    }
+
+    expand_3_to_4<Swap>(src + 3 * x, dst + 4 * x, width - x);
+}
+
+template<bool Swap>
+OCVP_TARGET_AVX2 void compact_4_to_3_avx2(const uchar* src, uchar* dst, int width)
+{
+    const __m256i mask = _mm256_broadcastsi128_si256(
+      Swap ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+           : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+
+    int x = 0;
+
+    for (; x + 10 <= width; x += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4 * x));
+        store_halves(dst + 3 * x, dst + 3 * x + 12, _mm256_shuffle_epi8(v, mask));
+    }
+
+    compact_4_to_3<Swap>(src + 4 * x, dst + 3 * x, width - x);
+}
+
+OCVP_TARGET_AVX2 void swap_3_avx2(const uchar* src, uchar* dst, int width)
+{
+    const __m256i mask = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15));
+
+    int x = 0;
+
+    for (; x + 11 <= width; x += 10)
+    {
+        __m256i v = load_halves(src + 3 * x, src + 3 * x + 15);
+        store_halves(dst + 3 * x, dst + 3 * x + 15, _mm256_shuffle_epi8(v, mask));
+    }
+
+    swap_3(src + 3 * x, dst + 3 * x, width - x);
+}
+
+OCVP_TARGET_AVX2 void gray_3_avx2(const uchar* src, uchar* dst, int width)
+{
+    const __m256i lo_mask = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1));
+    const __m256i hi_mask = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1));
+    const __m256i weights = _mm256_setr_epi16(gray_b,
+                                              gray_g,
+                                              gray_r,
+                                              0,
+                                              gray_b,
+                                              gray_g,
+                                              gray_r,
+                                              0,
+                                              gray_b,
+                                              gray_g,
+                                              gray_r,
+                                              0,
+                                              gray_b,
+                                              gray_g,
+                                              gray_r,
+                                              0);
+    const __m256i rounding = _mm256_set1_epi32(1 << (gray_shift - 1));
+
+    int x = 0;
+
+    for (; x + 10 <= width; x += 8)
+    {
+        __m256i v = load_halves(src + 3 * x, src + 3 * x + 12);
+        __m256i lo = _mm256_madd_epi16(_mm256_shuffle_epi8(v, lo_mask), weights);
+        __m256i hi = _mm256_madd_epi16(_mm256_shuffle_epi8(v, hi_mask), weights);
+        __m256i sum = _mm256_add_epi32(_mm256_hadd_epi32(lo, hi), rounding);
+        sum = _mm256_srli_epi32(sum, gray_shift);
+        sum = _mm256_packus_epi16(_mm256_packs_epi32(sum, sum), sum);
+        int packed[2] = { _mm_cvtsi128_si32(_mm256_castsi256_si128(sum)),
+                          _mm_cvtsi128_si32(_mm256_extracti128_si256(sum, 1)) };
+        std::memcpy(dst + x, packed, 8);
+    }
+
+    gray_3(src + 3 * x, dst + x, width - x);
+}
+
+#endif // OCVP_X86_SIMD
+
+struct ConversionInfo
+{
+    int src_type;
+    int dst_type;
+    RowKernel kernels[3]; ///< indexed by SimdLevel, null if not available
+};
+
+ConversionInfo get_conversion_info(PixelConversion conversion)
+{
+    switch (conversion)
+    {
+    case PixelConversion::BGR_TO_RGB32:
+        return { CV_8UC3,
+                 CV_8UC4,
+                 { &expand_3_to_4<false>,
+                   OCVP_SIMD_KERNEL(expand_3_to_4_sse<false>),
+                   OCVP_SIMD_KERNEL(expand_3_to_4_avx2<false>) } };
+    case PixelConversion::RGB32_TO_BGR:
+        return { CV_8UC4,
+                 CV_8UC3,
+                 { &compact_4_to_3<false>,
+                   OCVP_SIMD_KERNEL(compact_4_to_3_sse<false>),
+                   OCVP_SIMD_KERNEL(compact_4_to_3_avx2<false>) } };
+    case PixelConversion::BGR_TO_RGBA:
+        return { CV_8UC3,
+                 CV_8UC4,
+                 { &expand_3_to_4<true>,
+                   OCVP_SIMD_KERNEL(expand_3_to_4_sse<true>),
+                   OCVP_SIMD_KERNEL(expand_3_to_4_avx2<true>) } };
+    case PixelConversion::RGBA_TO_BGR:
+        return { CV_8UC4,
+                 CV_8UC3,
+                 { &compact_4_to_3<true>,
+                   OCVP_SIMD_KERNEL(compact_4_to_3_sse<true>),
+                   OCVP_SIMD_KERNEL(compact_4_to_3_avx2<true>) } };
+    case PixelConversion::BGR_TO_GRAY:
+        return { CV_8UC3,
+                 CV_8UC1,
+                 { &gray_3, OCVP_SIMD_KERNEL(gray_3_sse), OCVP_SIMD_KERNEL(gray_3_avx2) } };
+    case PixelConversion::RGB_TO_BGR:
+        return { CV_8UC3,
+                 CV_8UC3,
+                 { &swap_3, OCVP_SIMD_KERNEL(swap_3_sse), OCVP_SIMD_KERNEL(swap_3_avx2) } };
+    }
+
+    throw std::runtime_error("Unknown pixel conversion");
+}
+
+ConversionInfo prepare_conversion(const cv::Mat& src, cv::Mat& dst, PixelConversion conversion)
+{
+    ConversionInfo info = get_conversion_info(conversion);
+
+    if (src.type() != info.src_type || src.dims != 2)
+    {
+        throw std::runtime_error("Source image has the wrong type for this pixel conversion");
+    }
+
+    if (src.data == dst.data && !src.empty())
+    {
+        throw std::runtime_error("Pixel conversions cannot be performed in place");
+    }
+
+    dst.create(src.size(), info.dst_type);
+
+    return info;
+}
+
+} // namespace
+
+/**
+ * @brief returns the best instruction set supported by the CPU
+ *
+ * The detection is performed by OpenCV at runtime, so that the library can be
+ * built for a generic x86-64 target and still use AVX2 where available.
+ */
+SimdLevel best_simd_level()
+{
+#ifdef OCVP_X86_SIMD
+    static const SimdLevel level = cv::checkHardwareSupport(CV_CPU_AVX2)     ? SimdLevel::AVX2
+                                   : cv::checkHardwareSupport(CV_CPU_SSE4_1) ? SimdLevel::SSE41
+                                                                             : SimdLevel::None;
+    return level;
+#else
+    return SimdLevel::None;
+#endif
+}
+
+/**
+ * @brief converts the pixel format of an image
+ * @param src         the source image
+ * @param dst         the destination image, (re)allocated if needed
+ * @param conversion  the conversion
+ * @param max_level   highest instruction set that may be used
+ * @throw std::runtime_error if @a src does not have the expected type
+ *
+ * Rows are split among OpenCV's worker threads and each row is processed by a
+ * SIMD kernel chosen at runtime; the output is byte-for-byte identical to the
+ * output of convert_pixels_reference().
+ */
+void convert_pixels(const cv::Mat& src,
+                    cv::Mat& dst,
+                    PixelConversion conversion,
+                    SimdLevel max_level)
+{
+    ConversionInfo info = prepare_conversion(src, dst, conversion);
+
+    int level = static_cast<int>(std::min(max_level, best_simd_level()));
+
+    while (!info.kernels[level])
+    {
+        --level;
+    }
+
+    RowKernel kernel = info.kernels[level];
+    const int width = src.cols;
+
+    // roughly 64K pixels per stripe, so that small images stay single-threaded
+    const double nstripes = std::max(1.0, static_cast<double>(src.total()) / (1 << 16));
+
+    cv::parallel_for_(
+      cv::Range(0, src.rows),
+      [&](const cv::Range& range)
+      {
+          for (int y = range.start; y < range.end; ++y)
+          {
+              kernel(src.ptr<uchar>(y), dst.ptr<uchar>(y), width);
+          }
+      },
+      nstripes);
+}
+
+/**
+ * @brief converts the pixel format of an image, one pixel at a time
+ *
+ * This straightforward implementation defines the expected output of
+ * convert_pixels() and serves as a baseline when measuring it.
+ */
+void convert_pixels_reference(const cv::Mat& src, cv::Mat& dst, PixelConversion conversion)
+{
+    prepare_conversion(src, dst, conversion);
+
+    for (int y(0); y < src.rows; ++y)
+    {
+        for (int x(0); x < src.cols; ++x)
+        {
+            switch (conversion)
+            {
+            case PixelConversion::BGR_TO_RGB32:
+            {
+                const cv::Vec3b& p = src.at<cv::Vec3b>(y, x);
+                dst.at<cv::Vec4b>(y, x) = cv::Vec4b(p[0], p[1], p[2], 255);
+                break;
+            }
+            case PixelConversion::RGB32_TO_BGR:
+            {
+                const cv::Vec4b& p = src.at<cv::Vec4b>(y, x);
+                dst.at<cv::Vec3b>(y, x) = cv::Vec3b(p[0], p[1], p[2]);
+                break;
+            }
+            case PixelConversion::BGR_TO_RGBA:
+            {
+                const cv::Vec3b& p = src.at<cv::Vec3b>(y, x);
+                dst.at<cv::Vec4b>(y, x) = cv::Vec4b(p[2], p[1], p[0], 255);
+                break;
+            }
+            case PixelConversion::RGBA_TO_BGR:
+            {
+                const cv::Vec4b& p = src.at<cv::Vec4b>(y, x);
+                dst.at<cv::Vec3b>(y, x) = cv::Vec3b(p[2], p[1], p[0]);
+                break;
+            }
+            case PixelConversion::BGR_TO_GRAY:
+            {
+                const cv::Vec3b& p = src.at<cv::Vec3b>(y, x);
+                dst.at<uchar>(y, x) = to_gray(p[0], p[1], p[2]);
+                break;
+            }
+            case PixelConversion::RGB_TO_BGR:
+            {
+                const cv::Vec3b& p = src.at<cv::Vec3b>(y, x);
+                dst.at<cv::Vec3b>(y, x) = cv::Vec3b(p[2], p[1], p[0]);
+                break;
+            }
+            }
+        }
+    }
+}
+
+} // namespace ocvp
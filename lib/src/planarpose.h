@@ -0,0 +1,82 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef PLANARPOSE_H
+#define PLANARPOSE_H
+
+#include <opencv2/core/matx.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ocvp
+{
+
+// Solves a * x = b by Gaussian elimination with partial pivoting.
+// Returns false if the matrix is singular.
+template<int N>
+bool solve_linear_system(cv::Matx<double, N, N> a, cv::Vec<double, N> b, cv::Vec<double, N>& x)
+{
+    for (int col(0); col < N; ++col)
+    {
+        int pivot = col;
+
+        for (int row(col + 1); row < N; ++row)
+        {
+            if (std::abs(a(row, col)) > std::abs(a(pivot, col)))
+            {
+                pivot = row;
+            }
+        }
+
+        if (!(std::abs(a(pivot, col)) > 1e-300))
+        {
+            return false;
+        }
+
+        if (pivot != col)
+        {
+            for (int k(col); k < N; ++k)
+            {
+                std::swap(a(pivot, k), a(col, k));
+            }
+
+            std::swap(b[pivot], b[col]);
+        }
+
+        for (int row(col + 1); row < N; ++row)
+        {
+            const double factor = a(row, col) / a(col, col);
+
+            for (int k(col); k < N; ++k)
+            {
+                a(row, k) -= factor * a(col, k);
+            }
+
+            b[row] -= factor * b[col];
+        }
+    }
+
+    for (int row(N - 1); row >= 0; --row)
+    {
+        double sum = b[row];
+
+        for (int k(row + 1); k < N; ++k)
+        {
+            sum -= a(row, k) * x[k];
+        }
+
+        x[row] = sum / a(row, row);
+    }
+
+    return true;
+}
+
+bool decompose_homography(const cv::Matx33d& homography,
+                          cv::Matx33d& rotation,
+                          cv::Vec3d& tvec);
+
+} // namespace ocvp
+
+#endif // PLANARPOSE_H
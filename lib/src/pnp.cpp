@@ -4,33 +4,33 @@
 
 #include "pnp.h"
 
+#include "planarpose.h"
+
 #include <opencv2/calib3d.hpp>
 #include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 namespace ocvp
 {
 
-/**
- * @brief solves a PnP pose computation problem given the coordinates of a sheet of paper
- * @param a4sheet     coordinates of a A4 sheet on a picture
- * @param intrinsics  camera intrinsic parameters
- * @param distortion  distortion coefficients
- * @return a struct containing the rotation and translation vectors
- * @throw std::runtime_error if OpenCV fails at solving the problem
- *
- * @sa cv::solvePnP
- * (https://docs.opencv.org/4.x/d9/d0c/group__calib3d.html#ga549c2075fac14829ff4a58bc931c033d)
- */
+namespace
+{
+
 PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
+                    const PlanarTarget& target,
                     const CameraIntrinsics& intrinsics,
-                    const DistortionCoefficients& distortion)
+                    const DistortionCoefficients& distortion,
+                    PnPResult result,
+                    bool use_extrinsic_guess)
 {
     std::vector<cv::Point3d> object_points{ cv::Point3d(0, 0, 0),
-                                            cv::Point3d(0.21, 0, 0),
-                                            cv::Point3d(0.21, 0.297, 0),
-                                            cv::Point3d(0, 0.297, 0) };
+                                            cv::Point3d(target.width, 0, 0),
+                                            cv::Point3d(target.width, target.height, 0),
+                                            cv::Point3d(0, target.height, 0) };
 
     std::vector<cv::Point2d> image_points{ cv::Point2d(a4sheet.bottom_left),
                                            cv::Point2d(a4sheet.bottom_right),
@@ -40,12 +40,13 @@ PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
     cv::Mat camera_matrix = make_camera_matrix(intrinsics);
     std::vector<double> dist_coeffs = make_distcoeffs_vector(distortion);
 
-    PnPResult result;
-    result.rvec = cv::Mat::zeros(3, 1, CV_64FC1);
-    result.tvec = cv::Mat::zeros(3, 1, CV_64FC1);
-
-    bool problem_solved = cv::solvePnP(
-      object_points, image_points, camera_matrix, dist_coeffs, result.rvec, result.tvec);
+    bool problem_solved = cv::solvePnP(object_points,
+                                       image_points,
+                                       camera_matrix,
+                                       dist_coeffs,
+                                       result.rvec,
+                                       result.tvec,
+                                       use_extrinsic_guess);
 
     if (!problem_solved)
     {
@@ -55,6 +56,70 @@ PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
     return result;
 }
 
+} // namespace
+
+/**
+ * @brief solves a PnP pose computation problem given the coordinates of a sheet of paper
+ * @param a4sheet     coordinates of a A4 sheet on a picture
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ * @return a struct containing the rotation and translation vectors
+ * @throw std::runtime_error if OpenCV fails at solving the problem
+ *
+ * @sa cv::solvePnP
+ * (https://docs.opencv.org/4.x/d9/d0c/group__calib3d.html#ga549c2075fac14829ff4a58bc931c033d)
+ */
+PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
+                    const CameraIntrinsics& intrinsics,
+                    const DistortionCoefficients& distortion)
+{
+    PnPResult result;
+    result.rvec = cv::Mat::zeros(3, 1, CV_64FC1);
+    result.tvec = cv::Mat::zeros(3, 1, CV_64FC1);
+    return solve_pnp(a4sheet, A4Target(), intrinsics, distortion, result, false);
+}
+
+/**
+ * @brief solves a PnP pose computation problem for a target of any size
+ * @param corners     coordinates of the corners of the target on a picture
+ * @param target      size of the target
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ * @throw std::runtime_error if OpenCV fails at solving the problem
+ */
+PnPResult solve_pnp(const TargetCorners& corners,
+                    const PlanarTarget& target,
+                    const CameraIntrinsics& intrinsics,
+                    const DistortionCoefficients& distortion)
+{
+    PnPResult result;
+    result.rvec = cv::Mat::zeros(3, 1, CV_64FC1);
+    result.tvec = cv::Mat::zeros(3, 1, CV_64FC1);
+    return solve_pnp(corners, target, intrinsics, distortion, result, false);
+}
+
+/**
+ * @brief solves a PnP pose computation problem starting from a known pose
+ * @param a4sheet        coordinates of a A4 sheet on a picture
+ * @param intrinsics     camera intrinsic parameters
+ * @param distortion     distortion coefficients
+ * @param initial_guess  an approximation of the pose, e.g. from the previous frame
+ * @throw std::runtime_error if OpenCV fails at solving the problem
+ *
+ * This calls cv::solvePnP() with useExtrinsicGuess set to true.
+ * @sa PoseTracker
+ */
+PnPResult solve_pnp(const A4SheetOfPaper& a4sheet,
+                    const CameraIntrinsics& intrinsics,
+                    const DistortionCoefficients& distortion,
+                    const PnPResult& initial_guess)
+{
+    PnPResult result;
+    initial_guess.rvec.convertTo(result.rvec, CV_64F);
+    initial_guess.tvec.convertTo(result.tvec, CV_64F);
+    return solve_pnp(a4sheet, A4Target(), intrinsics, distortion, result, true);
+}
+
 /**
  * @brief saves the result of solve_pnp() in a json file
  * @param filepath  path to the json file (must include the .json extension)
@@ -114,4 +179,765 @@ cv::Mat compute_camera_position(const cv::Mat& rvec, const cv::Mat& tvec)
     return pos;
 }
 
+/**
+ * @brief decomposes a homography H = lambda * K^-1 * [ r1 r2 t ] with K the identity
+ * @param homography  maps the plane of the target to normalized image coordinates
+ * @param rotation    receives the rotation matrix [ r1 r2 r1 x r2 ]
+ * @param tvec        receives the translation
+ *
+ * The homography must be scaled so that the third coordinate of the image
+ * of the points of the target is positive (e.g. h33 = 1 if the origin of
+ * the target is visible): a positive lambda then puts the target in front
+ * of the camera.
+ */
+bool decompose_homography(const cv::Matx33d& homography,
+                          cv::Matx33d& rotation,
+                          cv::Vec3d& tvec)
+{
+    const cv::Vec3d h1{ homography(0, 0), homography(1, 0), homography(2, 0) };
+    const cv::Vec3d h2{ homography(0, 1), homography(1, 1), homography(2, 1) };
+    const cv::Vec3d h3{ homography(0, 2), homography(1, 2), homography(2, 2) };
+
+    const double norm1 = cv::norm(h1);
+    const double norm2 = cv::norm(h2);
+
+    if (!(norm1 > 0 && norm2 > 0))
+    {
+        return false;
+    }
+
+    const double lambda = 2 / (norm1 + norm2);
+
+    // r1 and r2 are only approximately orthogonal: they are made orthogonal
+    // by spreading the correction evenly between them
+    const cv::Vec3d u1 = h1 / norm1;
+    const cv::Vec3d u2 = h2 / norm2;
+    cv::Vec3d bisector = u1 + u2;
+    cv::Vec3d difference = u1 - u2;
+    const double bisector_norm = cv::norm(bisector);
+    const double difference_norm = cv::norm(difference);
+
+    if (!(bisector_norm > 0 && difference_norm > 0))
+    {
+        return false;
+    }
+
+    bisector /= bisector_norm * std::sqrt(2.0);
+    difference /= difference_norm * std::sqrt(2.0);
+    const cv::Vec3d r1 = bisector + difference;
+    const cv::Vec3d r2 = bisector - difference;
+    const cv::Vec3d r3 = r1.cross(r2);
+
+    rotation = cv::Matx33d(r1[0], r2[0], r3[0], r1[1], r2[1], r3[1], r1[2], r2[2], r3[2]);
+    tvec = h3 * lambda;
+    return true;
+}
+
+namespace
+{
+
+/*
+ * The solver is written for any Target type with a width and a height:
+ * PlanarTarget, whose size is only known at runtime, and the
+ * FixedPlanarTarget of the standard sizes, for which the geometry below is
+ * constant.
+ */
+
+// Coordinates of a corner of the target in the world coordinate system, in
+// the order of TargetCorners: bottom-left, bottom-right, top-right, top-left.
+template<typename Target>
+inline double object_x(const Target& target, int corner)
+{
+    return corner == 1 || corner == 2 ? target.width : 0;
+}
+
+template<typename Target>
+inline double object_y(const Target& target, int corner)
+{
+    return corner >= 2 ? target.height : 0;
+}
+
+// Calls f with the FixedPlanarTarget of the target if it has a standard size
+template<typename F>
+auto with_fixed_target(const PlanarTarget& target, F&& f) -> decltype(f(target))
+{
+    if (target == A4Target())
+    {
+        return f(A4Target());
+    }
+    else if (target == LetterTarget())
+    {
+        return f(LetterTarget());
+    }
+    else if (target == A3Target())
+    {
+        return f(A3Target());
+    }
+
+    return f(target);
+}
+
+double& pose_parameter(Pose& pose, int i)
+{
+    return i < 3 ? pose.rvec[i] : pose.tvec[i - 3];
+}
+
+// Computes the homography mapping the plane of the target to the (normalized)
+// image coordinates of its corners.
+// Since the target is a rectangle, the homography is that of the unit square
+// (which has a closed-form expression, see P. Heckbert, "Fundamentals of
+// Texture Mapping and Image Warping", 1989) scaled by the size of the target.
+template<typename Target>
+bool compute_homography(const Target& target,
+                        const cv::Point2d (&corners)[4],
+                        cv::Matx33d& homography)
+{
+    const double inv_width = 1 / target.width;
+    const double inv_height = 1 / target.height;
+
+    const cv::Point2d& p0 = corners[0];
+    const cv::Point2d& p1 = corners[1];
+    const cv::Point2d& p2 = corners[2];
+    const cv::Point2d& p3 = corners[3];
+
+    const cv::Point2d sum = p0 - p1 + p2 - p3;
+    const cv::Point2d d1 = p1 - p2;
+    const cv::Point2d d2 = p3 - p2;
+    const double det = d1.x * d2.y - d2.x * d1.y;
+
+    if (!(std::abs(det) > 0))
+    {
+        return false;
+    }
+
+    const double g = (sum.x * d2.y - d2.x * sum.y) / det;
+    const double h = (d1.x * sum.y - sum.x * d1.y) / det;
+
+    homography = cv::Matx33d((p1.x - p0.x + g * p1.x) * inv_width,
+                             (p3.x - p0.x + h * p3.x) * inv_height,
+                             p0.x,
+                             (p1.y - p0.y + g * p1.y) * inv_width,
+                             (p3.y - p0.y + h * p3.y) * inv_height,
+                             p0.y,
+                             g * inv_width,
+                             h * inv_height,
+                             1);
+    return true;
+}
+
+// Performs a Gauss-Newton step minimizing the distances (scaled by the focal
+// lengths) between the projections of the corners and their undistorted
+// coordinates.
+// The rotation is updated as R <- exp([w]x) * R, which gives the Jacobian
+// d(R * X + t) / dw = -[R * X]x.
+template<typename Target>
+bool refine_pose_gauss_newton(const Target& target,
+                              const cv::Point2d (&normalized)[4],
+                              double fx,
+                              double fy,
+                              cv::Matx33d& rotation,
+                              cv::Vec3d& tvec)
+{
+    cv::Matx<double, 6, 6> jtj;
+    cv::Vec<double, 6> jtr;
+
+    for (int i(0); i < 4; ++i)
+    {
+        const cv::Vec3d rx = cv::Vec3d(rotation(0, 0), rotation(1, 0), rotation(2, 0))
+                               * object_x(target, i)
+                             + cv::Vec3d(rotation(0, 1), rotation(1, 1), rotation(2, 1))
+                                 * object_y(target, i);
+        const cv::Vec3d p = rx + tvec;
+
+        if (!(p[2] > 0))
+        {
+            return false;
+        }
+
+        const double iz = 1 / p[2];
+        const double x = p[0] * iz;
+        const double y = p[1] * iz;
+
+        // d(residual) / d(p)
+        const double du[3] = { fx * iz, 0, -fx * x * iz };
+        const double dv[3] = { 0, fy * iz, -fy * y * iz };
+
+        // d(p) / d(w) = -[rx]x, d(p) / d(t) = I
+        const double dp_dw[3][3] = { { 0, rx[2], -rx[1] },
+                                     { -rx[2], 0, rx[0] },
+                                     { rx[1], -rx[0], 0 } };
+
+        double ju[6];
+        double jv[6];
+
+        for (int j(0); j < 3; ++j)
+        {
+            ju[j] = du[0] * dp_dw[0][j] + du[1] * dp_dw[1][j] + du[2] * dp_dw[2][j];
+            jv[j] = dv[0] * dp_dw[0][j] + dv[1] * dp_dw[1][j] + dv[2] * dp_dw[2][j];
+            ju[j + 3] = du[j];
+            jv[j + 3] = dv[j];
+        }
+
+        const double ru = fx * (x - normalized[i].x);
+        const double rv = fy * (y - normalized[i].y);
+
+        for (int j(0); j < 6; ++j)
+        {
+            for (int k(j); k < 6; ++k)
+            {
+                jtj(j, k) += ju[j] * ju[k] + jv[j] * jv[k];
+            }
+
+            jtr[j] += ju[j] * ru + jv[j] * rv;
+        }
+    }
+
+    for (int j(0); j < 6; ++j)
+    {
+        for (int k(0); k < j; ++k)
+        {
+            jtj(j, k) = jtj(k, j);
+        }
+    }
+
+    cv::Vec<double, 6> delta;
+
+    if (!solve_linear_system(jtj, -jtr, delta))
+    {
+        return false;
+    }
+
+    rotation = get_rotation_matrix(cv::Vec3d(delta[0], delta[1], delta[2])) * rotation;
+    tvec += cv::Vec3d(delta[3], delta[4], delta[5]);
+    return true;
+}
+
+template<typename Target>
+void compute_residuals(const Target& target,
+                       const CameraModel& camera,
+                       const cv::Point2d (&image_points)[4],
+                       const Pose& pose,
+                       cv::Vec<double, 8>& residuals)
+{
+    const cv::Matx33d rotation = get_rotation_matrix(pose.rvec);
+
+    for (int i(0); i < 4; ++i)
+    {
+        const cv::Vec3d object_point{ object_x(target, i), object_y(target, i), 0 };
+        const cv::Point2d p = project_point(camera, rotation, pose.tvec, object_point);
+        residuals[2 * i] = p.x - image_points[i].x;
+        residuals[2 * i + 1] = p.y - image_points[i].y;
+    }
+}
+
+// Minimizes the reprojection error with the Levenberg-Marquardt algorithm,
+// like the iterative method of cv::solvePnP() does.
+template<typename Target>
+void refine_pose(const Target& target,
+                 const CameraModel& camera,
+                 const cv::Point2d (&image_points)[4],
+                 Pose& pose)
+{
+    constexpr int max_iterations = 30;
+    constexpr double step = 1e-6;
+
+    cv::Vec<double, 8> residuals;
+    compute_residuals(target, camera, image_points, pose, residuals);
+    double error = residuals.dot(residuals);
+    double damping = 1e-3;
+
+    for (int iteration(0); iteration < max_iterations && error > 0; ++iteration)
+    {
+        cv::Matx<double, 8, 6> jacobian;
+
+        for (int j(0); j < 6; ++j)
+        {
+            Pose forward = pose;
+            Pose backward = pose;
+            pose_parameter(forward, j) += step;
+            pose_parameter(backward, j) -= step;
+
+            cv::Vec<double, 8> r_forward;
+            cv::Vec<double, 8> r_backward;
+            compute_residuals(target, camera, image_points, forward, r_forward);
+            compute_residuals(target, camera, image_points, backward, r_backward);
+
+            for (int i(0); i < 8; ++i)
+            {
+                jacobian(i, j) = (r_forward[i] - r_backward[i]) / (2 * step);
+            }
+        }
+
+        const cv::Matx<double, 6, 6> jtj = jacobian.t() * jacobian;
+        const cv::Vec<double, 6> jtr = jacobian.t() * residuals;
+
+        bool improved = false;
+
+        while (!improved && damping < 1e10)
+        {
+            cv::Matx<double, 6, 6> a = jtj;
+
+            for (int j(0); j < 6; ++j)
+            {
+                a(j, j) *= 1 + damping;
+            }
+
+            cv::Vec<double, 6> delta;
+
+            if (!solve_linear_system(a, -jtr, delta))
+            {
+                damping *= 10;
+                continue;
+            }
+
+            Pose candidate = pose;
+
+            for (int j(0); j < 6; ++j)
+            {
+                pose_parameter(candidate, j) += delta[j];
+            }
+
+            cv::Vec<double, 8> candidate_residuals;
+            compute_residuals(target, camera, image_points, candidate, candidate_residuals);
+            const double candidate_error = candidate_residuals.dot(candidate_residuals);
+
+            if (candidate_error < error)
+            {
+                const bool converged = error - candidate_error < 1e-12 * error;
+                pose = candidate;
+                residuals = candidate_residuals;
+                error = candidate_error;
+                damping = std::max(damping / 10, 1e-12);
+                improved = !converged;
+
+                if (converged)
+                {
+                    return;
+                }
+            }
+            else
+            {
+                damping *= 10;
+            }
+        }
+
+        if (!improved)
+        {
+            break;
+        }
+    }
+}
+
+// Whether the corners, in order, turn consistently in the same direction
+bool is_convex_quadrilateral(const cv::Point2d (&corners)[4])
+{
+    int nb_positive = 0;
+    int nb_negative = 0;
+
+    for (int i(0); i < 4; ++i)
+    {
+        const cv::Point2d u = corners[(i + 1) % 4] - corners[i];
+        const cv::Point2d v = corners[(i + 2) % 4] - corners[(i + 1) % 4];
+        const double cross = u.x * v.y - u.y * v.x;
+        nb_positive += cross > 0 ? 1 : 0;
+        nb_negative += cross < 0 ? 1 : 0;
+    }
+
+    return nb_positive == 4 || nb_negative == 4;
+}
+
+template<typename Target>
+bool solve_planar_closed_form(const TargetCorners& corners,
+                              const Target& target,
+                              const CameraModel& camera,
+                              Pose& pose,
+                              int refinement_steps)
+{
+    const cv::Point2d normalized[4] = {
+        undistort_point(camera, cv::Point2d(corners.bottom_left)),
+        undistort_point(camera, cv::Point2d(corners.bottom_right)),
+        undistort_point(camera, cv::Point2d(corners.top_right)),
+        undistort_point(camera, cv::Point2d(corners.top_left)),
+    };
+
+    cv::Matx33d homography;
+    cv::Matx33d rotation;
+    cv::Vec3d tvec;
+
+    if (!compute_homography(target, normalized, homography)
+        || !decompose_homography(homography, rotation, tvec))
+    {
+        return false;
+    }
+
+    const double fx = camera.camera_matrix(0, 0);
+    const double fy = camera.camera_matrix(1, 1);
+
+    for (int i(0); i < refinement_steps; ++i)
+    {
+        if (!refine_pose_gauss_newton(target, normalized, fx, fy, rotation, tvec))
+        {
+            return false;
+        }
+    }
+
+    pose.rvec = get_rotation_vector(rotation);
+    pose.tvec = tvec;
+
+    return std::isfinite(pose.rvec.dot(pose.rvec)) && std::isfinite(pose.tvec.dot(pose.tvec));
+}
+
+template<typename Target>
+bool solve_planar(const TargetCorners& corners,
+                  const Target& target,
+                  const CameraModel& camera,
+                  Pose& pose)
+{
+    const cv::Point2d image_points[4] = { cv::Point2d(corners.bottom_left),
+                                          cv::Point2d(corners.bottom_right),
+                                          cv::Point2d(corners.top_right),
+                                          cv::Point2d(corners.top_left) };
+
+    if (!solve_planar_closed_form(corners, target, camera, pose, 1))
+    {
+        return false;
+    }
+
+    refine_pose(target, camera, image_points, pose);
+
+    return std::isfinite(pose.rvec.dot(pose.rvec)) && std::isfinite(pose.tvec.dot(pose.tvec));
+}
+
+} // namespace
+
+/**
+ * @brief converts a PnPResult to a Pose
+ * @param result
+ */
+Pose to_pose(const PnPResult& result)
+{
+    Pose pose;
+
+    for (int i(0); i < 3; ++i)
+    {
+        pose.rvec[i] = result.rvec.at<double>(i);
+        pose.tvec[i] = result.tvec.at<double>(i);
+    }
+
+    return pose;
+}
+
+/**
+ * @brief converts a Pose to a PnPResult
+ * @param pose
+ */
+PnPResult to_pnp_result(const Pose& pose)
+{
+    PnPResult result;
+    result.rvec = cv::Mat(pose.rvec, true);
+    result.tvec = cv::Mat(pose.tvec, true);
+    return result;
+}
+
+/**
+ * @brief solves a PnP pose computation problem without allocating memory
+ * @param a4sheet  coordinates of a A4 sheet on a picture
+ * @param camera   the camera model, see make_camera_model()
+ * @param pose     receives the rotation and translation vectors
+ * @return whether the problem could be solved
+ *
+ * cv::solvePnP() allocates memory internally, so this function implements
+ * its own solver using only fixed-size types: the pose is initialized by
+ * solve_pnp_a4(), then refined by minimizing the reprojection error
+ * (Levenberg-Marquardt), which is what the default method of cv::solvePnP()
+ * does for planar objects.
+ */
+bool solve_pnp(const A4SheetOfPaper& a4sheet, const CameraModel& camera, Pose& pose)
+{
+    return solve_planar(a4sheet, A4Target(), camera, pose);
+}
+
+/**
+ * @brief solves a PnP pose computation problem for a target of any size
+ * @param corners  coordinates of the corners of the target on a picture
+ * @param target   size of the target
+ * @param camera   the camera model, see make_camera_model()
+ * @param pose     receives the rotation and translation vectors
+ * @return whether the problem could be solved
+ *
+ * Same solver as solve_pnp(const A4SheetOfPaper&, const CameraModel&, Pose&).
+ * Targets of a standard size (see find_standard_target()) are solved by
+ * code specialized for their size, whichever way they were obtained.
+ */
+bool solve_pnp(const TargetCorners& corners,
+               const PlanarTarget& target,
+               const CameraModel& camera,
+               Pose& pose)
+{
+    return with_fixed_target(target,
+                             [&](const auto& t) { return solve_planar(corners, t, camera, pose); });
+}
+
+/**
+ * @brief closed-form solver specialized for the four corners of a A4 sheet
+ * @param a4sheet            coordinates of a A4 sheet on a picture
+ * @param camera             the camera model, see make_camera_model()
+ * @param pose               receives the rotation and translation vectors
+ * @param refinement_steps   number of Gauss-Newton steps
+ * @return whether the problem could be solved
+ *
+ * The corners are undistorted once, the homography between the sheet and
+ * the image is computed analytically and decomposed into a pose, which is
+ * then optionally refined by a few Gauss-Newton steps.
+ * Refinement minimizes the error on the undistorted corners (scaled by the
+ * focal lengths), so that the distortion model is not evaluated again.
+ *
+ * Without refinement, the pose is only exact for noise-free corners; one or
+ * two steps are usually enough to reach the accuracy of cv::solvePnP().
+ */
+bool solve_pnp_a4(const A4SheetOfPaper& a4sheet,
+                  const CameraModel& camera,
+                  Pose& pose,
+                  int refinement_steps)
+{
+    return solve_planar_closed_form(a4sheet, A4Target(), camera, pose, refinement_steps);
+}
+
+/**
+ * @brief closed-form solver for the four corners of a rectangular target
+ * @param corners           coordinates of the corners of the target on a picture
+ * @param target            size of the target
+ * @param camera            the camera model, see make_camera_model()
+ * @param pose              receives the rotation and translation vectors
+ * @param refinement_steps  number of Gauss-Newton steps
+ * @return whether the problem could be solved
+ *
+ * @sa solve_pnp_a4()
+ */
+bool solve_pnp_planar(const TargetCorners& corners,
+                      const PlanarTarget& target,
+                      const CameraModel& camera,
+                      Pose& pose,
+                      int refinement_steps)
+{
+    return with_fixed_target(target,
+                             [&](const auto& t)
+                             {
+                                 return solve_planar_closed_form(
+                                   corners, t, camera, pose, refinement_steps);
+                             });
+}
+
+/**
+ * @brief solves the PnP problems of several sheets seen on the same picture
+ * @param sheets  coordinates of the sheets on the picture
+ * @param camera  the camera model, see make_camera_model()
+ * @return a result for each sheet, in the same order
+ *
+ * The sheets are solved in parallel with solve_pnp(const A4SheetOfPaper&,
+ * const CameraModel&, Pose&), sharing the same camera model.
+ * A sheet that cannot be solved does not prevent the others from being
+ * solved: its failure is reported in its PnPTargetResult::status.
+ */
+std::vector<PnPTargetResult> solve_pnp_many(const std::vector<A4SheetOfPaper>& sheets,
+                                            const CameraModel& camera)
+{
+    return solve_pnp_many(sheets, A4Target(), camera);
+}
+
+/**
+ * @brief solves the PnP problems of several targets seen on the same picture
+ * @param targets  coordinates of the corners of the targets on the picture
+ * @param target   size of the targets
+ * @param camera   the camera model, see make_camera_model()
+ * @return a result for each target, in the same order
+ */
+std::vector<PnPTargetResult> solve_pnp_many(const std::vector<TargetCorners>& targets,
+                                            const PlanarTarget& target,
+                                            const CameraModel& camera)
+{
+    std::vector<PnPTargetResult> results(targets.size());
+
+    with_fixed_target(
+      target,
+      [&](const auto& t)
+      {
+          cv::parallel_for_(cv::Range(0, static_cast<int>(targets.size())),
+                            [&](const cv::Range& range)
+                            {
+                                for (int i = range.start; i < range.end; ++i)
+                                {
+                                    const TargetCorners& sheet = targets[i];
+                                    PnPTargetResult& result = results[i];
+                                    const cv::Point2d corners[4] = {
+                                        cv::Point2d(sheet.bottom_left),
+                                        cv::Point2d(sheet.bottom_right),
+                                        cv::Point2d(sheet.top_right),
+                                        cv::Point2d(sheet.top_left)
+                                    };
+
+                                    if (!is_convex_quadrilateral(corners))
+                                    {
+                                        result.status = PnPStatus::DegenerateCorners;
+                                        continue;
+                                    }
+
+                                    if (!solve_planar(sheet, t, camera, result.pose))
+                                    {
+                                        result.status = PnPStatus::Failed;
+                                        continue;
+                                    }
+
+                                    cv::Vec<double, 8> residuals;
+                                    compute_residuals(t, camera, corners, result.pose, residuals);
+                                    result.reprojection_error =
+                                      std::sqrt(residuals.dot(residuals) / 4);
+                                    result.status = PnPStatus::Solved;
+                                }
+                            });
+      });
+
+    return results;
+}
+
+/**
+ * @brief solves the PnP problems of several sheets seen on the same picture
+ * @param sheets      coordinates of the sheets on the picture
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ *
+ * The camera model is built once for all the sheets.
+ */
+std::vector<PnPTargetResult> solve_pnp_many(const std::vector<A4SheetOfPaper>& sheets,
+                                            const CameraIntrinsics& intrinsics,
+                                            const DistortionCoefficients& distortion)
+{
+    return solve_pnp_many(sheets, make_camera_model(intrinsics, distortion));
+}
+
+/**
+ * @brief returns a short description of a PnPStatus
+ */
+const char* to_string(PnPStatus status)
+{
+    switch (status)
+    {
+    case PnPStatus::Solved:
+        return "solved";
+    case PnPStatus::DegenerateCorners:
+        return "degenerate corners";
+    default:
+        return "failed";
+    }
+}
+
+/**
+ * @brief fixed-size version of get_rotation_matrix()
+ * @param rvec  rotation vector (axis-angle)
+ *
+ * This is the Rodrigues' formula, as implemented by cv::Rodrigues().
+ */
+cv::Matx33d get_rotation_matrix(const cv::Vec3d& rvec)
+{
+    const double theta = cv::norm(rvec);
+
+    if (theta < 1e-12)
+    {
+        return cv::Matx33d(1, -rvec[2], rvec[1], rvec[2], 1, -rvec[0], -rvec[1], rvec[0], 1);
+    }
+
+    const double c = std::cos(theta);
+    const double s = std::sin(theta);
+    const double c1 = 1 - c;
+    const double x = rvec[0] / theta;
+    const double y = rvec[1] / theta;
+    const double z = rvec[2] / theta;
+
+    return cv::Matx33d(c + c1 * x * x,
+                       c1 * x * y - s * z,
+                       c1 * x * z + s * y,
+                       c1 * x * y + s * z,
+                       c + c1 * y * y,
+                       c1 * y * z - s * x,
+                       c1 * x * z - s * y,
+                       c1 * y * z + s * x,
+                       c + c1 * z * z);
+}
+
+/**
+ * @brief returns the rotation vector (axis-angle) of a rotation matrix
+ * @param rotation  a rotation matrix
+ *
+ * Inverse of get_rotation_matrix().
+ */
+cv::Vec3d get_rotation_vector(const cv::Matx33d& rotation)
+{
+    const cv::Matx33d& r = rotation;
+    const cv::Vec3d axis{ r(2, 1) - r(1, 2), r(0, 2) - r(2, 0), r(1, 0) - r(0, 1) };
+    const double s = cv::norm(axis) / 2;
+    const double c = std::max(-1.0, std::min((r(0, 0) + r(1, 1) + r(2, 2) - 1) / 2, 1.0));
+
+    if (s < 1e-5)
+    {
+        if (c > 0)
+        {
+            return axis / 2;
+        }
+
+        // theta is close to pi: the axis is read from the diagonal of
+        // R = 2 * u * u^T - I, with signs taken from the off-diagonal terms
+        cv::Vec3d u{ std::sqrt(std::max((r(0, 0) + 1) / 2, 0.0)),
+                     std::sqrt(std::max((r(1, 1) + 1) / 2, 0.0)),
+                     std::sqrt(std::max((r(2, 2) + 1) / 2, 0.0)) };
+
+        if (u[0] >= u[1] && u[0] >= u[2])
+        {
+            u[1] = std::copysign(u[1], r(0, 1));
+            u[2] = std::copysign(u[2], r(0, 2));
+        }
+        else if (u[1] >= u[2])
+        {
+            u[0] = std::copysign(u[0], r(0, 1));
+            u[2] = std::copysign(u[2], r(1, 2));
+        }
+        else
+        {
+            u[0] = std::copysign(u[0], r(0, 2));
+            u[1] = std::copysign(u[1], r(1, 2));
+        }
+
+        return u * (std::atan2(s, c) / cv::norm(u));
+    }
+
+    return axis * (std::atan2(s, c) / (2 * s));
+}
+
+/**
+ * @brief fixed-size version of compute_camera_position()
+ * @param pose
+ */
+cv::Vec3d compute_camera_position(const Pose& pose)
+{
+    return get_rotation_matrix(pose.rvec).t() * (-pose.tvec);
+}
+
+/**
+ * @brief projects a point on the image
+ * @param camera        the camera model
+ * @param rotation      rotation matrix, see get_rotation_matrix()
+ * @param tvec          translation vector
+ * @param object_point  coordinates of the point in the world coordinate system
+ * @return the coordinates of the point in pixels
+ *
+ * Allocation-free version of cv::projectPoints() for a single point.
+ */
+cv::Point2d project_point(const CameraModel& camera,
+                          const cv::Matx33d& rotation,
+                          const cv::Vec3d& tvec,
+                          const cv::Vec3d& object_point)
+{
+    const cv::Vec3d p = rotation * object_point + tvec;
+    return distort_point(camera, cv::Point2d(p[0] / p[2], p[1] / p[2]));
+}
+
 } // namespace ocvp
@@ -0,0 +1,711 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "pnp.h"
+
+#include "planarpose.h"
+#include "simd.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+// Number of hypotheses scored in parallel between two checks of the stopping
+// criterion. It does not depend on the number of threads, so that neither
+// does the result.
+constexpr int batch_size = 64;
+
+// Number of draws after which a hypothesis whose samples are all degenerate
+// is given up.
+constexpr int max_sampling_attempts = 100;
+
+// Maximum number of refinement rounds, each one followed by the update of
+// the inlier set.
+constexpr int max_refinement_rounds = 3;
+
+/**
+ * Arguments of the scoring kernels.
+ * The correspondences are stored as structure of arrays: coordinates of the
+ * points in the plane of the target, and undistorted image coordinates
+ * scaled by the focal lengths.
+ */
+struct CorrespondenceView
+{
+    const float* x;
+    const float* y;
+    const float* u;
+    const float* v;
+    size_t count;
+};
+
+// m: rows of [ r1 r2 t ], the first one scaled by fx and the second by fy.
+// A point is an inlier if it is in front of the camera and if its residual
+// (du / w, dv / w) is shorter than the threshold; the comparison is made
+// without divisions.
+using InlierKernel =
+  size_t (*)(const CorrespondenceView&, size_t, const float*, float, uchar*);
+
+size_t count_inliers_scalar(const CorrespondenceView& points,
+                            size_t begin,
+                            const float* m,
+                            float threshold2,
+                            uchar* mask)
+{
+    size_t count = 0;
+
+    for (size_t i(begin); i < points.count; ++i)
+    {
+        const float x = points.x[i];
+        const float y = points.y[i];
+        const float w = m[6] * x + m[7] * y + m[8];
+        const float du = m[0] * x + m[1] * y + m[2] - points.u[i] * w;
+        const float dv = m[3] * x + m[4] * y + m[5] - points.v[i] * w;
+        const bool inlier = w > 0 && du * du + dv * dv < threshold2 * (w * w);
+        count += inlier ? 1 : 0;
+
+        if (mask)
+        {
+            mask[i] = inlier ? 1 : 0;
+        }
+    }
+
+    return count;
+}
+
+#ifdef OCVP_X86_SIMD
+
+// The operations are those of the scalar kernel, in the same order (and
+// without fused multiply-adds) so that every level gives the same result.
+
+OCVP_TARGET_SSE41 size_t count_inliers_sse(const CorrespondenceView& points,
+                                           size_t begin,
+                                           const float* m,
+                                           float threshold2,
+                                           uchar* mask)
+{
+    __m128 coefs[9];
+
+    for (int k(0); k < 9; ++k)
+    {
+        coefs[k] = _mm_set1_ps(m[k]);
+    }
+
+    const __m128 t2 = _mm_set1_ps(threshold2);
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t count = 0;
+    size_t i = begin;
+
+    for (; i + 4 <= points.count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(points.x + i);
+        const __m128 y = _mm_loadu_ps(points.y + i);
+
+        const __m128 w = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(coefs[6], x), _mm_mul_ps(coefs[7], y)), coefs[8]);
+        const __m128 pu = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(coefs[0], x), _mm_mul_ps(coefs[1], y)), coefs[2]);
+        const __m128 pv = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(coefs[3], x), _mm_mul_ps(coefs[4], y)), coefs[5]);
+        const __m128 du = _mm_sub_ps(pu, _mm_mul_ps(_mm_loadu_ps(points.u + i), w));
+        const __m128 dv = _mm_sub_ps(pv, _mm_mul_ps(_mm_loadu_ps(points.v + i), w));
+        const __m128 lhs = _mm_add_ps(_mm_mul_ps(du, du), _mm_mul_ps(dv, dv));
+        const __m128 rhs = _mm_mul_ps(t2, _mm_mul_ps(w, w));
+        const int bits =
+          _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(w, zero), _mm_cmplt_ps(lhs, rhs)));
+        count += std::bitset<4>(bits).count();
+
+        if (mask)
+        {
+            for (int k(0); k < 4; ++k)
+            {
+                mask[i + k] = (bits >> k) & 1;
+            }
+        }
+    }
+
+    return count + count_inliers_scalar(points, i, m, threshold2, mask);
+}
+
+OCVP_TARGET_AVX2 size_t count_inliers_avx2(const CorrespondenceView& points,
+                                           size_t begin,
+                                           const float* m,
+                                           float threshold2,
+                                           uchar* mask)
+{
+    __m256 coefs[9];
+
+    for (int k(0); k < 9; ++k)
+    {
+        coefs[k] = _mm256_set1_ps(m[k]);
+    }
+
+    const __m256 t2 = _mm256_set1_ps(threshold2);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t count = 0;
+    size_t i = begin;
+
+    for (; i + 8 <= points.count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(points.x + i);
+        const __m256 y = _mm256_loadu_ps(points.y + i);
+
+        const __m256 w = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(coefs[6], x), _mm256_mul_ps(coefs[7], y)), coefs[8]);
+        const __m256 pu = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(coefs[0], x), _mm256_mul_ps(coefs[1], y)), coefs[2]);
+        const __m256 pv = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(coefs[3], x), _mm256_mul_ps(coefs[4], y)), coefs[5]);
+        const __m256 du = _mm256_sub_ps(pu, _mm256_mul_ps(_mm256_loadu_ps(points.u + i), w));
+        const __m256 dv = _mm256_sub_ps(pv, _mm256_mul_ps(_mm256_loadu_ps(points.v + i), w));
+        const __m256 lhs = _mm256_add_ps(_mm256_mul_ps(du, du), _mm256_mul_ps(dv, dv));
+        const __m256 rhs = _mm256_mul_ps(t2, _mm256_mul_ps(w, w));
+        const int bits = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(w, zero, _CMP_GT_OQ),
+                                                          _mm256_cmp_ps(lhs, rhs, _CMP_LT_OQ)));
+        count += std::bitset<8>(bits).count();
+
+        if (mask)
+        {
+            for (int k(0); k < 8; ++k)
+            {
+                mask[i + k] = (bits >> k) & 1;
+            }
+        }
+    }
+
+    return count + count_inliers_scalar(points, i, m, threshold2, mask);
+}
+
+#endif // OCVP_X86_SIMD
+
+// indexed by SimdLevel, null if not available
+const InlierKernel inlier_kernels[3] = { &count_inliers_scalar,
+                                         OCVP_SIMD_KERNEL(count_inliers_sse),
+                                         OCVP_SIMD_KERNEL(count_inliers_avx2) };
+
+struct Hypothesis
+{
+    bool valid = false;
+    cv::Matx33d rotation;
+    cv::Vec3d tvec;
+    size_t nb_inliers = 0;
+};
+
+// Seed of the random generator of a hypothesis (splitmix64 of the seed and
+// of the index of the hypothesis): every hypothesis has its own generator,
+// so that its sample does not depend on the order in which threads run.
+uint64_t hypothesis_seed(uint64_t seed, int index)
+{
+    uint64_t z = seed + (static_cast<uint64_t>(index) + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double signed_area(const cv::Point2d& a, const cv::Point2d& b, const cv::Point2d& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// Rejects samples with 3 (nearly) collinear points, in the plane of the
+// target or in the image, and samples whose triangles do not all have the
+// same orientation in the plane and in the image: no pose maps them.
+bool is_valid_sample(const cv::Point2d (&object)[4], const cv::Point2d (&image)[4])
+{
+    constexpr int triangles[4][3] = { { 0, 1, 2 }, { 0, 1, 3 }, { 0, 2, 3 }, { 1, 2, 3 } };
+
+    double object_size = 0;
+    double image_size = 0;
+
+    for (int i(1); i < 4; ++i)
+    {
+        const cv::Point2d d = object[i] - object[0];
+        const cv::Point2d e = image[i] - image[0];
+        object_size = std::max(object_size, d.dot(d));
+        image_size = std::max(image_size, e.dot(e));
+    }
+
+    int orientation = 0;
+
+    for (const auto& t : triangles)
+    {
+        const double a = signed_area(object[t[0]], object[t[1]], object[t[2]]);
+        const double b = signed_area(image[t[0]], image[t[1]], image[t[2]]);
+
+        if (!(std::abs(a) > 1e-6 * object_size && std::abs(b) > 1e-6 * image_size))
+        {
+            return false;
+        }
+
+        const int sign = (a > 0) == (b > 0) ? 1 : -1;
+
+        if (orientation != 0 && sign != orientation)
+        {
+            return false;
+        }
+
+        orientation = sign;
+    }
+
+    return true;
+}
+
+// Computes the homography mapping 4 points of the plane of the target to
+// their normalized image coordinates (DLT, with h33 = 1), and scales it so
+// that the points are in front of the camera.
+bool compute_homography(const cv::Point2d (&object)[4],
+                        const cv::Point2d (&image)[4],
+                        cv::Matx33d& homography)
+{
+    cv::Matx<double, 8, 8> a;
+    cv::Vec<double, 8> b;
+
+    for (int i(0); i < 4; ++i)
+    {
+        const double x = object[i].x;
+        const double y = object[i].y;
+        const double u = image[i].x;
+        const double v = image[i].y;
+        const double row_u[8] = { x, y, 1, 0, 0, 0, -u * x, -u * y };
+        const double row_v[8] = { 0, 0, 0, x, y, 1, -v * x, -v * y };
+
+        for (int j(0); j < 8; ++j)
+        {
+            a(2 * i, j) = row_u[j];
+            a(2 * i + 1, j) = row_v[j];
+        }
+
+        b[2 * i] = u;
+        b[2 * i + 1] = v;
+    }
+
+    cv::Vec<double, 8> h;
+
+    if (!solve_linear_system(a, b, h))
+    {
+        return false;
+    }
+
+    homography = cv::Matx33d(h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], 1);
+
+    int nb_positive = 0;
+
+    for (int i(0); i < 4; ++i)
+    {
+        nb_positive += h[6] * object[i].x + h[7] * object[i].y + 1 > 0 ? 1 : 0;
+    }
+
+    if (nb_positive == 0)
+    {
+        homography *= -1;
+    }
+
+    // otherwise some points are behind the camera
+    return nb_positive == 0 || nb_positive == 4;
+}
+
+void get_projection(const cv::Matx33d& rotation,
+                    const cv::Vec3d& tvec,
+                    double fx,
+                    double fy,
+                    float (&m)[9])
+{
+    const double scale[3] = { fx, fy, 1 };
+
+    for (int r(0); r < 3; ++r)
+    {
+        m[3 * r] = static_cast<float>(scale[r] * rotation(r, 0));
+        m[3 * r + 1] = static_cast<float>(scale[r] * rotation(r, 1));
+        m[3 * r + 2] = static_cast<float>(scale[r] * tvec[r]);
+    }
+}
+
+// Draws a minimal sample, computes the pose it defines and counts its inliers
+Hypothesis generate_hypothesis(const std::vector<cv::Point2d>& object_points,
+                               const std::vector<cv::Point2d>& normalized,
+                               const CorrespondenceView& view,
+                               InlierKernel kernel,
+                               double fx,
+                               double fy,
+                               float threshold2,
+                               uint64_t seed)
+{
+    Hypothesis hypothesis;
+    cv::RNG rng{ seed };
+    const int n = static_cast<int>(object_points.size());
+
+    cv::Point2d object[4];
+    cv::Point2d image[4];
+    bool found = false;
+
+    for (int attempt(0); attempt < max_sampling_attempts && !found; ++attempt)
+    {
+        int indices[4];
+
+        for (int i(0); i < 4; ++i)
+        {
+            do
+            {
+                indices[i] = rng.uniform(0, n);
+            } while (std::find(indices, indices + i, indices[i]) != indices + i);
+
+            object[i] = object_points[indices[i]];
+            image[i] = normalized[indices[i]];
+        }
+
+        found = is_valid_sample(object, image);
+    }
+
+    cv::Matx33d homography;
+
+    if (!found || !compute_homography(object, image, homography)
+        || !decompose_homography(homography, hypothesis.rotation, hypothesis.tvec))
+    {
+        return hypothesis;
+    }
+
+    float m[9];
+    get_projection(hypothesis.rotation, hypothesis.tvec, fx, fy, m);
+    hypothesis.valid = true;
+    hypothesis.nb_inliers = kernel(view, 0, m, threshold2, nullptr);
+    return hypothesis;
+}
+
+// Number of samples needed to draw one free of outliers with the given
+// confidence, for 4-point samples and the given ratio of inliers
+int required_iterations(double inlier_ratio, double confidence, int max_iterations)
+{
+    const double p = std::pow(inlier_ratio, 4);
+
+    if (p >= 1)
+    {
+        return 0;
+    }
+    else if (p <= 0)
+    {
+        return max_iterations;
+    }
+
+    const double k = std::log(1 - confidence) / std::log(1 - p);
+    return k < max_iterations ? static_cast<int>(std::ceil(k)) : max_iterations;
+}
+
+// Gauss-Newton minimization of the distances (scaled by the focal lengths)
+// between the projections of the inliers and their undistorted coordinates;
+// see refine_pose_gauss_newton() in pnp.cpp for the Jacobian.
+void refine_pose_on_inliers(const std::vector<cv::Point2d>& object_points,
+                            const std::vector<cv::Point2d>& normalized,
+                            const std::vector<uchar>& mask,
+                            double fx,
+                            double fy,
+                            int iterations,
+                            cv::Matx33d& rotation,
+                            cv::Vec3d& tvec)
+{
+    for (int iteration(0); iteration < iterations; ++iteration)
+    {
+        cv::Matx<double, 6, 6> jtj;
+        cv::Vec<double, 6> jtr;
+
+        for (size_t i(0); i < object_points.size(); ++i)
+        {
+            if (!mask[i])
+            {
+                continue;
+            }
+
+            const cv::Vec3d rx =
+              cv::Vec3d(rotation(0, 0), rotation(1, 0), rotation(2, 0)) * object_points[i].x
+              + cv::Vec3d(rotation(0, 1), rotation(1, 1), rotation(2, 1)) * object_points[i].y;
+            const cv::Vec3d p = rx + tvec;
+
+            if (!(p[2] > 0))
+            {
+                return;
+            }
+
+            const double iz = 1 / p[2];
+            const double x = p[0] * iz;
+            const double y = p[1] * iz;
+
+            const double du[3] = { fx * iz, 0, -fx * x * iz };
+            const double dv[3] = { 0, fy * iz, -fy * y * iz };
+            const double dp_dw[3][3] = { { 0, rx[2], -rx[1] },
+                                         { -rx[2], 0, rx[0] },
+                                         { rx[1], -rx[0], 0 } };
+
+            double ju[6];
+            double jv[6];
+
+            for (int j(0); j < 3; ++j)
+            {
+                ju[j] = du[0] * dp_dw[0][j] + du[1] * dp_dw[1][j] + du[2] * dp_dw[2][j];
+                jv[j] = dv[0] * dp_dw[0][j] + dv[1] * dp_dw[1][j] + dv[2] * dp_dw[2][j];
+                ju[j + 3] = du[j];
+                jv[j + 3] = dv[j];
+            }
+
+            const double ru = fx * (x - normalized[i].x);
+            const double rv = fy * (y - normalized[i].y);
+
+            for (int j(0); j < 6; ++j)
+            {
+                for (int k(j); k < 6; ++k)
+                {
+                    jtj(j, k) += ju[j] * ju[k] + jv[j] * jv[k];
+                }
+
+                jtr[j] += ju[j] * ru + jv[j] * rv;
+            }
+        }
+
+        for (int j(0); j < 6; ++j)
+        {
+            for (int k(0); k < j; ++k)
+            {
+                jtj(j, k) = jtj(k, j);
+            }
+        }
+
+        cv::Vec<double, 6> delta;
+
+        if (!solve_linear_system(jtj, -jtr, delta))
+        {
+            return;
+        }
+
+        rotation = get_rotation_matrix(cv::Vec3d(delta[0], delta[1], delta[2])) * rotation;
+        tvec += cv::Vec3d(delta[3], delta[4], delta[5]);
+
+        if (!(delta.dot(delta) > 1e-24))
+        {
+            return;
+        }
+    }
+}
+
+double compute_reprojection_error(const std::vector<cv::Point2d>& object_points,
+                                  const std::vector<cv::Point2d>& normalized,
+                                  const std::vector<uchar>& mask,
+                                  double fx,
+                                  double fy,
+                                  const cv::Matx33d& rotation,
+                                  const cv::Vec3d& tvec)
+{
+    double sum = 0;
+    size_t count = 0;
+
+    for (size_t i(0); i < object_points.size(); ++i)
+    {
+        if (mask[i])
+        {
+            const cv::Vec3d p =
+              rotation * cv::Vec3d(object_points[i].x, object_points[i].y, 0) + tvec;
+            const double du = fx * (p[0] / p[2] - normalized[i].x);
+            const double dv = fy * (p[1] / p[2] - normalized[i].y);
+            sum += du * du + dv * dv;
+            ++count;
+        }
+    }
+
+    return count > 0 ? std::sqrt(sum / count) : 0;
+}
+
+} // namespace
+
+/**
+ * @brief robustly solves a PnP problem with many correspondences, some of which may be wrong
+ * @param object_points  coordinates (in meters) of the points in the plane of the target,
+ *                       i.e. the points (x, y, 0) of the world coordinate system
+ * @param image_points   coordinates (in pixels) of the points on the picture
+ * @param camera         the camera model
+ * @param options
+ * @throw std::runtime_error if the number of points differ or is less than 4
+ *
+ * This is a RANSAC: hypotheses are computed from samples of 4 points (by
+ * decomposing the homography they define) and are scored by their number of
+ * inliers. Hypotheses are drawn and scored in parallel, by batches, and the
+ * residuals are evaluated with the SIMD instructions up to
+ * PnPRansacOptions::max_level. The search stops once enough hypotheses have
+ * been drawn for one of them to be free of outliers, with probability
+ * PnPRansacOptions::confidence, given the best inlier ratio found so far.
+ * The best pose is then refined on its inliers, which are updated after
+ * the refinement.
+ *
+ * Residuals are measured on the undistorted points. For a given seed, the
+ * result does not depend on the number of threads.
+ */
+PnPRansacResult solve_pnp_ransac(const std::vector<cv::Point2d>& object_points,
+                                 const std::vector<cv::Point2d>& image_points,
+                                 const CameraModel& camera,
+                                 const PnPRansacOptions& options)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    if (object_points.size() != image_points.size())
+    {
+        throw std::runtime_error("solve_pnp_ransac: the numbers of points differ");
+    }
+
+    if (object_points.size() < 4)
+    {
+        throw std::runtime_error("solve_pnp_ransac: at least 4 points are required");
+    }
+
+    const size_t n = object_points.size();
+    const double fx = camera.camera_matrix(0, 0);
+    const double fy = camera.camera_matrix(1, 1);
+
+    std::vector<cv::Point2d> normalized(n);
+    std::vector<float> coordinates(4 * n);
+
+    for (size_t i(0); i < n; ++i)
+    {
+        normalized[i] = undistort_point(camera, image_points[i]);
+        coordinates[i] = static_cast<float>(object_points[i].x);
+        coordinates[n + i] = static_cast<float>(object_points[i].y);
+        coordinates[2 * n + i] = static_cast<float>(fx * normalized[i].x);
+        coordinates[3 * n + i] = static_cast<float>(fy * normalized[i].y);
+    }
+
+    const CorrespondenceView view{ coordinates.data(),
+                                   coordinates.data() + n,
+                                   coordinates.data() + 2 * n,
+                                   coordinates.data() + 3 * n,
+                                   n };
+
+    int level = static_cast<int>(std::min(options.max_level, best_simd_level()));
+
+    while (!inlier_kernels[level])
+    {
+        --level;
+    }
+
+    const InlierKernel kernel = inlier_kernels[level];
+    const float threshold2 =
+      static_cast<float>(options.reprojection_threshold * options.reprojection_threshold);
+
+    PnPRansacResult result;
+    result.inlier_mask.assign(n, 0);
+
+    Hypothesis best;
+    std::vector<Hypothesis> batch(batch_size);
+    int required = options.max_iterations;
+
+    while (result.nb_iterations < required)
+    {
+        const int first = result.nb_iterations;
+        const int count = std::min(batch_size, required - first);
+
+        cv::parallel_for_(cv::Range(0, count),
+                          [&](const cv::Range& range)
+                          {
+                              for (int i = range.start; i < range.end; ++i)
+                              {
+                                  batch[i] = generate_hypothesis(
+                                    object_points,
+                                    normalized,
+                                    view,
+                                    kernel,
+                                    fx,
+                                    fy,
+                                    threshold2,
+                                    hypothesis_seed(options.seed, first + i));
+                              }
+                          });
+
+        result.nb_iterations += count;
+
+        // ties go to the first hypothesis, for the result not to depend on the threads
+        bool improved = false;
+
+        for (int i(0); i < count; ++i)
+        {
+            if (batch[i].valid && batch[i].nb_inliers > best.nb_inliers)
+            {
+                best = batch[i];
+                improved = true;
+            }
+        }
+
+        if (improved)
+        {
+            required = required_iterations(double(best.nb_inliers) / n,
+                                           options.confidence,
+                                           options.max_iterations);
+        }
+    }
+
+    if (!best.valid || best.nb_inliers < 4)
+    {
+        result.elapsed_ms =
+          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+        return result;
+    }
+
+    cv::Matx33d rotation = best.rotation;
+    cv::Vec3d tvec = best.tvec;
+    float m[9];
+    get_projection(rotation, tvec, fx, fy, m);
+    result.nb_inliers = kernel(view, 0, m, threshold2, result.inlier_mask.data());
+
+    for (int round(0); round < max_refinement_rounds; ++round)
+    {
+        cv::Matx33d refined_rotation = rotation;
+        cv::Vec3d refined_tvec = tvec;
+        refine_pose_on_inliers(object_points,
+                               normalized,
+                               result.inlier_mask,
+                               fx,
+                               fy,
+                               options.refinement_iterations,
+                               refined_rotation,
+                               refined_tvec);
+
+        std::vector<uchar> mask(n);
+        get_projection(refined_rotation, refined_tvec, fx, fy, m);
+        const size_t nb_inliers = kernel(view, 0, m, threshold2, mask.data());
+
+        if (nb_inliers < result.nb_inliers)
+        {
+            break;
+        }
+
+        rotation = refined_rotation;
+        tvec = refined_tvec;
+        result.nb_inliers = nb_inliers;
+
+        if (mask == result.inlier_mask)
+        {
+            break;
+        }
+
+        result.inlier_mask.swap(mask);
+    }
+
+    result.pose.rvec = get_rotation_vector(rotation);
+    result.pose.tvec = tvec;
+    result.solved = std::isfinite(result.pose.rvec.dot(result.pose.rvec))
+                    && std::isfinite(result.pose.tvec.dot(result.pose.tvec));
+    result.reprojection_error = compute_reprojection_error(
+      object_points, normalized, result.inlier_mask, fx, fy, rotation, tvec);
+    result.elapsed_ms =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+} // namespace ocvp
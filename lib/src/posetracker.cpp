@@ -0,0 +1,215 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "posetracker.h"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+/**
+ * @brief constructs a tracker for a given camera
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ * @param options     tracking parameters
+ */
+PoseTracker::PoseTracker(const CameraIntrinsics& intrinsics,
+                         const DistortionCoefficients& distortion,
+                         const PoseTrackerOptions& options)
+    : m_options(options),
+      m_camera_matrix(make_camera_matrix(intrinsics)),
+      m_dist_coeffs(make_distcoeffs_vector(distortion)),
+      m_object_points{ cv::Point3d(0, 0, 0),
+                       cv::Point3d(options.target.width, 0, 0),
+                       cv::Point3d(options.target.width, options.target.height, 0),
+                       cv::Point3d(0, options.target.height, 0) },
+      m_image_points(4),
+      m_projected_points(4)
+{
+}
+
+const PoseTrackerOptions& PoseTracker::options() const
+{
+    return m_options;
+}
+
+/**
+ * @brief solves the pose of the target in a new frame
+ * @param corners  coordinates of the corners of the target in the frame
+ * @return the pose of the target
+ * @throw std::runtime_error if OpenCV fails at solving the problem
+ *
+ * If a previous pose is available, it is refined with at most
+ * PoseTrackerOptions::max_iterations iterations.
+ * The result is rejected, and the frame solved from scratch, if its RMS
+ * reprojection error exceeds both PoseTrackerOptions::max_reprojection_error
+ * and PoseTrackerOptions::max_error_increase times the error of the
+ * previous frame.
+ *
+ * If the frame cannot be solved, the tracker is reset.
+ */
+PnPResult PoseTracker::track(const TargetCorners& corners)
+{
+    m_image_points[0] = cv::Point2d(corners.bottom_left);
+    m_image_points[1] = cv::Point2d(corners.bottom_right);
+    m_image_points[2] = cv::Point2d(corners.top_right);
+    m_image_points[3] = cv::Point2d(corners.top_left);
+
+    ++m_statistics.frames;
+
+    if (has_pose())
+    {
+        PnPResult result = solve_warm();
+        double error = compute_reprojection_error(result);
+        double threshold = std::max(m_options.max_reprojection_error,
+                                    m_options.max_error_increase * m_reprojection_error);
+
+        if (error <= threshold)
+        {
+            ++m_statistics.warm_starts;
+            m_pose = result;
+            m_reprojection_error = error;
+            m_last_solve_was_warm = true;
+            return m_pose;
+        }
+
+        ++m_statistics.fallbacks;
+    }
+
+    try
+    {
+        m_pose = solve_cold();
+    }
+    catch (...)
+    {
+        reset();
+        throw;
+    }
+
+    ++m_statistics.cold_starts;
+    m_reprojection_error = compute_reprojection_error(m_pose);
+    m_last_solve_was_warm = false;
+    return m_pose;
+}
+
+/**
+ * @brief forgets the previous pose
+ *
+ * The next frame will be solved from scratch; statistics are kept.
+ */
+void PoseTracker::reset()
+{
+    m_pose = PnPResult();
+    m_reprojection_error = 0;
+    m_last_solve_was_warm = false;
+}
+
+/**
+ * @brief returns whether a pose is available to seed the next frame
+ */
+bool PoseTracker::has_pose() const
+{
+    return !m_pose.rvec.empty() && !m_pose.tvec.empty();
+}
+
+/**
+ * @brief returns the pose found in the last frame
+ */
+const PnPResult& PoseTracker::pose() const
+{
+    return m_pose;
+}
+
+/**
+ * @brief returns the RMS reprojection error (in pixels) of the last frame
+ */
+double PoseTracker::reprojection_error() const
+{
+    return m_reprojection_error;
+}
+
+/**
+ * @brief returns whether the last frame was solved from the previous pose
+ */
+bool PoseTracker::last_solve_was_warm() const
+{
+    return m_last_solve_was_warm;
+}
+
+const PoseTrackerStatistics& PoseTracker::statistics() const
+{
+    return m_statistics;
+}
+
+/**
+ * @brief returns the fraction of the frames that were solved from the previous pose
+ */
+double PoseTracker::warm_start_ratio() const
+{
+    return m_statistics.frames == 0
+             ? 0.0
+             : static_cast<double>(m_statistics.warm_starts) / m_statistics.frames;
+}
+
+double PoseTracker::compute_reprojection_error(const PnPResult& pose)
+{
+    cv::projectPoints(
+      m_object_points, pose.rvec, pose.tvec, m_camera_matrix, m_dist_coeffs, m_projected_points);
+
+    double sum = 0;
+
+    for (size_t i(0); i < m_image_points.size(); ++i)
+    {
+        cv::Point2d d = m_projected_points[i] - m_image_points[i];
+        sum += d.dot(d);
+    }
+
+    return std::sqrt(sum / m_image_points.size());
+}
+
+PnPResult PoseTracker::solve_cold()
+{
+    PnPResult result;
+    result.rvec = cv::Mat::zeros(3, 1, CV_64FC1);
+    result.tvec = cv::Mat::zeros(3, 1, CV_64FC1);
+
+    bool problem_solved = cv::solvePnP(
+      m_object_points, m_image_points, m_camera_matrix, m_dist_coeffs, result.rvec, result.tvec);
+
+    if (!problem_solved)
+    {
+        throw std::runtime_error("cv::solvePnP() failed");
+    }
+
+    return result;
+}
+
+PnPResult PoseTracker::solve_warm()
+{
+    PnPResult result;
+    result.rvec = m_pose.rvec.clone();
+    result.tvec = m_pose.tvec.clone();
+
+    cv::solvePnPRefineLM(
+      m_object_points,
+      m_image_points,
+      m_camera_matrix,
+      m_dist_coeffs,
+      result.rvec,
+      result.tvec,
+      cv::TermCriteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS,
+                       m_options.max_iterations,
+                       FLT_EPSILON));
+
+    return result;
+}
+
+} // namespace ocvp
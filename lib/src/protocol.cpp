@@ -0,0 +1,294 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace protocol
+{
+
+namespace
+{
+
+// Unsigned integer with the size of a value, through which the value is
+// converted to or from little-endian bytes.
+template<size_t N>
+struct Bits;
+
+template<>
+struct Bits<4>
+{
+    using type = uint32_t;
+};
+
+template<>
+struct Bits<8>
+{
+    using type = uint64_t;
+};
+
+// Values are written least significant byte first, whatever the byte order
+// of the host.
+class Writer
+{
+public:
+    explicit Writer(MessageType type)
+    {
+        u8(static_cast<uint8_t>(type));
+    }
+
+    void u8(uint8_t value)
+    {
+        m_bytes.push_back(value);
+    }
+
+    template<typename T>
+    void raw(const T& value)
+    {
+        typename Bits<sizeof(T)>::type bits;
+        std::memcpy(&bits, &value, sizeof(T));
+
+        for (size_t i(0); i < sizeof(T); ++i)
+        {
+            m_bytes.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+        }
+    }
+
+    void bytes(const void* data, size_t size)
+    {
+        raw(static_cast<uint32_t>(size));
+        const uint8_t* begin = static_cast<const uint8_t*>(data);
+        m_bytes.insert(m_bytes.end(), begin, begin + size);
+    }
+
+    void vec3d(const cv::Vec3d& v)
+    {
+        raw(v[0]);
+        raw(v[1]);
+        raw(v[2]);
+    }
+
+    void point(const cv::Point& p)
+    {
+        raw(static_cast<int32_t>(p.x));
+        raw(static_cast<int32_t>(p.y));
+    }
+
+    std::vector<uint8_t>& result()
+    {
+        return m_bytes;
+    }
+
+private:
+    std::vector<uint8_t> m_bytes;
+};
+
+class Reader
+{
+public:
+    Reader(const std::vector<uint8_t>& payload, MessageType type)
+        : m_data(payload.data()),
+          m_end(payload.data() + payload.size())
+    {
+        if (u8() != static_cast<uint8_t>(type))
+        {
+            throw std::runtime_error("protocol: unexpected message type");
+        }
+    }
+
+    uint8_t u8()
+    {
+        uint8_t value;
+        read(&value, 1);
+        return value;
+    }
+
+    template<typename T>
+    T raw()
+    {
+        check(sizeof(T));
+        typename Bits<sizeof(T)>::type bits = 0;
+
+        for (size_t i(0); i < sizeof(T); ++i)
+        {
+            bits |= static_cast<decltype(bits)>(m_data[i]) << (8 * i);
+        }
+
+        m_data += sizeof(T);
+
+        T value;
+        std::memcpy(&value, &bits, sizeof(T));
+        return value;
+    }
+
+    std::string string()
+    {
+        const uint32_t size = raw<uint32_t>();
+        check(size);
+        std::string value(reinterpret_cast<const char*>(m_data), size);
+        m_data += size;
+        return value;
+    }
+
+    std::vector<uint8_t> bytes()
+    {
+        const uint32_t size = raw<uint32_t>();
+        check(size);
+        std::vector<uint8_t> value(m_data, m_data + size);
+        m_data += size;
+        return value;
+    }
+
+    cv::Vec3d vec3d()
+    {
+        cv::Vec3d v;
+        v[0] = raw<double>();
+        v[1] = raw<double>();
+        v[2] = raw<double>();
+        return v;
+    }
+
+    cv::Point point()
+    {
+        cv::Point p;
+        p.x = raw<int32_t>();
+        p.y = raw<int32_t>();
+        return p;
+    }
+
+private:
+    void check(size_t size) const
+    {
+        if (size > static_cast<size_t>(m_end - m_data))
+        {
+            throw std::runtime_error("protocol: truncated message");
+        }
+    }
+
+    void read(void* dest, size_t size)
+    {
+        check(size);
+        std::memcpy(dest, m_data, size);
+        m_data += size;
+    }
+
+private:
+    const uint8_t* m_data;
+    const uint8_t* m_end;
+};
+
+} // namespace
+
+/**
+ * @brief serializes a request
+ * @return the payload of the frame, without its size
+ */
+std::vector<uint8_t> encode(const SolveRequest& request)
+{
+    Writer writer{ MessageType::SolveRequest };
+    writer.raw(request.id);
+    writer.bytes(request.camera_id.data(), request.camera_id.size());
+    writer.point(request.corners.bottom_left);
+    writer.point(request.corners.bottom_right);
+    writer.point(request.corners.top_right);
+    writer.point(request.corners.top_left);
+    writer.bytes(request.image.data(), request.image.size());
+    writer.bytes(request.image_format.data(), request.image_format.size());
+    return std::move(writer.result());
+}
+
+/**
+ * @brief serializes a response
+ * @return the payload of the frame, without its size
+ */
+std::vector<uint8_t> encode(const SolveResponse& response)
+{
+    Writer writer{ MessageType::SolveResponse };
+    writer.raw(response.id);
+    writer.u8(response.ok ? 1 : 0);
+    writer.raw(response.latency_us);
+
+    if (response.ok)
+    {
+        writer.vec3d(response.rvec);
+        writer.vec3d(response.tvec);
+        writer.bytes(response.image.data(), response.image.size());
+    }
+    else
+    {
+        writer.bytes(response.error.data(), response.error.size());
+    }
+
+    return std::move(writer.result());
+}
+
+/**
+ * @brief returns the type of a message
+ * @throw std::runtime_error if the payload is empty or the type is unknown
+ */
+MessageType message_type(const std::vector<uint8_t>& payload)
+{
+    if (payload.empty()
+        || (payload[0] != static_cast<uint8_t>(MessageType::SolveRequest)
+            && payload[0] != static_cast<uint8_t>(MessageType::SolveResponse)))
+    {
+        throw std::runtime_error("protocol: unknown message type");
+    }
+
+    return static_cast<MessageType>(payload[0]);
+}
+
+/**
+ * @brief deserializes a request
+ * @throw std::runtime_error if the payload is not a valid request
+ */
+SolveRequest decode_request(const std::vector<uint8_t>& payload)
+{
+    Reader reader{ payload, MessageType::SolveRequest };
+    SolveRequest request;
+    request.id = reader.raw<uint32_t>();
+    request.camera_id = reader.string();
+    request.corners.bottom_left = reader.point();
+    request.corners.bottom_right = reader.point();
+    request.corners.top_right = reader.point();
+    request.corners.top_left = reader.point();
+    request.image = reader.bytes();
+    request.image_format = reader.string();
+    return request;
+}
+
+/**
+ * @brief deserializes a response
+ * @throw std::runtime_error if the payload is not a valid response
+ */
+SolveResponse decode_response(const std::vector<uint8_t>& payload)
+{
+    Reader reader{ payload, MessageType::SolveResponse };
+    SolveResponse response;
+    response.id = reader.raw<uint32_t>();
+    response.ok = reader.u8() != 0;
+    response.latency_us = reader.raw<uint64_t>();
+
+    if (response.ok)
+    {
+        response.rvec = reader.vec3d();
+        response.tvec = reader.vec3d();
+        response.image = reader.bytes();
+    }
+    else
+    {
+        response.error = reader.string();
+    }
+
+    return response;
+}
+
+} // namespace protocol
+
+} // namespace ocvp
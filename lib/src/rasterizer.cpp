@@ -0,0 +1,368 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "rasterizer.h"
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+
+namespace ocvp
+{
+
+namespace
+{
+
+// Height of the horizontal tiles rasterized in parallel by draw_strokes()
+constexpr int tile_rows = 64;
+
+// Intersects [umin, umax] with the values of u such that lo <= k * u + c <= hi
+void clip(double k, double c, double lo, double hi, double& umin, double& umax)
+{
+    if (k == 0)
+    {
+        if (c < lo || c > hi)
+        {
+            umax = umin - 1;
+        }
+
+        return;
+    }
+
+    const double u1 = (lo - c) / k;
+    const double u2 = (hi - c) / k;
+    umin = std::max(umin, std::min(u1, u2));
+    umax = std::min(umax, std::max(u1, u2));
+}
+
+/*
+ * Clips a segment to a rectangle; returns false if nothing is left or if the
+ * segment is not finite (e.g. projected from behind the camera).
+ */
+bool clip_segment(StrokeSegment& s, const cv::Rect2d& rect)
+{
+    const cv::Point2d d = s.b - s.a;
+
+    if (!std::isfinite(s.a.x) || !std::isfinite(s.a.y) || !std::isfinite(d.x)
+        || !std::isfinite(d.y))
+    {
+        return false;
+    }
+
+    double tmin = 0;
+    double tmax = 1;
+    clip(d.x, s.a.x, rect.x, rect.x + rect.width, tmin, tmax);
+    clip(d.y, s.a.y, rect.y, rect.y + rect.height, tmin, tmax);
+
+    if (tmin > tmax)
+    {
+        return false;
+    }
+
+    const cv::Point2d a = s.a;
+    s.a = a + tmin * d;
+    s.b = a + tmax * d;
+    return true;
+}
+
+/*
+ * Computes the intersection of row y with the set of the points at most r
+ * away from a segment (a rectangle with two half-discs, which is convex);
+ * returns false if it is empty.
+ */
+bool capsule_span(const StrokeSegment& s, double r, double y, double& xmin, double& xmax)
+{
+    xmin = std::numeric_limits<double>::max();
+    xmax = std::numeric_limits<double>::lowest();
+
+    for (const cv::Point2d& p : { s.a, s.b })
+    {
+        const double dy = y - p.y;
+
+        if (std::abs(dy) <= r)
+        {
+            const double half = std::sqrt(r * r - dy * dy);
+            xmin = std::min(xmin, p.x - half);
+            xmax = std::max(xmax, p.x + half);
+        }
+    }
+
+    const cv::Point2d d = s.b - s.a;
+    const double length2 = d.dot(d);
+
+    if (length2 > 0)
+    {
+        // u = x - a.x; 0 <= d.(p - a) <= |d|^2 and |n.(p - a)| <= r |d|, with n = (-d.y, d.x)
+        const double qy = y - s.a.y;
+        const double rl = r * std::sqrt(length2);
+        double umin = std::numeric_limits<double>::lowest();
+        double umax = std::numeric_limits<double>::max();
+        clip(d.x, d.y * qy, 0, length2, umin, umax);
+        clip(-d.y, d.x * qy, -rl, rl, umin, umax);
+
+        if (umin <= umax)
+        {
+            xmin = std::min(xmin, s.a.x + umin);
+            xmax = std::max(xmax, s.a.x + umax);
+        }
+    }
+
+    return xmin <= xmax;
+}
+
+double distance_to_segment(const StrokeSegment& s, const cv::Point2d& p)
+{
+    const cv::Point2d d = s.b - s.a;
+    const double length2 = d.dot(d);
+    double t = length2 > 0 ? (p - s.a).dot(d) / length2 : 0;
+    t = std::min(1.0, std::max(0.0, t));
+    const cv::Point2d v = p - (s.a + t * d);
+    return std::sqrt(v.dot(v));
+}
+
+/*
+ * Rasterizes the segments crossing a tile into a coverage mask (0 to 255),
+ * along with the color of the segment covering each pixel the most (the
+ * last one in case of a tie, as if the segments were drawn in order), then
+ * blends the colors into the tile where the mask is not zero.
+ * The mask is kept zeroed between calls; only the span of each row that
+ * was touched is blended and cleared.
+ * The segments must have been clipped (see clip_segment()), so that the
+ * coordinates computed from them fit in an int.
+ */
+template<int CN>
+void draw_tile(cv::Mat& image,
+               int first_row,
+               int nb_rows,
+               const std::vector<StrokeSegment>& segments,
+               const std::vector<int>& indices,
+               double radius,
+               bool antialiased,
+               const std::vector<cv::Scalar>& colors)
+{
+    thread_local std::vector<uchar> mask;
+    thread_local std::vector<uchar> color_indices;
+    const size_t mask_size = static_cast<size_t>(nb_rows) * image.cols;
+
+    if (mask.size() < mask_size)
+    {
+        mask.resize(mask_size, 0);
+        color_indices.resize(mask_size);
+    }
+
+    std::vector<int> row_min(nb_rows, INT_MAX);
+    std::vector<int> row_max(nb_rows, -1);
+
+    // with antialiasing, the coverage fades over half a pixel on each side
+    const double r = antialiased ? radius + 0.5 : radius;
+
+    for (int index : indices)
+    {
+        const StrokeSegment& s = segments[index];
+        const int y0 = std::max(first_row, cvFloor(std::min(s.a.y, s.b.y) - r));
+        const int y1 = std::min(first_row + nb_rows - 1, cvCeil(std::max(s.a.y, s.b.y) + r));
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            double xmin, xmax;
+
+            if (!capsule_span(s, r, y, xmin, xmax))
+            {
+                continue;
+            }
+
+            const int x0 = std::max(0, cvCeil(xmin));
+            const int x1 = std::min(image.cols - 1, cvFloor(xmax));
+
+            if (x0 > x1)
+            {
+                continue;
+            }
+
+            const size_t offset = static_cast<size_t>(y - first_row) * image.cols;
+            uchar* m = mask.data() + offset;
+            uchar* c = color_indices.data() + offset;
+            const uchar color = static_cast<uchar>(s.color);
+
+            if (antialiased)
+            {
+                for (int x = x0; x <= x1; ++x)
+                {
+                    const double coverage = r - distance_to_segment(s, cv::Point2d(x, y));
+                    const uchar alpha = cv::saturate_cast<uchar>(coverage * 255);
+
+                    if (alpha > 0 && alpha >= m[x])
+                    {
+                        m[x] = alpha;
+                        c[x] = color;
+                    }
+                }
+            }
+            else
+            {
+                std::fill(m + x0, m + x1 + 1, uchar(255));
+                std::fill(c + x0, c + x1 + 1, color);
+            }
+
+            row_min[y - first_row] = std::min(row_min[y - first_row], x0);
+            row_max[y - first_row] = std::max(row_max[y - first_row], x1);
+        }
+    }
+
+    for (int i(0); i < nb_rows; ++i)
+    {
+        uchar* m = mask.data() + static_cast<size_t>(i) * image.cols;
+        const uchar* c = color_indices.data() + static_cast<size_t>(i) * image.cols;
+        uchar* row = image.ptr<uchar>(first_row + i);
+
+        for (int x = row_min[i]; x <= row_max[i]; ++x)
+        {
+            const int alpha = m[x];
+            const cv::Scalar& color = colors[c[x]];
+
+            if (alpha == 255)
+            {
+                for (int k(0); k < CN; ++k)
+                {
+                    row[x * CN + k] = cv::saturate_cast<uchar>(color[k]);
+                }
+            }
+            else if (alpha > 0)
+            {
+                for (int k(0); k < CN; ++k)
+                {
+                    uchar& v = row[x * CN + k];
+                    v = cv::saturate_cast<uchar>(v + (color[k] - v) * alpha / 255);
+                }
+            }
+
+            m[x] = 0;
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief draws line segments on an image, in a single pass
+ * @param image        the image on which the segments are drawn
+ * @param segments     the segments
+ * @param colors       BGR colors of the segments (at most 256)
+ * @param thickness    thickness of the lines in pixels
+ * @param antialiased  whether the edges of the lines are antialiased
+ *
+ * Lines have round ends, like those of cv::line(). The segments are
+ * bucketed by horizontal tile, and tiles are drawn in parallel: every
+ * pixel is written at most once, including those shared by several
+ * segments. Where segments of different colors overlap, the last one
+ * wins, as if they were drawn in order.
+ *
+ * Segments are first clipped to the image, grown by the thickness of the
+ * lines, which leaves the drawing unchanged; segments with non-finite ends
+ * are not drawn.
+ *
+ * Images that are not 8-bit with 1, 3 or 4 channels are drawn with
+ * cv::line().
+ */
+void draw_strokes(cv::Mat& image,
+                  const std::vector<StrokeSegment>& segments,
+                  const std::vector<cv::Scalar>& colors,
+                  int thickness,
+                  bool antialiased)
+{
+    thickness = std::max(1, thickness);
+
+    const double radius = thickness / 2.0;
+    const double margin = antialiased ? radius + 0.5 : radius;
+
+    // the part of a segment that is within margin of a pixel of the image
+    // lies in these bounds
+    const cv::Rect2d bounds{
+        -margin, -margin, image.cols - 1 + 2 * margin, image.rows - 1 + 2 * margin
+    };
+    std::vector<StrokeSegment> clipped;
+    clipped.reserve(segments.size());
+
+    for (StrokeSegment s : segments)
+    {
+        if (clip_segment(s, bounds))
+        {
+            clipped.push_back(s);
+        }
+    }
+
+    if (image.depth() != CV_8U || image.channels() == 2 || image.channels() > 4)
+    {
+        for (const StrokeSegment& s : clipped)
+        {
+            cv::line(image,
+                     cv::Point(cvRound(s.a.x), cvRound(s.a.y)),
+                     cv::Point(cvRound(s.b.x), cvRound(s.b.y)),
+                     colors[s.color],
+                     thickness,
+                     antialiased ? cv::LINE_AA : cv::LINE_8);
+        }
+
+        return;
+    }
+
+    const int nb_tiles = (image.rows + tile_rows - 1) / tile_rows;
+    std::vector<std::vector<int>> tiles(nb_tiles);
+
+    for (size_t i(0); i < clipped.size(); ++i)
+    {
+        const StrokeSegment& s = clipped[i];
+        const int y0 = cvFloor(std::min(s.a.y, s.b.y) - margin);
+        const int y1 = cvCeil(std::max(s.a.y, s.b.y) + margin);
+
+        if (y1 < 0 || y0 >= image.rows)
+        {
+            continue;
+        }
+
+        const int last_tile = std::min(image.rows - 1, y1) / tile_rows;
+
+        for (int t = std::max(0, y0) / tile_rows; t <= last_tile; ++t)
+        {
+            tiles[t].push_back(static_cast<int>(i));
+        }
+    }
+
+    cv::parallel_for_(cv::Range(0, nb_tiles),
+                      [&](const cv::Range& range)
+                      {
+                          for (int t = range.start; t < range.end; ++t)
+                          {
+                              if (tiles[t].empty())
+                              {
+                                  continue;
+                              }
+
+                              const int first_row = t * tile_rows;
+                              const int nb_rows = std::min(tile_rows, image.rows - first_row);
+
+                              switch (image.channels())
+                              {
+                              case 1:
+                                  draw_tile<1>(image, first_row, nb_rows, clipped, tiles[t],
+                                               radius, antialiased, colors);
+                                  break;
+                              case 3:
+                                  draw_tile<3>(image, first_row, nb_rows, clipped, tiles[t],
+                                               radius, antialiased, colors);
+                                  break;
+                              default:
+                                  draw_tile<4>(image, first_row, nb_rows, clipped, tiles[t],
+                                               radius, antialiased, colors);
+                                  break;
+                              }
+                          }
+                      });
+}
+
+} // namespace ocvp
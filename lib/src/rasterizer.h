@@ -0,0 +1,33 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <opencv2/core/mat.hpp>
+
+#include <vector>
+
+namespace ocvp
+{
+
+/**
+ * @brief a line segment to be drawn by draw_strokes()
+ */
+struct StrokeSegment
+{
+    cv::Point2d a;
+    cv::Point2d b;
+    int color = 0; ///< index in the colors passed to draw_strokes()
+};
+
+void draw_strokes(cv::Mat& image,
+                  const std::vector<StrokeSegment>& segments,
+                  const std::vector<cv::Scalar>& colors,
+                  int thickness,
+                  bool antialiased);
+
+} // namespace ocvp
+
+#endif // RASTERIZER_H
@@ -0,0 +1,33 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef SIMD_H
+#define SIMD_H
+
+// Private to the library: the SIMD kernels are compiled with per-function
+// target attributes and selected at runtime with best_simd_level(), so that
+// the library does not require building for a specific instruction set.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OCVP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(OCVP_X86_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#define OCVP_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define OCVP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OCVP_TARGET_SSE41
+#define OCVP_TARGET_AVX2
+#endif
+
+// address of a SIMD kernel in a table indexed by SimdLevel, null if the
+// kernel is not compiled in
+#ifdef OCVP_X86_SIMD
+#define OCVP_SIMD_KERNEL(k) (&k)
+#else
+#define OCVP_SIMD_KERNEL(k) nullptr
+#endif
+
+#endif // SIMD_H
@@ -0,0 +1,89 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "target.h"
+
+#include <opencv2/core.hpp>
+
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+struct StandardTarget
+{
+    const char* name;
+    PlanarTarget target;
+};
+
+constexpr StandardTarget standard_targets[] = {
+    { "a4", A4Target() },
+    { "a3", A3Target() },
+    { "letter", LetterTarget() },
+};
+
+} // namespace
+
+/**
+ * @brief looks up a target of standard size by name
+ * @param name    "a4", "a3" or "letter"
+ * @param target  receives the size of the target
+ * @return whether the name is that of a standard target
+ */
+bool find_standard_target(const std::string& name, PlanarTarget& target)
+{
+    for (const StandardTarget& t : standard_targets)
+    {
+        if (name == t.name)
+        {
+            target = t.target;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief saves the size of a target in a json file
+ * @param filepath  path to the json file (must include the .json extension)
+ * @param target    the target
+ */
+void save_planar_target(const std::string& filepath, const PlanarTarget& target)
+{
+    cv::FileStorage fs{ filepath, cv::FileStorage::WRITE };
+    fs << "width" << target.width;
+    fs << "height" << target.height;
+}
+
+/**
+ * @brief loads the size of a target, saved as a json file
+ * @param filepath  path to the json file
+ * @throw std::runtime_error if the file cannot be read or if the size is not positive
+ */
+PlanarTarget load_planar_target(const std::string& filepath)
+{
+    cv::FileStorage fs{ filepath, cv::FileStorage::READ };
+
+    if (!fs.isOpened())
+    {
+        throw std::runtime_error("Could not open " + filepath);
+    }
+
+    PlanarTarget target;
+    fs["width"] >> target.width;
+    fs["height"] >> target.height;
+
+    if (!(target.width > 0 && target.height > 0))
+    {
+        throw std::runtime_error("Invalid target size in " + filepath);
+    }
+
+    return target;
+}
+
+} // namespace ocvp
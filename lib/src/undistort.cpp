@@ -0,0 +1,401 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "undistort.h"
+
+#include "mappedfile.h"
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+/**
+ * Header of the files written by UndistortMapCache.
+ * It is followed by the content of map1 then map2, both stored row after
+ * row without padding; the header size is a multiple of 64 so that the
+ * maps are suitably aligned once the file is mapped in memory.
+ */
+struct MapFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    int32_t width;
+    int32_t height;
+    double intrinsics[4];
+    double distortion[8];
+    uint64_t map1_size;
+    uint64_t map2_size;
+    char reserved[48];
+};
+
+static_assert(sizeof(MapFileHeader) == 192, "unexpected padding in MapFileHeader");
+
+constexpr char map_file_magic[8] = { 'O', 'C', 'V', 'P', 'U', 'M', 'A', 'P' };
+constexpr uint32_t map_file_version = 1;
+
+void get_parameters(const CameraIntrinsics& intrinsics,
+                    const DistortionCoefficients& distortion,
+                    double (&i)[4],
+                    double (&d)[8])
+{
+    i[0] = intrinsics.cx;
+    i[1] = intrinsics.cy;
+    i[2] = intrinsics.fx;
+    i[3] = intrinsics.fy;
+
+    std::vector<double> coeffs = make_distcoeffs_vector(distortion);
+    std::copy(coeffs.begin(), coeffs.end(), d);
+}
+
+bool same_parameters(const CameraIntrinsics& i1,
+                     const DistortionCoefficients& d1,
+                     const CameraIntrinsics& i2,
+                     const DistortionCoefficients& d2)
+{
+    double a[4], b[4], c[8], d[8];
+    get_parameters(i1, d1, a, c);
+    get_parameters(i2, d2, b, d);
+    return std::memcmp(a, b, sizeof(a)) == 0 && std::memcmp(c, d, sizeof(c)) == 0;
+}
+
+void map_types(UndistortMapFormat format, int& type1, int& type2)
+{
+    type1 = format == UndistortMapFormat::FixedPoint ? CV_16SC2 : CV_32FC1;
+    type2 = format == UndistortMapFormat::FixedPoint ? CV_16UC1 : CV_32FC1;
+}
+
+} // namespace
+
+/**
+ * @brief returns a hash of a calibration and an image size
+ *
+ * This is the 64-bit FNV-1a hash of the parameters, which identifies the
+ * undistortion maps of a calibration in an UndistortMapCache.
+ */
+uint64_t undistort_map_key(const CameraIntrinsics& intrinsics,
+                           const DistortionCoefficients& distortion,
+                           const cv::Size& image_size)
+{
+    double i[4];
+    double d[8];
+    get_parameters(intrinsics, distortion, i, d);
+    const int32_t size[2] = { image_size.width, image_size.height };
+
+    uint64_t hash = 14695981039346656037ull;
+
+    auto update = [&hash](const void* data, size_t n)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        for (size_t k(0); k < n; ++k)
+        {
+            hash = (hash ^ bytes[k]) * 1099511628211ull;
+        }
+    };
+
+    update(i, sizeof(i));
+    update(d, sizeof(d));
+    update(size, sizeof(size));
+    return hash;
+}
+
+/**
+ * @brief computes the maps to be passed to cv::remap() to undistort an image
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ * @param image_size  size of the images
+ * @param format      format of the maps
+ *
+ * The undistorted image has the same camera matrix as the original one,
+ * like with cv::undistort().
+ *
+ * @sa cv::initUndistortRectifyMap()
+ */
+UndistortMaps compute_undistort_maps(const CameraIntrinsics& intrinsics,
+                                     const DistortionCoefficients& distortion,
+                                     const cv::Size& image_size,
+                                     UndistortMapFormat format)
+{
+    int type1, type2;
+    map_types(format, type1, type2);
+
+    cv::Mat camera_matrix = make_camera_matrix(intrinsics);
+
+    UndistortMaps maps;
+    cv::initUndistortRectifyMap(camera_matrix,
+                                make_distcoeffs_vector(distortion),
+                                cv::noArray(),
+                                camera_matrix,
+                                image_size,
+                                type1,
+                                maps.map1,
+                                maps.map2);
+
+    if (maps.map2.type() != type2)
+    {
+        throw std::runtime_error("cv::initUndistortRectifyMap() returned unexpected maps");
+    }
+
+    return maps;
+}
+
+/**
+ * @brief constructs a cache
+ * @param directory  directory in which maps are persisted, empty to keep them in memory only
+ * @param format     format of the maps
+ *
+ * The directory must exist. Files written by a process are mapped in memory
+ * (not read) by the next ones, so that they start instantly.
+ */
+UndistortMapCache::UndistortMapCache(const std::string& directory, UndistortMapFormat format)
+    : m_directory(directory),
+      m_format(format)
+{
+}
+
+const std::string& UndistortMapCache::directory() const
+{
+    return m_directory;
+}
+
+UndistortMapFormat UndistortMapCache::format() const
+{
+    return m_format;
+}
+
+/**
+ * @brief returns the undistortion maps of a calibration
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ * @param image_size  size of the images
+ *
+ * The maps are looked up in memory, then on disk; they are computed (and
+ * saved) only if they are found in neither.
+ * Concurrent calls for the same calibration do that work once.
+ * The returned matrices must not be modified.
+ */
+UndistortMaps UndistortMapCache::get(const CameraIntrinsics& intrinsics,
+                                     const DistortionCoefficients& distortion,
+                                     const cv::Size& image_size)
+{
+    const uint64_t key = undistort_map_key(intrinsics, distortion, image_size);
+    std::promise<void> done;
+
+    {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+
+        for (;;)
+        {
+            auto it = m_entries.find(key);
+
+            if (it != m_entries.end() && it->second.image_size == image_size
+                && same_parameters(
+                  intrinsics, distortion, it->second.intrinsics, it->second.distortion))
+            {
+                return it->second.maps;
+            }
+
+            auto pending = m_in_flight.find(key);
+
+            if (pending == m_in_flight.end())
+            {
+                break;
+            }
+
+            // another thread is loading or computing these maps, wait for it
+            // and look again (it may have failed, or had other parameters)
+            std::shared_future<void> other = pending->second;
+            lock.unlock();
+            other.wait();
+            lock.lock();
+        }
+
+        m_in_flight[key] = done.get_future().share();
+    }
+
+    // loaded or computed without the lock, so that other calibrations are
+    // not blocked in the meantime
+    Entry entry;
+    entry.intrinsics = intrinsics;
+    entry.distortion = distortion;
+    entry.image_size = image_size;
+
+    try
+    {
+        const std::string path = file_path(key);
+
+        if (path.empty() || !load(path, entry))
+        {
+            entry.maps = compute_undistort_maps(intrinsics, distortion, image_size, m_format);
+
+            if (!path.empty())
+            {
+                save(path, entry);
+            }
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_in_flight.erase(key);
+        done.set_value();
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_entries[key] = entry;
+    m_in_flight.erase(key);
+    done.set_value();
+    return entry.maps;
+}
+
+/**
+ * @brief undistorts an image
+ * @param image       the input image
+ * @param output      the undistorted image (must not be @a image)
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ *
+ * This produces the same result as cv::undistort(), using cached maps.
+ */
+void UndistortMapCache::undistort(const cv::Mat& image,
+                                  cv::Mat& output,
+                                  const CameraIntrinsics& intrinsics,
+                                  const DistortionCoefficients& distortion)
+{
+    UndistortMaps maps = get(intrinsics, distortion, image.size());
+    cv::remap(image, output, maps.map1, maps.map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+}
+
+/**
+ * @brief returns the path of the file in which the maps with a given key are persisted
+ * @return an empty string if the cache has no directory
+ */
+std::string UndistortMapCache::file_path(uint64_t key) const
+{
+    if (m_directory.empty())
+    {
+        return std::string();
+    }
+
+    char name[64];
+    std::snprintf(name,
+                  sizeof(name),
+                  "undistort-%016llx-%s.map",
+                  static_cast<unsigned long long>(key),
+                  m_format == UndistortMapFormat::FixedPoint ? "fixed" : "float");
+    return m_directory + "/" + name;
+}
+
+/**
+ * @brief returns the number of calibrations whose maps are held in memory
+ */
+size_t UndistortMapCache::size() const
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    return m_entries.size();
+}
+
+/**
+ * @brief releases the maps held in memory
+ *
+ * Files on disk are kept.
+ */
+void UndistortMapCache::clear()
+{
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_entries.clear();
+}
+
+bool UndistortMapCache::load(const std::string& path, Entry& entry) const
+{
+    std::shared_ptr<MappedFile> file;
+
+    try
+    {
+        file = std::make_shared<MappedFile>(path);
+    }
+    catch (const std::runtime_error&)
+    {
+        return false;
+    }
+
+    if (file->size() < sizeof(MapFileHeader))
+    {
+        return false;
+    }
+
+    MapFileHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    double intrinsics[4];
+    double distortion[8];
+    get_parameters(entry.intrinsics, entry.distortion, intrinsics, distortion);
+
+    int type1, type2;
+    map_types(m_format, type1, type2);
+
+    const cv::Size size = entry.image_size;
+    const uint64_t map1_size = uint64_t(size.area()) * CV_ELEM_SIZE(type1);
+    const uint64_t map2_size = uint64_t(size.area()) * CV_ELEM_SIZE(type2);
+
+    const bool valid = std::memcmp(header.magic, map_file_magic, sizeof(map_file_magic)) == 0
+                       && header.version == map_file_version
+                       && header.format == static_cast<uint32_t>(m_format)
+                       && header.width == size.width && header.height == size.height
+                       && std::memcmp(header.intrinsics, intrinsics, sizeof(intrinsics)) == 0
+                       && std::memcmp(header.distortion, distortion, sizeof(distortion)) == 0
+                       && header.map1_size == map1_size && header.map2_size == map2_size
+                       && file->size() == sizeof(header) + map1_size + map2_size;
+
+    if (!valid)
+    {
+        return false;
+    }
+
+    uchar* data = const_cast<uchar*>(file->data()) + sizeof(header);
+    entry.maps.map1 = cv::Mat(size, type1, data);
+    entry.maps.map2 = cv::Mat(size, type2, data + map1_size);
+    entry.maps.storage = file;
+    return true;
+}
+
+void UndistortMapCache::save(const std::string& path, const Entry& entry) const
+{
+    MapFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, map_file_magic, sizeof(map_file_magic));
+    header.version = map_file_version;
+    header.format = static_cast<uint32_t>(m_format);
+    header.key = undistort_map_key(entry.intrinsics, entry.distortion, entry.image_size);
+    header.width = entry.image_size.width;
+    header.height = entry.image_size.height;
+    get_parameters(entry.intrinsics, entry.distortion, header.intrinsics, header.distortion);
+
+    const cv::Mat map1 = entry.maps.map1.isContinuous() ? entry.maps.map1 : entry.maps.map1.clone();
+    const cv::Mat map2 = entry.maps.map2.isContinuous() ? entry.maps.map2 : entry.maps.map2.clone();
+    header.map1_size = map1.total() * map1.elemSize();
+    header.map2_size = map2.total() * map2.elemSize();
+
+    // failing to persist the maps is not an error: they will be recomputed
+    // by the next process
+    write_file_atomically(path,
+                          { { &header, sizeof(header) },
+                            { map1.data, header.map1_size },
+                            { map2.data, header.map2_size } });
+}
+
+} // namespace ocvp
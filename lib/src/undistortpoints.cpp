@@ -0,0 +1,435 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "undistort.h"
+#include "simd.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+namespace ocvp
+{
+
+namespace
+{
+
+// Largest grid spacing tried when building a UndistortLut, in pixels.
+constexpr int max_lut_step = 32;
+
+/**
+ * Arguments of the interpolation kernels.
+ * Points outside of the grid are extrapolated from the nearest cell.
+ */
+struct LutView
+{
+    const float* x_table;
+    const float* y_table;
+    int cols;
+    float inv_step;
+    float max_col; // index of the last cell, as a float
+    float max_row;
+};
+
+using PointKernel = void (*)(const LutView&, const float*, const float*, float*, float*, size_t);
+
+void undistort_points_scalar(const LutView& lut,
+                             const float* x,
+                             const float* y,
+                             float* ux,
+                             float* uy,
+                             size_t count)
+{
+    for (size_t i(0); i < count; ++i)
+    {
+        const float gx = x[i] * lut.inv_step;
+        const float gy = y[i] * lut.inv_step;
+
+        // the order of the arguments makes NaN coordinates select cell 0
+        const float cx = std::min(std::max(0.f, std::floor(gx)), lut.max_col);
+        const float cy = std::min(std::max(0.f, std::floor(gy)), lut.max_row);
+        const float fx = gx - cx;
+        const float fy = gy - cy;
+        const int index = static_cast<int>(cy) * lut.cols + static_cast<int>(cx);
+
+        auto interpolate = [&](const float* table)
+        {
+            const float a = table[index];
+            const float b = table[index + 1];
+            const float c = table[index + lut.cols];
+            const float d = table[index + lut.cols + 1];
+            const float top = a + fx * (b - a);
+            const float bottom = c + fx * (d - c);
+            return top + fy * (bottom - top);
+        };
+
+        ux[i] = interpolate(lut.x_table);
+        uy[i] = interpolate(lut.y_table);
+    }
+}
+
+#ifdef OCVP_X86_SIMD
+
+// index: top-left node of the cell of each point
+OCVP_TARGET_SSE41 inline __m128
+interpolate_sse(const float* table, const int* index, int cols, __m128 fx, __m128 fy)
+{
+    auto load = [table, index](int offset)
+    {
+        return _mm_setr_ps(table[index[0] + offset],
+                           table[index[1] + offset],
+                           table[index[2] + offset],
+                           table[index[3] + offset]);
+    };
+
+    const __m128 a = load(0);
+    const __m128 b = load(1);
+    const __m128 c = load(cols);
+    const __m128 d = load(cols + 1);
+    const __m128 top = _mm_add_ps(a, _mm_mul_ps(fx, _mm_sub_ps(b, a)));
+    const __m128 bottom = _mm_add_ps(c, _mm_mul_ps(fx, _mm_sub_ps(d, c)));
+    return _mm_add_ps(top, _mm_mul_ps(fy, _mm_sub_ps(bottom, top)));
+}
+
+OCVP_TARGET_SSE41 void undistort_points_sse(const LutView& lut,
+                                            const float* x,
+                                            const float* y,
+                                            float* ux,
+                                            float* uy,
+                                            size_t count)
+{
+    const __m128 inv_step = _mm_set1_ps(lut.inv_step);
+    const __m128 max_col = _mm_set1_ps(lut.max_col);
+    const __m128 max_row = _mm_set1_ps(lut.max_row);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i cols = _mm_set1_epi32(lut.cols);
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 gx = _mm_mul_ps(_mm_loadu_ps(x + i), inv_step);
+        const __m128 gy = _mm_mul_ps(_mm_loadu_ps(y + i), inv_step);
+
+        // _mm_max_ps() returns its second operand if the first one is NaN
+        const __m128 cx = _mm_min_ps(_mm_max_ps(_mm_floor_ps(gx), zero), max_col);
+        const __m128 cy = _mm_min_ps(_mm_max_ps(_mm_floor_ps(gy), zero), max_row);
+        const __m128 fx = _mm_sub_ps(gx, cx);
+        const __m128 fy = _mm_sub_ps(gy, cy);
+
+        alignas(16) int index[4];
+        _mm_store_si128(
+          reinterpret_cast<__m128i*>(index),
+          _mm_add_epi32(_mm_mullo_epi32(_mm_cvttps_epi32(cy), cols), _mm_cvttps_epi32(cx)));
+
+        _mm_storeu_ps(ux + i, interpolate_sse(lut.x_table, index, lut.cols, fx, fy));
+        _mm_storeu_ps(uy + i, interpolate_sse(lut.y_table, index, lut.cols, fx, fy));
+    }
+
+    undistort_points_scalar(lut, x + i, y + i, ux + i, uy + i, count - i);
+}
+
+OCVP_TARGET_AVX2 inline __m256
+interpolate_avx2(const float* table, __m256i index, __m256i cols, __m256 fx, __m256 fy)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256 a = _mm256_i32gather_ps(table, index, 4);
+    const __m256 b = _mm256_i32gather_ps(table, _mm256_add_epi32(index, one), 4);
+    index = _mm256_add_epi32(index, cols);
+    const __m256 c = _mm256_i32gather_ps(table, index, 4);
+    const __m256 d = _mm256_i32gather_ps(table, _mm256_add_epi32(index, one), 4);
+    const __m256 top = _mm256_add_ps(a, _mm256_mul_ps(fx, _mm256_sub_ps(b, a)));
+    const __m256 bottom = _mm256_add_ps(c, _mm256_mul_ps(fx, _mm256_sub_ps(d, c)));
+    return _mm256_add_ps(top, _mm256_mul_ps(fy, _mm256_sub_ps(bottom, top)));
+}
+
+OCVP_TARGET_AVX2 void undistort_points_avx2(const LutView& lut,
+                                            const float* x,
+                                            const float* y,
+                                            float* ux,
+                                            float* uy,
+                                            size_t count)
+{
+    const __m256 inv_step = _mm256_set1_ps(lut.inv_step);
+    const __m256 max_col = _mm256_set1_ps(lut.max_col);
+    const __m256 max_row = _mm256_set1_ps(lut.max_row);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i cols = _mm256_set1_epi32(lut.cols);
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 gx = _mm256_mul_ps(_mm256_loadu_ps(x + i), inv_step);
+        const __m256 gy = _mm256_mul_ps(_mm256_loadu_ps(y + i), inv_step);
+
+        // _mm256_max_ps() returns its second operand if the first one is NaN
+        const __m256 cx = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(gx), zero), max_col);
+        const __m256 cy = _mm256_min_ps(_mm256_max_ps(_mm256_floor_ps(gy), zero), max_row);
+        const __m256 fx = _mm256_sub_ps(gx, cx);
+        const __m256 fy = _mm256_sub_ps(gy, cy);
+
+        const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(cy), cols),
+                                               _mm256_cvttps_epi32(cx));
+
+        _mm256_storeu_ps(ux + i, interpolate_avx2(lut.x_table, index, cols, fx, fy));
+        _mm256_storeu_ps(uy + i, interpolate_avx2(lut.y_table, index, cols, fx, fy));
+    }
+
+    undistort_points_scalar(lut, x + i, y + i, ux + i, uy + i, count - i);
+}
+
+#endif // OCVP_X86_SIMD
+
+// indexed by SimdLevel, null if not available
+const PointKernel point_kernels[3] = { &undistort_points_scalar,
+                                       OCVP_SIMD_KERNEL(undistort_points_sse),
+                                       OCVP_SIMD_KERNEL(undistort_points_avx2) };
+
+} // namespace
+
+/**
+ * @brief builds the inverse model of a camera
+ * @param intrinsics  camera intrinsic parameters
+ * @param distortion  distortion coefficients
+ * @param image_size  size of the images; points outside of the image are extrapolated
+ * @param max_error   maximum interpolation error, in pixels
+ *
+ * The grid spacing is divided by two until the interpolation error,
+ * measured at the center and on the sides of every cell, is below
+ * @a max_error (or the spacing is 1 pixel).
+ * The exact inverse is computed with undistort_point().
+ */
+UndistortLut::UndistortLut(const CameraIntrinsics& intrinsics,
+                           const DistortionCoefficients& distortion,
+                           const cv::Size& image_size,
+                           double max_error)
+    : m_image_size(image_size)
+{
+    if (image_size.width <= 0 || image_size.height <= 0)
+    {
+        throw std::runtime_error("UndistortLut: invalid image size");
+    }
+
+    const CameraModel camera = make_camera_model(intrinsics, distortion);
+
+    for (int step(max_lut_step);; step /= 2)
+    {
+        build(camera, step);
+        m_max_error = measure_error(camera);
+
+        if (m_max_error <= max_error || step == 1)
+        {
+            break;
+        }
+    }
+}
+
+const cv::Size& UndistortLut::image_size() const
+{
+    return m_image_size;
+}
+
+/**
+ * @brief returns the spacing of the grid, in pixels
+ */
+int UndistortLut::step() const
+{
+    return m_step;
+}
+
+int UndistortLut::cols() const
+{
+    return m_cols;
+}
+
+int UndistortLut::rows() const
+{
+    return m_rows;
+}
+
+/**
+ * @brief returns the largest interpolation error measured in the image, in pixels
+ */
+double UndistortLut::max_error() const
+{
+    return m_max_error;
+}
+
+/**
+ * @brief returns the undistorted x coordinates at the nodes of the grid, row after row
+ */
+const float* UndistortLut::x_table() const
+{
+    return m_x.data();
+}
+
+/**
+ * @brief returns the undistorted y coordinates at the nodes of the grid, row after row
+ */
+const float* UndistortLut::y_table() const
+{
+    return m_y.data();
+}
+
+void UndistortLut::build(const CameraModel& camera, int step)
+{
+    m_step = step;
+    m_cols = std::max(2, (m_image_size.width - 1 + step - 1) / step + 1);
+    m_rows = std::max(2, (m_image_size.height - 1 + step - 1) / step + 1);
+    m_x.resize(size_t(m_cols) * m_rows);
+    m_y.resize(m_x.size());
+
+    cv::parallel_for_(cv::Range(0, m_rows),
+                      [&](const cv::Range& range)
+                      {
+                          for (int row = range.start; row < range.end; ++row)
+                          {
+                              for (int col(0); col < m_cols; ++col)
+                              {
+                                  cv::Point2d p = undistort_point(
+                                    camera, cv::Point2d(col * step, row * step));
+                                  m_x[size_t(row) * m_cols + col] = static_cast<float>(p.x);
+                                  m_y[size_t(row) * m_cols + col] = static_cast<float>(p.y);
+                              }
+                          }
+                      });
+}
+
+double UndistortLut::measure_error(const CameraModel& camera) const
+{
+    const double fx = camera.camera_matrix(0, 0);
+    const double fy = camera.camera_matrix(1, 1);
+    const float half = 0.5f * m_step;
+
+    std::mutex mutex;
+    double result = 0;
+
+    cv::parallel_for_(
+      cv::Range(0, m_rows - 1),
+      [&](const cv::Range& range)
+      {
+          // center, middle of the top side and middle of the left side of each cell
+          std::vector<float> x;
+          std::vector<float> y;
+
+          for (int row = range.start; row < range.end; ++row)
+          {
+              for (int col(0); col + 1 < m_cols; ++col)
+              {
+                  const float x0 = static_cast<float>(col * m_step);
+                  const float y0 = static_cast<float>(row * m_step);
+                  x.insert(x.end(), { x0 + half, x0 + half, x0 });
+                  y.insert(y.end(), { y0 + half, y0, y0 + half });
+              }
+          }
+
+          std::vector<float> ux(x.size());
+          std::vector<float> uy(y.size());
+          undistort_points_batch(*this, x.data(), y.data(), ux.data(), uy.data(), x.size());
+
+          double error = 0;
+
+          for (size_t i(0); i < x.size(); ++i)
+          {
+              cv::Point2d p = undistort_point(camera, cv::Point2d(x[i], y[i]));
+              error = std::max(error, std::abs(ux[i] - p.x) * fx);
+              error = std::max(error, std::abs(uy[i] - p.y) * fy);
+          }
+
+          std::lock_guard<std::mutex> lock{ mutex };
+          result = std::max(result, error);
+      });
+
+    return result;
+}
+
+/**
+ * @brief undistorts points using a precomputed inverse model
+ * @param lut            the inverse model
+ * @param x              x coordinates of the points, in pixels
+ * @param y              y coordinates of the points, in pixels
+ * @param undistorted_x  receives the x normalized coordinates (may be @a x)
+ * @param undistorted_y  receives the y normalized coordinates (may be @a y)
+ * @param count          number of points
+ * @param max_level      highest instruction set that may be used
+ *
+ * The output is in normalized image coordinates, like undistort_point() and
+ * cv::undistortPoints() (without the P argument), up to the error reported by
+ * UndistortLut::max_error().
+ * Large batches are split among OpenCV's worker threads.
+ */
+void undistort_points_batch(const UndistortLut& lut,
+                            const float* x,
+                            const float* y,
+                            float* undistorted_x,
+                            float* undistorted_y,
+                            size_t count,
+                            SimdLevel max_level)
+{
+    LutView view;
+    view.x_table = lut.x_table();
+    view.y_table = lut.y_table();
+    view.cols = lut.cols();
+    view.inv_step = 1.f / lut.step();
+    view.max_col = static_cast<float>(lut.cols() - 2);
+    view.max_row = static_cast<float>(lut.rows() - 2);
+
+    int level = static_cast<int>(std::min(max_level, best_simd_level()));
+
+    while (!point_kernels[level])
+    {
+        --level;
+    }
+
+    PointKernel kernel = point_kernels[level];
+
+    constexpr size_t chunk_size = 1 << 16;
+    const int nb_chunks = static_cast<int>((count + chunk_size - 1) / chunk_size);
+
+    cv::parallel_for_(cv::Range(0, nb_chunks),
+                      [&](const cv::Range& range)
+                      {
+                          for (int c = range.start; c < range.end; ++c)
+                          {
+                              const size_t begin = size_t(c) * chunk_size;
+                              const size_t n = std::min(chunk_size, count - begin);
+                              kernel(view,
+                                     x + begin,
+                                     y + begin,
+                                     undistorted_x + begin,
+                                     undistorted_y + begin,
+                                     n);
+                          }
+                      });
+}
+
+/**
+ * @brief undistorts points stored as a structure of arrays
+ * @throw std::runtime_error if @a x and @a y do not have the same size
+ *
+ * The output vectors are resized as needed.
+ */
+void undistort_points_batch(const UndistortLut& lut,
+                            const std::vector<float>& x,
+                            const std::vector<float>& y,
+                            std::vector<float>& undistorted_x,
+                            std::vector<float>& undistorted_y,
+                            SimdLevel max_level)
+{
+    if (x.size() != y.size())
+    {
+        throw std::runtime_error("undistort_points_batch(): x and y have different sizes");
+    }
+
+    undistorted_x.resize(x.size());
+    undistorted_y.resize(y.size());
+    undistort_points_batch(
+      lut, x.data(), y.data(), undistorted_x.data(), undistorted_y.data(), x.size(), max_level);
+}
+
+} // namespace ocvp
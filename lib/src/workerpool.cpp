@@ -0,0 +1,90 @@
+// Copyright (C) 2023 Vincent Chambrin
+// This file is part of the 'ocv-playground' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "workerpool.h"
+
+#include <algorithm>
+
+namespace ocvp
+{
+
+/**
+ * @brief starts the worker threads
+ * @param nb_threads  number of threads, 0 means one per hardware thread
+ */
+WorkerPool::WorkerPool(size_t nb_threads)
+{
+    if (nb_threads == 0)
+    {
+        nb_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_threads.reserve(nb_threads);
+
+    for (size_t i(0); i < nb_threads; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+/**
+ * @brief waits for all pending tasks to complete and joins the threads
+ */
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+
+    for (std::thread& t : m_threads)
+    {
+        t.join();
+    }
+}
+
+/**
+ * @brief returns the number of worker threads
+ */
+size_t WorkerPool::size() const
+{
+    return m_threads.size();
+}
+
+void WorkerPool::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_tasks.push_back(std::move(task));
+    }
+
+    m_condition.notify_one();
+}
+
+void WorkerPool::run()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+            if (m_tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+} // namespace ocvp